@@ -0,0 +1,360 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <limits>
+#include <vector>
+#include "equalizer.h"
+#include "resampler.h"
+#include "spscringbuffer.h"
+#include "timestretcher.h"
+
+// Benchmark of the output chain's DSP stages on generated audio. Each case
+// runs a stage over --seconds of audio as fast as it can, in blocks the size
+// of an output period, and reports the time as a share of one core: 1% means
+// the stage needs a hundredth of a core to keep up with playback. The best
+// of several runs is kept, as the least disturbed one. Cases with a budget
+// from the stage's requirements also report whether they met it. The report
+// is one JSON document; progress goes to stderr.
+//
+// The resampler is also checked for quality on pure tones: the error against
+// the ideal output and how far images and aliases stay below the tone. The
+// run fails when a tier misses its minimum.
+
+static const int kBlockFrames = 1024;
+static const int kRuns = 5;
+static const double kPi = 3.14159265358979323846;
+// Frames at both ends left out of the quality measurements: the filter
+// settling in and the flushed tail.
+static const int kEdgeFrames = 2048;
+
+struct ResamplerTier {
+    Resampler::Quality quality;
+    const char *name;
+    double minimumDb;
+};
+
+// A few dB under the stopbands in resampler.h.
+static const ResamplerTier kResamplerTiers[] = {
+    {Resampler::Fast, "fast", 55.0},
+    {Resampler::Standard, "standard", 80.0},
+    {Resampler::High, "high", 95.0},
+};
+
+static std::vector<float> noise(int frames, int channels, quint32 seed)
+{
+    QRandomGenerator random(seed);
+    std::vector<float> samples(static_cast<size_t>(frames) * channels);
+    for (float &sample : samples) {
+        sample = static_cast<float>(random.generateDouble() - 0.5) * 0.5f;
+    }
+    return samples;
+}
+
+// Stereo, both channels equal, each tone at half scale.
+static std::vector<float> tones(int sampleRate, int frames, std::initializer_list<double> frequencies)
+{
+    std::vector<float> samples(static_cast<size_t>(frames) * 2);
+    for (int frame = 0; frame < frames; ++frame) {
+        double value = 0.0;
+        for (double frequency : frequencies) {
+            value += 0.5 * std::sin(2.0 * kPi * frequency * frame / sampleRate);
+        }
+        samples[frame * 2] = samples[frame * 2 + 1] = static_cast<float>(value);
+    }
+    return samples;
+}
+
+template <typename Pass>
+static qint64 bestOf(Pass pass)
+{
+    qint64 best = std::numeric_limits<qint64>::max();
+    for (int run = 0; run < kRuns; ++run) {
+        best = std::min(best, pass());
+    }
+    return best;
+}
+
+static QJsonObject result(const QString &name, int sampleRate, int frames, qint64 nsecs, double budgetPercent = 0.0)
+{
+    const double audioSeconds = static_cast<double>(frames) / sampleRate;
+    const double share = nsecs / 1e9 / audioSeconds * 100.0;
+    QJsonObject object;
+    object["name"] = name;
+    object["sampleRate"] = sampleRate;
+    object["audioSeconds"] = audioSeconds;
+    object["ms"] = nsecs / 1e6;
+    object["coreSharePercent"] = share;
+    if (budgetPercent > 0.0) {
+        object["budgetPercent"] = budgetPercent;
+        object["withinBudget"] = share < budgetPercent;
+    }
+    return object;
+}
+
+// All ten bands active, the most the equalizer ever does per frame.
+static QJsonObject equalizerCase(bool simd, int sampleRate, int frames)
+{
+    Equalizer equalizer;
+    equalizer.prepare(sampleRate, 2);
+    std::vector<float> gains;
+    for (int band = 0; band < Equalizer::BandCount; ++band) {
+        gains.push_back(band % 2 == 0 ? 6.0f : -6.0f);
+    }
+    equalizer.setGains(gains);
+    equalizer.setEnabled(true);
+    equalizer.setSimdEnabled(simd);
+
+    const std::vector<float> source = noise(frames, 2, 1);
+    std::vector<float> buffer;
+    const qint64 nsecs = bestOf([&]() {
+        buffer = source;
+        QElapsedTimer timer;
+        timer.start();
+        for (int frame = 0; frame < frames; frame += kBlockFrames) {
+            equalizer.process(buffer.data() + static_cast<size_t>(frame) * 2, std::min(kBlockFrames, frames - frame), 2);
+        }
+        return timer.nsecsElapsed();
+    });
+    // The requirement is for the path the player uses.
+    return result(simd ? "equalizer.simd" : "equalizer.scalar", sampleRate, frames, nsecs, simd ? 1.0 : 0.0);
+}
+
+// `frames` is the playback time produced, so at 2x twice as much source
+// goes through. The ring is refilled inside the timing, as the decoder would;
+// that is only a copy.
+static QJsonObject stretcherCase(float rate, int sampleRate, int frames)
+{
+    const int channels = TimeStretcher::Channels;
+    TimeStretcher stretcher;
+    stretcher.prepare(sampleRate);
+    const std::vector<float> source = noise(static_cast<int>(frames * rate) + sampleRate, channels, 2);
+    std::vector<float> output(static_cast<size_t>(kBlockFrames) * channels);
+    int produced = 0;
+    const qint64 nsecs = bestOf([&]() {
+        stretcher.reset();
+        SpscRingBuffer<float> ring(static_cast<size_t>(sampleRate) * channels);
+        size_t fed = 0;
+        produced = 0;
+        QElapsedTimer timer;
+        timer.start();
+        while (produced < frames) {
+            fed += ring.write(source.data() + fed, std::min(ring.availableWrite(), source.size() - fed));
+            int sourceFrames = 0;
+            const int got = stretcher.process(ring, output.data(), std::min(kBlockFrames, frames - produced), rate,
+                                              fed == source.size(), sourceFrames);
+            produced += got;
+            if (got == 0 && fed == source.size()) {
+                break;
+            }
+        }
+        return timer.nsecsElapsed();
+    });
+    QJsonObject object = result(QString("timestretch.%1x").arg(rate), sampleRate, produced, nsecs, 3.0);
+    object["rate"] = rate;
+    return object;
+}
+
+static std::vector<float> resample(Resampler &resampler, const std::vector<float> &input)
+{
+    std::vector<float> output;
+    const int frames = static_cast<int>(input.size() / 2);
+    for (int frame = 0; frame < frames; frame += kBlockFrames) {
+        resampler.process(input.data() + static_cast<size_t>(frame) * 2, std::min(kBlockFrames, frames - frame), output);
+    }
+    resampler.flush(output);
+    return output;
+}
+
+// Relative power of one frequency in the left channel, through a Hann window
+// so a strong tone does not leak into a weak one.
+static double tonePower(const std::vector<float> &output, int sampleRate, double frequency)
+{
+    const int first = kEdgeFrames;
+    const int last = static_cast<int>(output.size() / 2) - kEdgeFrames;
+    double re = 0.0;
+    double im = 0.0;
+    for (int frame = first; frame < last; ++frame) {
+        const double window = 0.5 - 0.5 * std::cos(2.0 * kPi * (frame - first) / (last - first));
+        const double phase = 2.0 * kPi * frequency * frame / sampleRate;
+        re += window * output[frame * 2] * std::cos(phase);
+        im += window * output[frame * 2] * std::sin(phase);
+    }
+    return re * re + im * im;
+}
+
+// Output frame 0 falls on input frame 0, so the ideal output is the same
+// sine sampled at the output rate.
+static double sineSnrDb(Resampler::Quality quality, int inputRate, int outputRate)
+{
+    const double frequency = 1000.0;
+    Resampler resampler;
+    resampler.configure(inputRate, outputRate, quality);
+    const std::vector<float> output = resample(resampler, tones(inputRate, inputRate * 2, {frequency}));
+    double signal = 0.0;
+    double error = 0.0;
+    for (int frame = kEdgeFrames; frame < static_cast<int>(output.size() / 2) - kEdgeFrames; ++frame) {
+        const double ideal = 0.5 * std::sin(2.0 * kPi * frequency * frame / outputRate);
+        const double difference = output[frame * 2] - ideal;
+        signal += ideal * ideal;
+        error += difference * difference;
+    }
+    return 10.0 * std::log10(signal / error);
+}
+
+static QJsonObject resamplerCheck(const ResamplerTier &tier)
+{
+    // 44.1 -> 48 kHz has 160 exact phases; 44.1 -> 47.999 kHz goes through
+    // the nearest of MaxPhases and has no minimum of its own.
+    const double snr = sineSnrDb(tier.quality, 44100, 48000);
+    const double tableSnr = sineSnrDb(tier.quality, 44100, 47999);
+
+    // Upsampling: a 15 kHz tone leaves an image at 44.1 - 15 = 29.1 kHz.
+    Resampler resampler;
+    resampler.configure(44100, 96000, tier.quality);
+    std::vector<float> output = resample(resampler, tones(44100, 44100 * 2, {15000.0}));
+    const double imageRejection = 10.0 * std::log10(tonePower(output, 96000, 15000.0)
+                                                    / tonePower(output, 96000, 29100.0));
+
+    // Downsampling: 30 kHz has to go; what is left of it aliases to
+    // 44.1 - 30 = 14.1 kHz, next to a 1 kHz tone at the same level.
+    resampler.configure(96000, 44100, tier.quality);
+    output = resample(resampler, tones(96000, 96000 * 2, {1000.0, 30000.0}));
+    const double aliasRejection = 10.0 * std::log10(tonePower(output, 44100, 1000.0)
+                                                    / tonePower(output, 44100, 14100.0));
+
+    QJsonObject object;
+    object["quality"] = tier.name;
+    object["snrDb"] = snr;
+    object["tableSnrDb"] = tableSnr;
+    object["imageRejectionDb"] = imageRejection;
+    object["aliasRejectionDb"] = aliasRejection;
+    object["minimumDb"] = tier.minimumDb;
+    object["passed"] = snr >= tier.minimumDb && imageRejection >= tier.minimumDb && aliasRejection >= tier.minimumDb;
+    return object;
+}
+
+// The share is per second of input, i.e. of playback.
+static QJsonObject resamplerCase(const ResamplerTier &tier, int inputRate, int outputRate, int frames)
+{
+    Resampler resampler;
+    resampler.configure(inputRate, outputRate, tier.quality);
+    const std::vector<float> source = noise(frames, Resampler::Channels, 3);
+    std::vector<float> output;
+    const qint64 nsecs = bestOf([&]() {
+        resampler.reset();
+        QElapsedTimer timer;
+        timer.start();
+        for (int frame = 0; frame < frames; frame += kBlockFrames) {
+            output.clear();
+            resampler.process(source.data() + static_cast<size_t>(frame) * Resampler::Channels,
+                              std::min(kBlockFrames, frames - frame), output);
+        }
+        return timer.nsecsElapsed();
+    });
+    QJsonObject object = result(QString("resampler.") + tier.name, inputRate, frames, nsecs);
+    object["outputRate"] = outputRate;
+    object["quality"] = tier.name;
+    object["framesPerSecond"] = frames / (nsecs / 1e9);
+    return object;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("DspBenchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Бенчмарк обработки звука: доля одного ядра на каждый этап.");
+    parser.addHelpOption();
+    QCommandLineOption secondsOption("seconds", "Длительность звука на один прогон (по умолчанию 10 с).", "секунды",
+                                     "10");
+    QCommandLineOption checkBudgetsOption("check-budgets", "Завершиться с ошибкой, если этап превысил свой бюджет.");
+    QCommandLineOption jsonOption("json", "Записать отчёт в файл, а не в stdout.", "файл");
+    parser.addOptions({secondsOption, checkBudgetsOption, jsonOption});
+    parser.process(app);
+
+    QTextStream err(stderr);
+    const double seconds = parser.value(secondsOption).toDouble();
+    if (seconds <= 0.0) {
+        err << "Неверная длительность: " << parser.value(secondsOption) << "\n";
+        return 2;
+    }
+    auto framesAt = [seconds](int sampleRate) {
+        return static_cast<int>(seconds * sampleRate);
+    };
+
+    QJsonArray cases;
+    auto add = [&cases, &err](const QJsonObject &object) {
+        err << object["name"].toString() << " @ " << object["sampleRate"].toInt() << " Гц: "
+            << QString::number(object["coreSharePercent"].toDouble(), 'f', 3) << "% ядра\n";
+        err.flush();
+        cases.append(object);
+    };
+
+    add(equalizerCase(true, 96000, framesAt(96000)));
+    add(equalizerCase(false, 96000, framesAt(96000)));
+    add(stretcherCase(2.0f, 48000, framesAt(48000)));
+    add(stretcherCase(2.0f, 96000, framesAt(96000)));
+    const int resamplerRates[][2] = {{44100, 48000}, {48000, 44100}, {96000, 48000}};
+    for (const ResamplerTier &tier : kResamplerTiers) {
+        for (const auto &rates : resamplerRates) {
+            add(resamplerCase(tier, rates[0], rates[1], framesAt(rates[0])));
+        }
+    }
+
+    QJsonArray checks;
+    bool qualityFailed = false;
+    for (const ResamplerTier &tier : kResamplerTiers) {
+        const QJsonObject check = resamplerCheck(tier);
+        err << "resampler." << tier.name << ": SNR " << QString::number(check["snrDb"].toDouble(), 'f', 1)
+            << " дБ, образы " << QString::number(check["imageRejectionDb"].toDouble(), 'f', 1)
+            << " дБ, наложения " << QString::number(check["aliasRejectionDb"].toDouble(), 'f', 1) << " дБ\n";
+        if (!check["passed"].toBool()) {
+            qualityFailed = true;
+            err << "Качество ниже " << tier.minimumDb << " дБ: resampler." << tier.name << "\n";
+        }
+        err.flush();
+        checks.append(check);
+    }
+
+    bool overBudget = false;
+    for (const QJsonValue &value : cases) {
+        const QJsonObject object = value.toObject();
+        if (object.contains("withinBudget") && !object["withinBudget"].toBool()) {
+            overBudget = true;
+            err << "Превышен бюджет: " << object["name"].toString() << "\n";
+        }
+    }
+
+    QJsonObject report;
+    report["suite"] = "DspBenchmark";
+    report["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    report["qtVersion"] = QString(qVersion());
+    report["blockFrames"] = kBlockFrames;
+    report["runs"] = kRuns;
+    report["cases"] = cases;
+    report["checks"] = checks;
+
+    const QByteArray json = QJsonDocument(report).toJson();
+    if (parser.isSet(jsonOption)) {
+        QFile file(parser.value(jsonOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            err << "Не удалось записать " << parser.value(jsonOption) << "\n";
+            return 1;
+        }
+        file.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+    return qualityFailed || (overBudget && parser.isSet(checkBudgetsOption)) ? 1 : 0;
+}
@@ -0,0 +1,273 @@
+#include "fixturegenerator.h"
+#include "backgroundscheduler.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QProcess>
+#include <QSemaphore>
+#include <QtEndian>
+#include <cmath>
+#include <vector>
+
+static const QStringList kLatinWords = {
+    "Midnight", "Silver", "Electric", "Northern", "Velvet", "Broken", "Golden", "Neon",
+    "Wolves", "Rivers", "Echoes", "Lights", "Hearts", "Machines", "Signal", "Ocean"
+};
+static const QStringList kCyrillicWords = {
+    "Ночные", "Серебряные", "Северные", "Тёмные", "Белые", "Звёздные", "Тихие", "Летние",
+    "Волны", "Огни", "Птицы", "Реки", "Сны", "Ветра", "Тени", "Поезда"
+};
+static const QStringList kGenres = {
+    "Rock", "Pop", "Electronic", "Jazz", "Ambient", "Folk", "Рок", "Поп", "Шансон", "Бард"
+};
+static const int kEncodeTimeoutMs = 60000;
+static const double kPi = 3.14159265358979323846;
+
+FixtureGenerator::FixtureGenerator(quint32 seed)
+    : m_random(seed)
+{
+}
+
+QStringList FixtureGenerator::supportedFormats()
+{
+    return {"wav", "flac", "mp3", "mp4"};
+}
+
+bool FixtureGenerator::hasFfmpeg()
+{
+    QProcess process;
+    process.start("ffmpeg", {"-hide_banner", "-version"});
+    return process.waitForFinished(10000) && process.exitStatus() == QProcess::NormalExit
+           && process.exitCode() == 0;
+}
+
+QString FixtureGenerator::makeName(bool cyrillic, int minWords, int maxWords)
+{
+    const QStringList &words = cyrillic ? kCyrillicWords : kLatinWords;
+    const int count = m_random.bounded(minWords, maxWords + 1);
+    QStringList parts;
+    for (int index = 0; index < count; ++index) {
+        parts << words[m_random.bounded(static_cast<int>(words.size()))];
+    }
+    return parts.join(' ');
+}
+
+QList<FixtureGenerator::Fixture> FixtureGenerator::plan(const QString &rootDir, int count, const QStringList &formats)
+{
+    QList<Fixture> fixtures;
+    int albumIndex = 0;
+    while (fixtures.size() < count) {
+        const bool cyrillic = m_random.bounded(10) < 4;
+        const QString artist = makeName(cyrillic, 2, 2);
+        const int albums = m_random.bounded(1, 4);
+        for (int album = 0; album < albums && fixtures.size() < count; ++album, ++albumIndex) {
+            // The index keeps albums with equal names apart.
+            const QString albumName = makeName(cyrillic, 1, 3) + QString(" %1").arg(albumIndex + 1);
+            const int year = m_random.bounded(1965, 2026);
+            const QString genre = kGenres[m_random.bounded(static_cast<int>(kGenres.size()))];
+            const int tracks = m_random.bounded(4, 13);
+            const bool twoDiscs = tracks > 8 && m_random.bounded(4) == 0;
+            QString albumDir = QString("%1/%2/%3 - %4").arg(rootDir, artist).arg(year).arg(albumName);
+            for (int number = 1; number <= tracks && fixtures.size() < count; ++number) {
+                Fixture fixture;
+                fixture.format = formats[fixtures.size() % formats.size()];
+                fixture.title = makeName(cyrillic, 1, 3);
+                fixture.artist = artist;
+                fixture.album = albumName;
+                fixture.genre = genre;
+                fixture.trackNumber = number;
+                fixture.year = year;
+                fixture.durationMs = m_random.bounded(MinDurationMs, MaxDurationMs + 1);
+                fixture.leadingSilenceMs = m_random.bounded(3) == 0 ? m_random.bounded(100, 1500) : 0;
+                fixture.trailingSilenceMs = m_random.bounded(2) == 0 ? m_random.bounded(100, 2500) : 0;
+                // A4 = 440 Hz, anywhere from A2 to A5.
+                fixture.frequency = 440.0 * std::pow(2.0, m_random.bounded(-24, 13) / 12.0);
+                fixture.noiseSeed = m_random.generate();
+                const QString directory = twoDiscs ? albumDir + QString("/CD %1").arg(number <= tracks / 2 ? 1 : 2)
+                                                   : albumDir;
+                fixture.filePath = QString("%1/%2 - %3.%4").arg(directory).arg(number, 2, 10, QChar('0'))
+                                       .arg(fixture.title, fixture.format);
+                fixtures << fixture;
+            }
+        }
+    }
+    return fixtures;
+}
+
+QList<FixtureGenerator::Fixture> FixtureGenerator::generate(const QString &rootDir, int count, QStringList formats)
+{
+    if (formats.isEmpty()) {
+        formats << "wav";
+    }
+    for (const QString &format : formats) {
+        if (!supportedFormats().contains(format)) {
+            qWarning() << "Неизвестный формат фикстур:" << format;
+            return QList<Fixture>();
+        }
+    }
+    if (formats != QStringList{"wav"} && !hasFfmpeg()) {
+        qWarning() << "ffmpeg не найден, фикстуры будут только в WAV";
+        formats = QStringList{"wav"};
+    }
+
+    const QList<Fixture> fixtures = plan(rootDir, count, formats);
+    std::vector<char> written(fixtures.size(), 0);
+    QMutex warningMutex;
+    QSemaphore done;
+    for (int index = 0; index < fixtures.size(); ++index) {
+        BackgroundScheduler::instance()->start(BackgroundScheduler::Bulk, [&, index]() {
+            const Fixture &fixture = fixtures[index];
+            QDir().mkpath(QFileInfo(fixture.filePath).absolutePath());
+            const QString wavPath = fixture.format == "wav" ? fixture.filePath : fixture.filePath + ".tmp.wav";
+            QString error;
+            bool ok = writeWav(wavPath, fixture);
+            if (!ok) {
+                error = "Не удалось записать WAV";
+            } else if (fixture.format != "wav") {
+                ok = encode(wavPath, fixture, &error);
+                QFile::remove(wavPath);
+            }
+            if (!ok) {
+                QMutexLocker locker(&warningMutex);
+                qWarning() << "Не удалось создать фикстуру" << fixture.filePath << ":" << error;
+            }
+            written[index] = ok;
+            done.release();
+        });
+    }
+    done.acquire(fixtures.size());
+
+    QList<Fixture> result;
+    for (int index = 0; index < fixtures.size(); ++index) {
+        if (written[index]) {
+            result << fixtures[index];
+        }
+    }
+    return result;
+}
+
+static QByteArray infoChunk(const char *id, const QString &value)
+{
+    QByteArray text = value.toUtf8();
+    text.append('\0');
+    if (text.size() % 2 != 0) {
+        text.append('\0');
+    }
+    QByteArray chunk(id, 4);
+    const quint32 size = qToLittleEndian(static_cast<quint32>(text.size()));
+    chunk.append(reinterpret_cast<const char *>(&size), 4);
+    return chunk + text;
+}
+
+bool FixtureGenerator::writeWav(const QString &filePath, const Fixture &fixture)
+{
+    const int frames = static_cast<int>(static_cast<qint64>(fixture.durationMs) * SampleRate / 1000);
+    const int silentStart = fixture.leadingSilenceMs * SampleRate / 1000;
+    const int silentEnd = frames - fixture.trailingSilenceMs * SampleRate / 1000;
+    const int fade = SampleRate / 20;
+    std::vector<qint16> samples(static_cast<size_t>(frames) * Channels, 0);
+    QRandomGenerator noise(fixture.noiseSeed);
+    const double twoPi = 2.0 * kPi;
+    // Root, fifth and octave; the right channel is slightly detuned.
+    const double partials[] = {1.0, 1.5, 2.0};
+    const double levels[] = {0.5, 0.25, 0.15};
+    for (int frame = silentStart; frame < silentEnd; ++frame) {
+        const double envelope = qMin(1.0, qMin(frame - silentStart, silentEnd - frame) / static_cast<double>(fade));
+        const double time = static_cast<double>(frame) / SampleRate;
+        for (int channel = 0; channel < Channels; ++channel) {
+            const double detune = channel == 0 ? 1.0 : 1.002;
+            double value = 0.0;
+            for (int partial = 0; partial < 3; ++partial) {
+                value += levels[partial] * std::sin(twoPi * fixture.frequency * partials[partial] * detune * time);
+            }
+            value += (noise.generateDouble() - 0.5) * 0.01;
+            samples[static_cast<size_t>(frame) * Channels + channel] =
+                static_cast<qint16>(qBound(-1.0, value * envelope * 0.8, 1.0) * 32767.0);
+        }
+    }
+
+    QByteArray info("INFO");
+    info += infoChunk("INAM", fixture.title);
+    info += infoChunk("IART", fixture.artist);
+    info += infoChunk("IPRD", fixture.album);
+    info += infoChunk("IGNR", fixture.genre);
+    info += infoChunk("ITRK", QString::number(fixture.trackNumber));
+    info += infoChunk("ICRD", QString::number(fixture.year));
+
+    const quint32 dataSize = static_cast<quint32>(samples.size() * sizeof(qint16));
+    QByteArray header;
+    auto append32 = [&header](quint32 value) {
+        value = qToLittleEndian(value);
+        header.append(reinterpret_cast<const char *>(&value), 4);
+    };
+    auto append16 = [&header](quint16 value) {
+        value = qToLittleEndian(value);
+        header.append(reinterpret_cast<const char *>(&value), 2);
+    };
+    header.append("RIFF", 4);
+    append32(static_cast<quint32>(4 + 24 + 8 + info.size() + 8 + dataSize));
+    header.append("WAVE", 4);
+    header.append("fmt ", 4);
+    append32(16);
+    append16(1);
+    append16(Channels);
+    append32(SampleRate);
+    append32(SampleRate * Channels * sizeof(qint16));
+    append16(Channels * sizeof(qint16));
+    append16(16);
+    header.append("LIST", 4);
+    append32(static_cast<quint32>(info.size()));
+    header.append(info);
+    header.append("data", 4);
+    append32(dataSize);
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    for (qint16 &sample : samples) {
+        sample = qToLittleEndian(sample);
+    }
+    return file.write(header) == header.size()
+           && file.write(reinterpret_cast<const char *>(samples.data()), dataSize) == static_cast<qint64>(dataSize);
+}
+
+bool FixtureGenerator::encode(const QString &wavPath, const Fixture &fixture, QString *error)
+{
+    QStringList arguments;
+    arguments << "-hide_banner" << "-loglevel" << "error" << "-y" << "-i" << wavPath
+              << "-metadata" << "title=" + fixture.title
+              << "-metadata" << "artist=" + fixture.artist
+              << "-metadata" << "album=" + fixture.album
+              << "-metadata" << "genre=" + fixture.genre
+              << "-metadata" << "track=" + QString::number(fixture.trackNumber)
+              << "-metadata" << "date=" + QString::number(fixture.year);
+    if (fixture.format == "flac") {
+        arguments << "-c:a" << "flac";
+    } else if (fixture.format == "mp3") {
+        arguments << "-c:a" << "libmp3lame" << "-b:a" << "192k" << "-id3v2_version" << "3";
+    } else {
+        arguments << "-c:a" << "aac" << "-b:a" << "160k";
+    }
+    arguments << fixture.filePath;
+
+    QProcess process;
+    BackgroundScheduler::instance()->prepareProcess(&process, BackgroundScheduler::Bulk);
+    process.start("ffmpeg", arguments);
+    if (!process.waitForStarted()) {
+        *error = "Не удалось запустить ffmpeg";
+        return false;
+    }
+    if (!process.waitForFinished(kEncodeTimeoutMs) || process.exitStatus() != QProcess::NormalExit
+        || process.exitCode() != 0) {
+        process.kill();
+        process.waitForFinished();
+        QFile::remove(fixture.filePath);
+        *error = QString::fromLocal8Bit(process.readAllStandardError()).trimmed();
+        return false;
+    }
+    return true;
+}
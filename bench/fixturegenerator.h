@@ -0,0 +1,59 @@
+#ifndef FIXTUREGENERATOR_H
+#define FIXTUREGENERATOR_H
+
+#include <QList>
+#include <QRandomGenerator>
+#include <QString>
+#include <QStringList>
+
+// Writes a tree of short synthetic tracks for import benchmarks, so no real
+// music has to be shipped: <artist>/<year> - <album>/[CD n/]<nn> - <title>.
+// Each file is a few seconds of chord tones with random silence at both
+// ends and random tags, some of them Cyrillic. WAV is written directly with
+// a LIST/INFO tag chunk; FLAC, MP3 and MP4 (AAC audio) are encoded from it
+// with ffmpeg, in parallel as Bulk work. The same seed gives the same tree.
+class FixtureGenerator
+{
+public:
+    struct Fixture {
+        QString filePath;
+        QString format;
+        QString title;
+        QString artist;
+        QString album;
+        QString genre;
+        int trackNumber = 0;
+        int year = 0;
+        int durationMs = 0;
+        int leadingSilenceMs = 0;
+        int trailingSilenceMs = 0;
+        double frequency = 0.0;
+        quint32 noiseSeed = 0;
+    };
+
+    static const int SampleRate = 44100;
+    static const int Channels = 2;
+    static const int MinDurationMs = 3000;
+    static const int MaxDurationMs = 10000;
+
+    explicit FixtureGenerator(quint32 seed = 1);
+
+    // Formats are spread round-robin over the files; ones that need ffmpeg
+    // are dropped with a warning when it is not installed. Returns the
+    // files actually written.
+    QList<Fixture> generate(const QString &rootDir, int count, QStringList formats);
+
+    static QStringList supportedFormats();
+    static bool hasFfmpeg();
+
+private:
+    QList<Fixture> plan(const QString &rootDir, int count, const QStringList &formats);
+    QString makeName(bool cyrillic, int minWords, int maxWords);
+
+    static bool writeWav(const QString &filePath, const Fixture &fixture);
+    static bool encode(const QString &wavPath, const Fixture &fixture, QString *error);
+
+    QRandomGenerator m_random;
+};
+
+#endif
@@ -0,0 +1,202 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include "backgroundscheduler.h"
+#include "databasemanager.h"
+#include "fixturegenerator.h"
+#include "libraryimporter.h"
+#include "trackanalyzer.h"
+
+// End-to-end import benchmark on generated fixtures: scan the tree, import
+// it with LibraryImporter (MP4 files are converted on the way, as in the
+// player; inserts and conversions are also reported on their own) and
+// analyse the new tracks with TrackAnalyzer. Needs no display;
+// everything it writes goes to temporary directories unless --fixtures is
+// given. The report is one JSON document; progress goes to stderr.
+
+static QJsonObject stage(const QString &name, qint64 ms, int files)
+{
+    QJsonObject object;
+    object["name"] = name;
+    object["ms"] = ms;
+    object["files"] = files;
+    object["filesPerSecond"] = ms > 0 ? files * 1000.0 / ms : 0.0;
+    return object;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("ImportBenchmark");
+    // Peak files and seek indexes go to a test location, not the player's.
+    QStandardPaths::setTestModeEnabled(true);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Бенчмарк импорта на сгенерированных файлах.");
+    parser.addHelpOption();
+    QCommandLineOption countOption("count", "Число файлов (по умолчанию 200).", "число", "200");
+    QCommandLineOption formatsOption("formats", "Форматы через запятую: wav, flac, mp3, mp4.", "список",
+                                     "wav,flac,mp3,mp4");
+    QCommandLineOption fixturesOption("fixtures", "Папка с фикстурами; если пуста, они создаются и остаются там.",
+                                      "папка");
+    QCommandLineOption seedOption("seed", "Начальное значение генератора.", "число", "1");
+    QCommandLineOption generateOnlyOption("generate-only", "Только создать фикстуры.");
+    QCommandLineOption skipAnalysisOption("skip-analysis", "Не запускать анализ громкости и тишины.");
+    QCommandLineOption jsonOption("json", "Записать отчёт в файл, а не в stdout.", "файл");
+    parser.addOptions({countOption, formatsOption, fixturesOption, seedOption, generateOnlyOption,
+                       skipAnalysisOption, jsonOption});
+    parser.process(app);
+
+    QTextStream err(stderr);
+    const int count = parser.value(countOption).toInt();
+    if (count <= 0) {
+        err << "Неверное число файлов: " << parser.value(countOption) << "\n";
+        return 2;
+    }
+    const QStringList formats = parser.value(formatsOption).split(',', Qt::SkipEmptyParts);
+    const quint32 seed = parser.value(seedOption).toUInt();
+
+    BackgroundScheduler scheduler;
+    QTemporaryDir workDirectory;
+    if (!workDirectory.isValid()) {
+        err << "Не удалось создать временную папку\n";
+        return 1;
+    }
+    const QString fixturesDir = parser.isSet(fixturesOption) ? QDir(parser.value(fixturesOption)).absolutePath()
+                                                             : workDirectory.filePath("fixtures");
+    QDir().mkpath(fixturesDir);
+
+    QJsonArray stages;
+    QElapsedTimer total;
+    total.start();
+    QElapsedTimer timer;
+
+    QStringList files = LibraryImporter::collectFiles(fixturesDir, true);
+    if (files.isEmpty()) {
+        err << "Создание " << count << " файлов в " << fixturesDir << "\n";
+        err.flush();
+        timer.start();
+        FixtureGenerator generator(seed);
+        const QList<FixtureGenerator::Fixture> fixtures = generator.generate(fixturesDir, count, formats);
+        stages.append(stage("generate", timer.elapsed(), fixtures.size()));
+        if (fixtures.isEmpty()) {
+            err << "Не удалось создать фикстуры\n";
+            return 1;
+        }
+    }
+    if (parser.isSet(generateOnlyOption)) {
+        return 0;
+    }
+
+    timer.start();
+    files = LibraryImporter::collectFiles(fixturesDir, true);
+    stages.append(stage("scan", timer.elapsed(), files.size()));
+    QJsonObject formatCounts;
+    qint64 bytes = 0;
+    for (const QString &file : files) {
+        const QString suffix = QFileInfo(file).suffix().toLower();
+        formatCounts[suffix] = formatCounts[suffix].toInt() + 1;
+        bytes += QFileInfo(file).size();
+    }
+
+    DatabaseManager dbManager(workDirectory.filePath("library.db"));
+    if (!dbManager.initializeDatabase()) {
+        err << "Не удалось создать базу данных\n";
+        return 1;
+    }
+
+    err << "Импорт " << files.size() << " файлов\n";
+    err.flush();
+    timer.start();
+    LibraryImporter importer(&dbManager);
+    importer.setOutputDirectory(workDirectory.filePath("converted"));
+    const QList<LibraryImporter::Result> results = importer.import(files);
+    const qint64 importMs = timer.elapsed();
+    int imported = 0;
+    int converted = 0;
+    int failed = 0;
+    for (const LibraryImporter::Result &result : results) {
+        if (result.trackId < 0) {
+            ++failed;
+            err << "Ошибка импорта " << result.sourcePath << ": " << result.error << "\n";
+        } else {
+            ++imported;
+            converted += result.converted ? 1 : 0;
+        }
+    }
+    QJsonObject importStage = stage("import", importMs, imported);
+    importStage["converted"] = converted;
+    importStage["failed"] = failed;
+    stages.append(importStage);
+    // Inside the import: the database writes on this thread and the ffmpeg
+    // conversions in parallel with them.
+    const LibraryImporter::Timing &timing = importer.lastTiming();
+    stages.append(stage("import.insert", timing.insertMs, timing.inserted));
+    QJsonObject convertStage = stage("import.convert", timing.conversionWallMs, timing.converted);
+    convertStage["busyMs"] = timing.conversionBusyMs;
+    stages.append(convertStage);
+
+    if (!parser.isSet(skipAnalysisOption)) {
+        const QList<TrackInfo> tracks = dbManager.getTracksPendingLoudness();
+        err << "Анализ " << tracks.size() << " треков\n";
+        err.flush();
+        timer.start();
+        TrackAnalyzer analyzer(&dbManager);
+        QSet<int> analysed;
+        QSet<int> ranges;
+        QEventLoop loop;
+        QObject::connect(&analyzer, &TrackAnalyzer::trackAnalyzed, &loop, [&analysed](int trackId) {
+            analysed.insert(trackId);
+        });
+        QObject::connect(&analyzer, &TrackAnalyzer::audioRangeFound, &loop, [&ranges](int trackId) {
+            ranges.insert(trackId);
+        });
+        QObject::connect(&analyzer, &TrackAnalyzer::finished, &loop, &QEventLoop::quit);
+        if (!tracks.isEmpty()) {
+            analyzer.analyze(tracks);
+            loop.exec();
+        }
+        QJsonObject analysisStage = stage("analyze", timer.elapsed(), analysed.size());
+        analysisStage["audioRanges"] = ranges.size();
+        analysisStage["failed"] = static_cast<int>(tracks.size() - analysed.size());
+        stages.append(analysisStage);
+        failed += tracks.size() - analysed.size();
+    }
+
+    QJsonObject report;
+    report["suite"] = "ImportBenchmark";
+    report["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    report["qtVersion"] = QString(qVersion());
+    report["seed"] = static_cast<qint64>(seed);
+    report["fixtures"] = fixturesDir;
+    report["files"] = files.size();
+    report["bytes"] = bytes;
+    report["formats"] = formatCounts;
+    report["stages"] = stages;
+    report["totalMs"] = total.elapsed();
+
+    const QByteArray json = QJsonDocument(report).toJson();
+    if (parser.isSet(jsonOption)) {
+        QFile file(parser.value(jsonOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            err << "Не удалось записать " << parser.value(jsonOption) << "\n";
+            return 1;
+        }
+        file.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,352 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QXmlStreamReader>
+#include <QtTest>
+#include <map>
+#include <memory>
+#include "databasemanager.h"
+#include "librarygenerator.h"
+
+// Library sizes come from AUDIOPLAYER_BENCH_SIZES, e.g. "10k,100k,1m"
+// (default "10k"); AUDIOPLAYER_BENCH_STORAGE=memory keeps the databases in
+// memory instead of temporary files. Each size is generated once and shared
+// by all cases.
+class LibraryBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void getAllTracks_data();
+    void getAllTracks();
+    void searchTracks_data();
+    void searchTracks();
+    void filterTracks_data();
+    void filterTracks();
+    void getPlaylistTracks_data();
+    void getPlaylistTracks();
+    void playlistOperations_data();
+    void playlistOperations();
+    void addToHistory_data();
+    void addToHistory();
+    void getHistory_data();
+    void getHistory();
+
+private:
+    struct Library {
+        std::unique_ptr<DatabaseManager> dbManager;
+        LibraryGenerator generator;
+    };
+
+    void addSizeRows();
+    Library *library(int size);
+
+    QList<int> m_sizes;
+    bool m_inMemory = false;
+    QTemporaryDir m_directory;
+    std::map<int, std::unique_ptr<Library>> m_libraries;
+};
+
+static int parseSize(QString text)
+{
+    text = text.trimmed().toLower();
+    int factor = 1;
+    if (text.endsWith('k')) {
+        factor = 1000;
+    } else if (text.endsWith('m')) {
+        factor = 1000000;
+    }
+    if (factor > 1) {
+        text.chop(1);
+    }
+    bool ok = false;
+    const int value = text.toInt(&ok);
+    return ok && value > 0 ? value * factor : 0;
+}
+
+static QString sizeLabel(int size)
+{
+    if (size % 1000000 == 0) {
+        return QString("%1m").arg(size / 1000000);
+    }
+    if (size % 1000 == 0) {
+        return QString("%1k").arg(size / 1000);
+    }
+    return QString::number(size);
+}
+
+void LibraryBenchmark::initTestCase()
+{
+    const QString sizes = qEnvironmentVariable("AUDIOPLAYER_BENCH_SIZES", "10k");
+    for (const QString &text : sizes.split(',', Qt::SkipEmptyParts)) {
+        const int size = parseSize(text);
+        if (size <= 0) {
+            QFAIL(qPrintable(QString("Неверный размер библиотеки: %1").arg(text)));
+        }
+        m_sizes << size;
+    }
+    m_inMemory = qEnvironmentVariable("AUDIOPLAYER_BENCH_STORAGE") == "memory";
+    QVERIFY(m_directory.isValid());
+}
+
+void LibraryBenchmark::addSizeRows()
+{
+    QTest::addColumn<int>("size");
+    for (int size : m_sizes) {
+        QTest::newRow(qPrintable(sizeLabel(size))) << size;
+    }
+}
+
+LibraryBenchmark::Library *LibraryBenchmark::library(int size)
+{
+    auto it = m_libraries.find(size);
+    if (it != m_libraries.end()) {
+        return it->second.get();
+    }
+    auto library = std::make_unique<Library>();
+    const QString path = m_inMemory ? QString(":memory:")
+                                    : m_directory.filePath(QString("library-%1.db").arg(size));
+    library->dbManager = std::make_unique<DatabaseManager>(path);
+    if (!library->dbManager->initializeDatabase()) {
+        return nullptr;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    if (!library->generator.generate(library->dbManager.get(), size)) {
+        return nullptr;
+    }
+    qInfo().noquote() << QString("Библиотека на %1 треков создана за %2 мс").arg(size).arg(timer.elapsed());
+    Library *result = library.get();
+    m_libraries[size] = std::move(library);
+    return result;
+}
+
+void LibraryBenchmark::getAllTracks_data()
+{
+    addSizeRows();
+}
+
+void LibraryBenchmark::getAllTracks()
+{
+    QFETCH(int, size);
+    Library *lib = library(size);
+    QVERIFY(lib);
+    QList<TrackInfo> tracks;
+    QBENCHMARK {
+        tracks = lib->dbManager->getAllTracks();
+    }
+    QCOMPARE(tracks.size(), size);
+}
+
+void LibraryBenchmark::searchTracks_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<QString>("query");
+    for (int size : m_sizes) {
+        const QString label = sizeLabel(size);
+        QTest::newRow(qPrintable(label + "/latin")) << size << QString("night");
+        QTest::newRow(qPrintable(label + "/cyrillic")) << size << QString("Серебр");
+        QTest::newRow(qPrintable(label + "/miss")) << size << QString("qzxj");
+    }
+}
+
+void LibraryBenchmark::searchTracks()
+{
+    QFETCH(int, size);
+    QFETCH(QString, query);
+    Library *lib = library(size);
+    QVERIFY(lib);
+    QBENCHMARK {
+        lib->dbManager->searchTracks(query);
+    }
+}
+
+void LibraryBenchmark::filterTracks_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<QString>("kind");
+    for (int size : m_sizes) {
+        const QString label = sizeLabel(size);
+        for (const QString &kind : {"artist", "album", "tag", "artist+tag"}) {
+            QTest::newRow(qPrintable(label + "/" + kind)) << size << kind;
+        }
+    }
+}
+
+void LibraryBenchmark::filterTracks()
+{
+    QFETCH(int, size);
+    QFETCH(QString, kind);
+    Library *lib = library(size);
+    QVERIFY(lib);
+    // The most popular names, i.e. the largest results.
+    const QString artist = kind.contains("artist") ? lib->generator.artists().first() : QString();
+    const QString album = kind == "album" ? lib->generator.albums().first() : QString();
+    const QStringList tags = kind.contains("tag") ? QStringList{lib->generator.tags().first()} : QStringList();
+    QList<TrackInfo> tracks;
+    QBENCHMARK {
+        tracks = lib->dbManager->filterTracks(artist, album, tags);
+    }
+    QVERIFY(!tracks.isEmpty());
+}
+
+void LibraryBenchmark::getPlaylistTracks_data()
+{
+    addSizeRows();
+}
+
+void LibraryBenchmark::getPlaylistTracks()
+{
+    QFETCH(int, size);
+    Library *lib = library(size);
+    QVERIFY(lib);
+    const QList<int> playlists = lib->generator.playlistIds();
+    QBENCHMARK {
+        for (int playlistId : playlists) {
+            lib->dbManager->getPlaylistTracks(playlistId);
+        }
+    }
+}
+
+void LibraryBenchmark::playlistOperations_data()
+{
+    addSizeRows();
+}
+
+void LibraryBenchmark::playlistOperations()
+{
+    QFETCH(int, size);
+    Library *lib = library(size);
+    QVERIFY(lib);
+    const int count = qMin(100, size);
+    // Leaves the library as it was, so every iteration does the same work.
+    QBENCHMARK {
+        const int playlistId = lib->dbManager->createPlaylist("Тестовый плейлист");
+        for (int trackId = 1; trackId <= count; ++trackId) {
+            lib->dbManager->addTrackToPlaylist(playlistId, trackId);
+        }
+        lib->dbManager->updatePlaylistName(playlistId, "Renamed playlist");
+        lib->dbManager->getPlaylistTracks(playlistId);
+        lib->dbManager->getAllPlaylists();
+        for (int trackId = 1; trackId <= count; ++trackId) {
+            lib->dbManager->removeTrackFromPlaylist(playlistId, trackId);
+        }
+        lib->dbManager->deletePlaylist(playlistId);
+    }
+}
+
+void LibraryBenchmark::addToHistory_data()
+{
+    addSizeRows();
+}
+
+void LibraryBenchmark::addToHistory()
+{
+    QFETCH(int, size);
+    Library *lib = library(size);
+    QVERIFY(lib);
+    int trackId = 0;
+    QBENCHMARK {
+        lib->dbManager->addToHistory(1 + trackId++ % size);
+    }
+}
+
+void LibraryBenchmark::getHistory_data()
+{
+    addSizeRows();
+}
+
+void LibraryBenchmark::getHistory()
+{
+    QFETCH(int, size);
+    Library *lib = library(size);
+    QVERIFY(lib);
+    QList<TrackInfo> tracks;
+    QBENCHMARK {
+        tracks = lib->dbManager->getHistory(100);
+    }
+    QVERIFY(!tracks.isEmpty());
+}
+
+// QtTest has no JSON logger; its XML log carries the same numbers.
+static bool writeJson(const QString &xmlPath, const QString &jsonPath, bool inMemory)
+{
+    QFile xmlFile(xmlPath);
+    if (!xmlFile.open(QIODevice::ReadOnly)) {
+        qWarning() << "Не удалось прочитать результаты QtTest:" << xmlPath;
+        return false;
+    }
+    QJsonArray results;
+    QString function;
+    QXmlStreamReader xml(&xmlFile);
+    while (!xml.atEnd()) {
+        if (!xml.readNextStartElement()) {
+            continue;
+        }
+        const QXmlStreamAttributes attributes = xml.attributes();
+        if (xml.name() == QLatin1String("TestFunction")) {
+            function = attributes.value("name").toString();
+        } else if (xml.name() == QLatin1String("BenchmarkResult")) {
+            // The logger already divides by the iteration count.
+            QJsonObject result;
+            result["function"] = function;
+            result["tag"] = attributes.value("tag").toString();
+            result["metric"] = attributes.value("metric").toString();
+            result["value"] = attributes.value("value").toDouble();
+            result["iterations"] = attributes.value("iterations").toInt();
+            results.append(result);
+        }
+    }
+    if (xml.hasError()) {
+        qWarning() << "Ошибка разбора результатов QtTest:" << xml.errorString();
+        return false;
+    }
+
+    QJsonObject report;
+    report["suite"] = "LibraryBenchmark";
+    report["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    report["qtVersion"] = QString(qVersion());
+    report["storage"] = inMemory ? "memory" : "file";
+    report["results"] = results;
+    QFile jsonFile(jsonPath);
+    if (!jsonFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Не удалось записать" << jsonPath;
+        return false;
+    }
+    jsonFile.write(QJsonDocument(report).toJson());
+    return true;
+}
+
+// Takes the usual QtTest options plus "--json <файл>" (default
+// librarybenchmark.json); the value per result is per iteration.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList arguments = app.arguments();
+    QString jsonPath = "librarybenchmark.json";
+    const int jsonIndex = arguments.indexOf("--json");
+    if (jsonIndex > 0 && jsonIndex + 1 < arguments.size()) {
+        jsonPath = arguments[jsonIndex + 1];
+        arguments.remove(jsonIndex, 2);
+    }
+
+    QTemporaryDir logDirectory;
+    const QString xmlPath = logDirectory.filePath("results.xml");
+    arguments << "-o" << xmlPath + ",xml" << "-o" << "-,txt";
+
+    LibraryBenchmark benchmark;
+    const int failures = QTest::qExec(&benchmark, arguments);
+    const bool inMemory = qEnvironmentVariable("AUDIOPLAYER_BENCH_STORAGE") == "memory";
+    if (!writeJson(xmlPath, jsonPath, inMemory)) {
+        return failures > 0 ? failures : 1;
+    }
+    return failures;
+}
+
+#include "librarybenchmark.moc"
@@ -0,0 +1,294 @@
+#include "librarygenerator.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QHash>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <algorithm>
+
+static const QStringList kLatinFirst = {
+    "Midnight", "Silver", "Electric", "Northern", "Velvet", "Broken", "Golden", "Crystal",
+    "Neon", "Wild", "Lost", "Black", "Paper", "Static", "Hollow", "Young"
+};
+static const QStringList kLatinSecond = {
+    "Wolves", "Rivers", "Echoes", "Lights", "Hearts", "Machines", "Tigers", "Horizon",
+    "Garden", "Signal", "Ghosts", "Kings", "Satellites", "Motel", "Ocean", "Parade"
+};
+static const QStringList kCyrillicFirst = {
+    "Ночные", "Серебряные", "Северные", "Тёмные", "Белые", "Дикие", "Звёздные", "Тихие",
+    "Летние", "Городские", "Бумажные", "Красные", "Старые", "Лесные"
+};
+static const QStringList kCyrillicSecond = {
+    "Снайперы", "Волны", "Огни", "Птицы", "Реки", "Сны", "Ветра", "Тени",
+    "Крыши", "Поезда", "Звери", "Голоса", "Окна", "Маяки"
+};
+static const QStringList kLatinWords = {
+    "love", "night", "fire", "city", "dream", "rain", "home", "summer", "heart", "road",
+    "light", "gold", "blue", "forever", "dance", "shadow", "river", "stars", "winter", "time"
+};
+static const QStringList kCyrillicWords = {
+    "любовь", "ночь", "огонь", "город", "мечта", "дождь", "дом", "лето", "сердце", "дорога",
+    "свет", "золото", "небо", "навсегда", "танец", "тень", "река", "звёзды", "зима", "время"
+};
+static const QStringList kGenres = {
+    "Rock", "Pop", "Electronic", "Hip-Hop", "Jazz", "Indie", "Metal", "Classical", "Ambient",
+    "Folk", "Techno", "House", "Soul", "Punk", "Blues", "Reggae", "Рок", "Поп", "Шансон",
+    "Авторская песня", "Русский рэп", "Эстрада", "Бард", "Инди", "Электроника"
+};
+static const QStringList kMoods = {
+    "chill", "party", "workout", "focus", "sleep", "road trip",
+    "спокойное", "для бега", "вечеринка", "грустное", "в дорогу", "на работу"
+};
+static const int kCommitEvery = 20000;
+
+LibraryGenerator::LibraryGenerator(quint32 seed)
+    : m_random(seed)
+{
+}
+
+bool LibraryGenerator::generate(DatabaseManager *dbManager, int trackCount)
+{
+    m_artists.clear();
+    m_albums.clear();
+    m_tags.clear();
+    m_artistIds.clear();
+    m_tagIds.clear();
+    m_playlistIds.clear();
+    m_trackCount = trackCount;
+
+    QSqlDatabase database = dbManager->database();
+    if (!database.transaction()) {
+        qWarning() << "Не удалось начать транзакцию:" << database.lastError();
+        return false;
+    }
+    const bool ok = insertArtists(database) && insertTags(database) && insertTracks(database, trackCount)
+                    && insertPlaylists(database) && insertHistory(database);
+    if (!ok) {
+        database.rollback();
+        return false;
+    }
+    return database.commit();
+}
+
+std::vector<double> LibraryGenerator::zipfWeights(int count)
+{
+    std::vector<double> cumulative(count);
+    double total = 0.0;
+    for (int index = 0; index < count; ++index) {
+        total += 1.0 / (index + 1);
+        cumulative[index] = total;
+    }
+    return cumulative;
+}
+
+int LibraryGenerator::pickZipf(const std::vector<double> &cumulative)
+{
+    const double value = m_random.generateDouble() * cumulative.back();
+    const auto it = std::upper_bound(cumulative.begin(), cumulative.end(), value);
+    return qMin(static_cast<int>(it - cumulative.begin()), static_cast<int>(cumulative.size()) - 1);
+}
+
+QString LibraryGenerator::makeName(const QStringList &first, const QStringList &second, int index)
+{
+    const int combinations = first.size() * second.size();
+    QString name = first[index % first.size()] + " " + second[(index / first.size()) % second.size()];
+    if (index >= combinations) {
+        name += " " + QString::number(index / combinations + 1);
+    }
+    return name;
+}
+
+QString LibraryGenerator::makeTitle(bool cyrillic, int minWords, int maxWords)
+{
+    const QStringList &words = cyrillic ? kCyrillicWords : kLatinWords;
+    const int count = m_random.bounded(minWords, maxWords + 1);
+    QStringList parts;
+    for (int index = 0; index < count; ++index) {
+        parts << words[m_random.bounded(static_cast<int>(words.size()))];
+    }
+    parts[0][0] = parts[0][0].toUpper();
+    return parts.join(' ');
+}
+
+bool LibraryGenerator::insertArtists(QSqlDatabase &database)
+{
+    const int count = qMax(50, m_trackCount / 20);
+    QSqlQuery query(database);
+    query.prepare("INSERT INTO artists (name) VALUES (?)");
+    int latin = 0;
+    int cyrillic = 0;
+    for (int index = 0; index < count; ++index) {
+        const QString name = m_random.bounded(10) < 4
+            ? makeName(kCyrillicFirst, kCyrillicSecond, cyrillic++)
+            : makeName(kLatinFirst, kLatinSecond, latin++);
+        query.addBindValue(name);
+        if (!query.exec()) {
+            qWarning() << "Ошибка добавления исполнителя:" << query.lastError();
+            return false;
+        }
+        m_artists << name;
+        m_artistIds << query.lastInsertId().toInt();
+    }
+    return true;
+}
+
+bool LibraryGenerator::insertTags(QSqlDatabase &database)
+{
+    QSqlQuery query(database);
+    query.prepare("INSERT INTO tags (name) VALUES (?)");
+    for (const QString &tag : kGenres + kMoods) {
+        query.addBindValue(tag);
+        if (!query.exec()) {
+            qWarning() << "Ошибка добавления тега:" << query.lastError();
+            return false;
+        }
+        m_tags << tag;
+        m_tagIds << query.lastInsertId().toInt();
+    }
+    return true;
+}
+
+bool LibraryGenerator::insertTracks(QSqlDatabase &database, int trackCount)
+{
+    const std::vector<double> artistWeights = zipfWeights(m_artists.size());
+    const std::vector<double> genreWeights = zipfWeights(kGenres.size());
+    const std::vector<double> moodWeights = zipfWeights(kMoods.size());
+
+    QSqlQuery trackQuery(database);
+    trackQuery.prepare("INSERT INTO tracks (file_path, title, artist, album, duration, play_count, last_played) "
+                       "VALUES (?, ?, ?, ?, ?, ?, ?)");
+    QSqlQuery albumQuery(database);
+    albumQuery.prepare("INSERT OR IGNORE INTO albums (name) VALUES (?)");
+    QSqlQuery albumIdQuery(database);
+    albumIdQuery.prepare("SELECT id FROM albums WHERE name = ?");
+    QSqlQuery trackArtistQuery(database);
+    trackArtistQuery.prepare("INSERT INTO track_artists (track_id, artist_id) VALUES (?, ?)");
+    QSqlQuery trackAlbumQuery(database);
+    trackAlbumQuery.prepare("INSERT INTO track_albums (track_id, album_id) VALUES (?, ?)");
+    QSqlQuery trackTagQuery(database);
+    trackTagQuery.prepare("INSERT OR IGNORE INTO track_tags (track_id, tag_id) VALUES (?, ?)");
+
+    QHash<QString, int> albumIds;
+    QHash<QString, int> albumSizes;
+    const QDateTime now = QDateTime::currentDateTime();
+    int written = 0;
+    int albumNumber = 0;
+    while (written < trackCount) {
+        const int artist = pickZipf(artistWeights);
+        const bool cyrillic = m_artists[artist].at(0).script() == QChar::Script_Cyrillic;
+        // Shared names such as "Greatest Hits" are realistic, so album names
+        // may repeat across artists.
+        const QString album = makeTitle(cyrillic, 1, 3);
+        if (!albumIds.contains(album)) {
+            albumQuery.addBindValue(album);
+            albumIdQuery.addBindValue(album);
+            if (!albumQuery.exec() || !albumIdQuery.exec() || !albumIdQuery.next()) {
+                qWarning() << "Ошибка добавления альбома:" << albumQuery.lastError();
+                return false;
+            }
+            albumIds.insert(album, albumIdQuery.value(0).toInt());
+        }
+        const int genre = m_tagIds[pickZipf(genreWeights)];
+        const int albumSize = qMin(static_cast<int>(m_random.bounded(6, 17)), trackCount - written);
+        albumSizes[album] += albumSize;
+        ++albumNumber;
+
+        for (int number = 1; number <= albumSize; ++number, ++written) {
+            const QString title = makeTitle(cyrillic, 1, 4);
+            const QString filePath = QString("/music/%1/%2 (%3)/%4 - %5.mp3")
+                                         .arg(m_artists[artist], album)
+                                         .arg(albumNumber)
+                                         .arg(number, 2, 10, QChar('0'))
+                                         .arg(title);
+            // Most of the library is rarely played.
+            const int playCount = m_random.bounded(100) < 30 ? static_cast<int>(1000.0 / (1 + m_random.bounded(1000))) : 0;
+            trackQuery.addBindValue(filePath);
+            trackQuery.addBindValue(title);
+            trackQuery.addBindValue(m_artists[artist]);
+            trackQuery.addBindValue(album);
+            trackQuery.addBindValue(m_random.bounded(90, 480));
+            trackQuery.addBindValue(playCount);
+            trackQuery.addBindValue(playCount > 0 ? QVariant(now.addSecs(-m_random.bounded(365 * 24 * 3600))) : QVariant());
+            if (!trackQuery.exec()) {
+                qWarning() << "Ошибка добавления трека:" << trackQuery.lastError();
+                return false;
+            }
+            const int trackId = trackQuery.lastInsertId().toInt();
+
+            trackArtistQuery.addBindValue(trackId);
+            trackArtistQuery.addBindValue(m_artistIds[artist]);
+            trackAlbumQuery.addBindValue(trackId);
+            trackAlbumQuery.addBindValue(albumIds.value(album));
+            trackTagQuery.addBindValue(trackId);
+            trackTagQuery.addBindValue(genre);
+            if (!trackArtistQuery.exec() || !trackAlbumQuery.exec() || !trackTagQuery.exec()) {
+                qWarning() << "Ошибка добавления связей трека:" << trackTagQuery.lastError();
+                return false;
+            }
+            if (m_random.bounded(100) < 20) {
+                trackTagQuery.addBindValue(trackId);
+                trackTagQuery.addBindValue(m_tagIds[kGenres.size() + pickZipf(moodWeights)]);
+                trackTagQuery.exec();
+            }
+
+            if ((written + 1) % kCommitEvery == 0 && (!database.commit() || !database.transaction())) {
+                qWarning() << "Ошибка фиксации транзакции:" << database.lastError();
+                return false;
+            }
+        }
+    }
+
+    m_albums = albumSizes.keys();
+    std::sort(m_albums.begin(), m_albums.end(), [&albumSizes](const QString &a, const QString &b) {
+        return albumSizes.value(a) > albumSizes.value(b);
+    });
+    return true;
+}
+
+bool LibraryGenerator::insertPlaylists(QSqlDatabase &database)
+{
+    QSqlQuery playlistQuery(database);
+    playlistQuery.prepare("INSERT INTO playlists (name) VALUES (?)");
+    QSqlQuery trackQuery(database);
+    trackQuery.prepare("INSERT OR IGNORE INTO playlist_tracks (playlist_id, track_id, position) VALUES (?, ?, ?)");
+    for (int index = 0; index < PlaylistCount; ++index) {
+        const bool cyrillic = index % 2 == 1;
+        playlistQuery.addBindValue(makeTitle(cyrillic, 1, 3) + QString(" %1").arg(index + 1));
+        if (!playlistQuery.exec()) {
+            qWarning() << "Ошибка создания плейлиста:" << playlistQuery.lastError();
+            return false;
+        }
+        const int playlistId = playlistQuery.lastInsertId().toInt();
+        m_playlistIds << playlistId;
+        const int size = qMin(m_trackCount, static_cast<int>(m_random.bounded(20, 501)));
+        for (int position = 0; position < size; ++position) {
+            trackQuery.addBindValue(playlistId);
+            trackQuery.addBindValue(1 + m_random.bounded(m_trackCount));
+            trackQuery.addBindValue(position);
+            if (!trackQuery.exec()) {
+                qWarning() << "Ошибка добавления трека в плейлист:" << trackQuery.lastError();
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool LibraryGenerator::insertHistory(QSqlDatabase &database)
+{
+    QSqlQuery query(database);
+    query.prepare("INSERT INTO history (track_id, played_at) VALUES (?, ?)");
+    const int entries = qMin(MaxHistoryEntries, m_trackCount * 2);
+    const QDateTime now = QDateTime::currentDateTime();
+    for (int index = 0; index < entries; ++index) {
+        // Cubing skews plays towards the first tracks, i.e. favourites.
+        const double skew = m_random.generateDouble();
+        query.addBindValue(1 + static_cast<int>(skew * skew * skew * (m_trackCount - 1)));
+        query.addBindValue(now.addSecs(-m_random.bounded(365 * 24 * 3600)));
+        if (!query.exec()) {
+            qWarning() << "Ошибка добавления записи истории:" << query.lastError();
+            return false;
+        }
+    }
+    return true;
+}
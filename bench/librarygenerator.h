@@ -0,0 +1,56 @@
+#ifndef LIBRARYGENERATOR_H
+#define LIBRARYGENERATOR_H
+
+#include <QList>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <vector>
+#include "databasemanager.h"
+
+// Fills an empty library with made-up but plausibly shaped data: a few
+// artists own most of the tracks, albums hold 6-16 tracks, genres and moods
+// follow the same long tail, about 40% of the names are Cyrillic. Written
+// straight through the manager's connection in large transactions, so even
+// a million tracks take seconds rather than hours. The same seed always
+// gives the same library.
+class LibraryGenerator
+{
+public:
+    explicit LibraryGenerator(quint32 seed = 1);
+
+    bool generate(DatabaseManager *dbManager, int trackCount);
+
+    // Most popular first.
+    const QStringList &artists() const { return m_artists; }
+    const QStringList &albums() const { return m_albums; }
+    const QStringList &tags() const { return m_tags; }
+    const QList<int> &playlistIds() const { return m_playlistIds; }
+    int trackCount() const { return m_trackCount; }
+
+    static const int PlaylistCount = 20;
+    static const int MaxHistoryEntries = 200000;
+
+private:
+    // Index in [0, count) with weight 1 / (index + 1).
+    int pickZipf(const std::vector<double> &cumulative);
+    static std::vector<double> zipfWeights(int count);
+    QString makeName(const QStringList &first, const QStringList &second, int index);
+    QString makeTitle(bool cyrillic, int minWords, int maxWords);
+
+    bool insertArtists(QSqlDatabase &database);
+    bool insertTags(QSqlDatabase &database);
+    bool insertTracks(QSqlDatabase &database, int trackCount);
+    bool insertPlaylists(QSqlDatabase &database);
+    bool insertHistory(QSqlDatabase &database);
+
+    QRandomGenerator m_random;
+    QStringList m_artists;
+    QStringList m_albums;
+    QStringList m_tags;
+    QList<int> m_artistIds;
+    QList<int> m_tagIds;
+    QList<int> m_playlistIds;
+    int m_trackCount = 0;
+};
+
+#endif
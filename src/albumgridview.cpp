@@ -0,0 +1,96 @@
+#include "albumgridview.h"
+#include <QResizeEvent>
+#include <QShowEvent>
+
+AlbumGridView::AlbumGridView(QWidget *parent)
+    : QListView(parent)
+    , m_albumModel(nullptr)
+{
+    setViewMode(QListView::IconMode);
+    setMovement(QListView::Static);
+    setResizeMode(QListView::Adjust);
+    setFlow(QListView::LeftToRight);
+    setWrapping(true);
+    setUniformItemSizes(true);
+    setLayoutMode(QListView::Batched);
+    setBatchSize(500);
+    setWordWrap(true);
+    setIconSize(QSize(128, 128));
+    setGridSize(QSize(150, 180));
+    setSelectionMode(QAbstractItemView::SingleSelection);
+    setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+    m_requestTimer.setSingleShot(true);
+    m_requestTimer.setInterval(16);
+    connect(&m_requestTimer, &QTimer::timeout, this, &AlbumGridView::requestVisibleThumbnails);
+}
+
+void AlbumGridView::setAlbumModel(AlbumModel *model)
+{
+    m_albumModel = model;
+    setModel(model);
+    connect(model, &QAbstractItemModel::modelReset, this, &AlbumGridView::scheduleThumbnailRequest);
+    connect(model, &QAbstractItemModel::layoutChanged, this, &AlbumGridView::scheduleThumbnailRequest);
+}
+
+void AlbumGridView::resizeEvent(QResizeEvent *event)
+{
+    QListView::resizeEvent(event);
+    scheduleThumbnailRequest();
+}
+
+void AlbumGridView::scrollContentsBy(int dx, int dy)
+{
+    QListView::scrollContentsBy(dx, dy);
+    scheduleThumbnailRequest();
+}
+
+void AlbumGridView::showEvent(QShowEvent *event)
+{
+    QListView::showEvent(event);
+    scheduleThumbnailRequest();
+}
+
+void AlbumGridView::scheduleThumbnailRequest()
+{
+    if (!m_requestTimer.isActive()) {
+        m_requestTimer.start();
+    }
+}
+
+void AlbumGridView::requestVisibleThumbnails()
+{
+    if (!m_albumModel || !isVisible() || m_albumModel->albumCount() == 0) {
+        return;
+    }
+    int first = firstVisibleRow();
+    if (first < 0) {
+        return;
+    }
+    m_albumModel->requestThumbnails(first, lastVisibleRow(first));
+}
+
+int AlbumGridView::firstVisibleRow() const
+{
+    QSize cell = gridSize();
+    int stepX = qMax(1, cell.width() / 4);
+    int stepY = qMax(1, cell.height() / 4);
+    for (int y = 0; y < viewport()->height(); y += stepY) {
+        for (int x = 0; x < viewport()->width(); x += stepX) {
+            QModelIndex index = indexAt(QPoint(x, y));
+            if (index.isValid()) {
+                return index.row();
+            }
+        }
+    }
+    return -1;
+}
+
+int AlbumGridView::lastVisibleRow(int first) const
+{
+    QSize cell = gridSize();
+    int perRow = qMax(1, viewport()->width() / qMax(1, cell.width()));
+    int visibleRows = viewport()->height() / qMax(1, cell.height()) + 2;
+    int rowStart = first - first % perRow;
+    return qMin(rowStart + perRow * visibleRows - 1, m_albumModel->albumCount() - 1);
+}
@@ -0,0 +1,34 @@
+#ifndef ALBUMGRIDVIEW_H
+#define ALBUMGRIDVIEW_H
+
+#include <QListView>
+#include <QTimer>
+#include "albummodel.h"
+
+class AlbumGridView : public QListView
+{
+    Q_OBJECT
+
+public:
+    explicit AlbumGridView(QWidget *parent = nullptr);
+
+    void setAlbumModel(AlbumModel *model);
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+    void showEvent(QShowEvent *event) override;
+
+private slots:
+    void requestVisibleThumbnails();
+
+private:
+    void scheduleThumbnailRequest();
+    int firstVisibleRow() const;
+    int lastVisibleRow(int first) const;
+
+    AlbumModel *m_albumModel;
+    QTimer m_requestTimer;
+};
+
+#endif
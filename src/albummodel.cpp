@@ -0,0 +1,108 @@
+#include "albummodel.h"
+
+AlbumModel::AlbumModel(CoverThumbnailCache *thumbnails, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_thumbnails(thumbnails)
+{
+    connect(m_thumbnails, &CoverThumbnailCache::thumbnailReady,
+            this, &AlbumModel::onThumbnailReady);
+}
+
+int AlbumModel::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return m_albums.size();
+}
+
+QVariant AlbumModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_albums.size()) {
+        return QVariant();
+    }
+
+    const AlbumInfo &album = m_albums[index.row()];
+
+    switch (role) {
+    case AlbumNameRole:
+    case Qt::DisplayRole:
+        return album.name;
+    case ArtistRole:
+        return album.artist;
+    case TrackCountRole:
+        return album.trackCount;
+    case CoverPathRole:
+        return album.coverPath;
+    case Qt::DecorationRole:
+        return m_thumbnails->thumbnail(thumbnailKey(album));
+    case Qt::ToolTipRole:
+        return QString("%1\n%2\nТреков: %3")
+            .arg(album.name)
+            .arg(album.artist.isEmpty() ? "Неизвестный исполнитель" : album.artist)
+            .arg(album.trackCount);
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> AlbumModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles[AlbumNameRole] = "album";
+    roles[ArtistRole] = "artist";
+    roles[TrackCountRole] = "trackCount";
+    roles[CoverPathRole] = "coverPath";
+    return roles;
+}
+
+void AlbumModel::setAlbums(const QList<AlbumInfo> &albums)
+{
+    beginResetModel();
+    m_albums = albums;
+    m_rowByKey.clear();
+    m_rowByKey.reserve(m_albums.size());
+    for (int i = 0; i < m_albums.size(); ++i) {
+        m_rowByKey.insert(thumbnailKey(m_albums[i]), i);
+    }
+    endResetModel();
+}
+
+AlbumInfo AlbumModel::albumAt(int index) const
+{
+    if (index >= 0 && index < m_albums.size()) {
+        return m_albums[index];
+    }
+    AlbumInfo empty;
+    empty.trackCount = 0;
+    return empty;
+}
+
+void AlbumModel::requestThumbnails(int firstRow, int lastRow)
+{
+    firstRow = qMax(firstRow, 0);
+    lastRow = qMin(lastRow, m_albums.size() - 1);
+    QList<ThumbnailRequest> requests;
+    for (int row = firstRow; row <= lastRow; ++row) {
+        const AlbumInfo &album = m_albums[row];
+        ThumbnailRequest request;
+        request.key = thumbnailKey(album);
+        request.coverPath = album.coverPath;
+        request.trackFilePath = album.firstFilePath;
+        requests << request;
+    }
+    m_thumbnails->request(requests);
+}
+
+void AlbumModel::onThumbnailReady(const QString &key)
+{
+    auto it = m_rowByKey.constFind(key);
+    if (it == m_rowByKey.constEnd()) {
+        return;
+    }
+    QModelIndex changed = index(it.value());
+    emit dataChanged(changed, changed, {Qt::DecorationRole});
+}
+
+QString AlbumModel::thumbnailKey(const AlbumInfo &album)
+{
+    return album.artist + '\n' + album.name + '\n' + album.coverPath;
+}
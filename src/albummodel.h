@@ -0,0 +1,44 @@
+#ifndef ALBUMMODEL_H
+#define ALBUMMODEL_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QList>
+#include "databasemanager.h"
+#include "coverthumbnailcache.h"
+
+class AlbumModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Role {
+        AlbumNameRole = Qt::UserRole + 1,
+        ArtistRole,
+        TrackCountRole,
+        CoverPathRole
+    };
+
+    explicit AlbumModel(CoverThumbnailCache *thumbnails, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    void setAlbums(const QList<AlbumInfo> &albums);
+    AlbumInfo albumAt(int index) const;
+    int albumCount() const { return m_albums.size(); }
+    void requestThumbnails(int firstRow, int lastRow);
+
+private slots:
+    void onThumbnailReady(const QString &key);
+
+private:
+    static QString thumbnailKey(const AlbumInfo &album);
+
+    CoverThumbnailCache *m_thumbnails;
+    QList<AlbumInfo> m_albums;
+    QHash<QString, int> m_rowByKey;
+};
+
+#endif
@@ -1,59 +1,205 @@
 #include "audioplayer.h"
+#include "backgroundscheduler.h"
+#include "mappedfile.h"
 #include <QMediaMetaData>
 #include <QFileInfo>
 #include <QDir>
 #include <QStandardPaths>
 #include <QImage>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+static const qint64 kGaplessPreloadMs = 15000;
+// Ahead of the standby preload, so it opens a warm file.
+static const qint64 kPrefetchLeadMs = 25000;
+static const qint64 kEndOfMediaToleranceMs = 250;
 
 AudioPlayer::AudioPlayer(DatabaseManager *dbManager, QObject *parent)
     : QObject(parent)
+    , m_engine(nullptr)
+    , m_mediaDevices(new QMediaDevices(this))
+    , m_backend(MediaPlayerBackend)
     , m_dbManager(dbManager)
     , m_trackLoaded(false)
     , m_autoPlay(false)
+    , m_metadataTrackId(-1)
+    , m_gaplessEnabled(true)
+    , m_skipSilence(true)
+    , m_pendingStartMs(0)
+    , m_standbyStartMs(0)
+    , m_playToEnd(false)
+    , m_pcmCacheMb(128)
+    , m_resamplerQuality(Resampler::Standard)
+    , m_outputBufferMs(2000)
+    , m_outputPeriodMs(40)
+    , m_standbyPrepared(false)
+    , m_standbyReady(false)
+    , m_volume(1.0f)
+    , m_replayGainMode(ReplayGainTrack)
+    , m_playerGain(1.0f)
+    , m_standbyGain(1.0f)
 {
+    m_currentTrack.id = -1;
+    m_nextTrack.id = -1;
     m_audioOutput = new QAudioOutput(QMediaDevices::defaultAudioOutput(), this);
     m_player = new QMediaPlayer(this);
     m_player->setAudioOutput(m_audioOutput);
+    m_standbyOutput = new QAudioOutput(QMediaDevices::defaultAudioOutput(), this);
+    m_standbyPlayer = new QMediaPlayer(this);
+    m_standbyPlayer->setAudioOutput(m_standbyOutput);
+    m_volume = m_audioOutput->volume();
+    m_latencyTracker = new LatencyTracker(this);
+    m_prefetcher = new Prefetcher(this);
+    m_glitchMonitor = new GlitchMonitor(this);
     
-    connect(m_player, &QMediaPlayer::mediaStatusChanged, 
+    connectPlayer(m_player);
+    connectPlayer(m_standbyPlayer);
+    connect(this, &AudioPlayer::stateChanged, this, [this](QMediaPlayer::PlaybackState state) {
+        if (state == QMediaPlayer::PlayingState) {
+            m_latencyTracker->mark(LatencyTracker::Playing);
+        }
+        m_glitchMonitor->setPlaying(state == QMediaPlayer::PlayingState && m_backend == MediaPlayerBackend);
+        BackgroundScheduler::instance()->setPlaybackActive(state == QMediaPlayer::PlayingState);
+    });
+    connect(this, &AudioPlayer::trackChanged, m_glitchMonitor, &GlitchMonitor::setTrack);
+    connect(m_mediaDevices, &QMediaDevices::audioOutputsChanged, this, &AudioPlayer::onAudioOutputsChanged);
+}
+
+AudioPlayer::~AudioPlayer()
+{
+    stop();
+    // The engine's audio thread uses m_equalizer, so it has to go first.
+    delete m_engine;
+    m_engine = nullptr;
+}
+
+void AudioPlayer::connectPlayer(QMediaPlayer *player)
+{
+    connect(player, &QMediaPlayer::mediaStatusChanged, 
             this, &AudioPlayer::onMediaStatusChanged);
-    connect(m_player, &QMediaPlayer::errorOccurred, 
+    connect(player, &QMediaPlayer::errorOccurred, 
             this, &AudioPlayer::onErrorOccurred);
-    connect(m_player, &QMediaPlayer::positionChanged, 
+    connect(player, &QMediaPlayer::positionChanged, 
             this, &AudioPlayer::onPositionChanged);
-    connect(m_player, &QMediaPlayer::durationChanged, 
+    connect(player, &QMediaPlayer::durationChanged, 
             this, &AudioPlayer::onDurationChanged);
-    connect(m_player, &QMediaPlayer::playbackStateChanged, 
+    connect(player, &QMediaPlayer::playbackStateChanged, 
             this, &AudioPlayer::onStateChanged);
 }
 
-AudioPlayer::~AudioPlayer()
+void AudioPlayer::ensureEngine()
 {
+    if (m_engine) {
+        return;
+    }
+    m_engine = new PcmEngine(this);
+    m_engine->addProcessor(&m_equalizer);
+    m_engine->addProcessor(&m_outputTap);
+    m_engine->setVolume(m_volume);
+    m_engine->setCacheCapacity(qint64(m_pcmCacheMb) * 1024 * 1024);
+    m_engine->setResamplerQuality(m_resamplerQuality);
+    m_engine->setBufferSizes(m_outputBufferMs, m_outputPeriodMs);
+    m_engine->setOutputDevice(activeOutputDevice());
+    connect(m_engine, &PcmEngine::positionChanged, this, &AudioPlayer::positionChanged);
+    connect(m_engine, &PcmEngine::positionChanged, this, [this](qint64 position) {
+        if (m_engine->duration() > 0) {
+            prefetchNext(m_engine->duration() - position);
+        }
+    });
+    connect(m_engine, &PcmEngine::durationChanged, this, &AudioPlayer::durationChanged);
+    connect(m_engine, &PcmEngine::playbackStateChanged, this, &AudioPlayer::stateChanged);
+    connect(m_engine, &PcmEngine::mediaStatusChanged, this, &AudioPlayer::onEngineMediaStatusChanged);
+    connect(m_engine, &PcmEngine::errorOccurred, this, &AudioPlayer::onEngineErrorOccurred);
+    connect(m_engine, &PcmEngine::sourceAdvanced, this, &AudioPlayer::onEngineSourceAdvanced);
+    connect(m_engine, &PcmEngine::firstAudio, this, [this](qint64 timestamp) {
+        m_latencyTracker->mark(LatencyTracker::FirstAudio, timestamp);
+    });
+    connect(m_engine, &PcmEngine::underrun, this, [this](quint64 count) {
+        m_glitchMonitor->record(GlitchMonitor::Underrun, count);
+    });
+    connect(m_engine, &PcmEngine::bufferLow, this, [this](qint64 bufferedMs) {
+        m_glitchMonitor->record(GlitchMonitor::LowBuffer, bufferedMs);
+    });
+    connect(m_engine, &PcmEngine::lateCallback, this, [this](double gapMs) {
+        m_glitchMonitor->record(GlitchMonitor::LateCallback, gapMs);
+    });
+}
+
+void AudioPlayer::setBackend(Backend backend)
+{
+    if (m_backend == backend) {
+        return;
+    }
+    TrackInfo track = m_currentTrack;
+    TrackInfo next = m_nextTrack;
     stop();
+    setPlayerSource(m_player, QString());
+    m_backend = backend;
+    if (m_backend == PcmEngineBackend) {
+        ensureEngine();
+        m_engine->setVolume(m_volume);
+        m_engine->setCrossfade(m_crossfader.duration(), m_crossfader.curve());
+    } else {
+        m_engine->setSource(QString());
+        m_audioOutput->setVolume(outputVolume(m_playerGain));
+    }
+    m_nextTrack = TrackInfo();
+    m_nextTrack.id = -1;
+    if (track.id >= 0) {
+        setTrack(track);
+    }
+    if (next.id >= 0) {
+        setNextTrack(next);
+    }
 }
 
-void AudioPlayer::setTrack(const TrackInfo &track)
+void AudioPlayer::setTrack(const TrackInfo &track, bool autoAdvance)
 {
     if (track.id < 0) {
         return;
     }
+    if (!m_latencyTracker->isPending(LatencyTracker::SetTrack)) {
+        m_latencyTracker->begin(LatencyTracker::TrackStart);
+    }
+    m_latencyTracker->mark(LatencyTracker::SetTrack);
     stop();
     m_currentTrack = track;
+    m_currentTrack.playbackRate = storedPlaybackRate(track);
+    loadAudioRange(m_currentTrack);
+    m_playToEnd = false;
     m_trackLoaded = false;
     m_autoPlay = false;
+    const qint64 startMs = autoAdvance ? leadingSkip(m_currentTrack) : 0;
     
     if (!QFileInfo::exists(track.filePath)) {
+        m_latencyTracker->cancel();
         emit errorOccurred(QString("Файл не найден: %1").arg(track.filePath));
         return;
     }
-    QUrl url = QUrl::fromLocalFile(track.filePath);
-    m_player->setSource(url);
+    m_prefetcher->trackStarted(track.filePath);
+    m_playerGain = replayGainFactor(track);
+    m_audioOutput->setVolume(outputVolume(m_playerGain));
+    if (m_backend == PcmEngineBackend) {
+        m_engine->setSource(track.filePath, m_playerGain, startMs);
+        updateEngineNextSource();
+        loadMetadataSource(track);
+    } else {
+        m_metadataTrackId = -1;
+        m_pendingStartMs = startMs;
+        setPlayerSource(m_player, track.filePath);
+        m_player->setPlaybackRate(m_currentTrack.playbackRate);
+    }
     
-    emit trackChanged(track);
+    emit trackChanged(m_currentTrack);
 }
 
 void AudioPlayer::play()
 {
+    if (m_backend == PcmEngineBackend) {
+        m_engine->play();
+        return;
+    }
     if (m_trackLoaded) {
         m_player->play();
     } else {
@@ -64,55 +210,523 @@ void AudioPlayer::play()
 
 void AudioPlayer::pause()
 {
+    m_latencyTracker->cancel();
+    if (m_backend == PcmEngineBackend) {
+        m_engine->pause();
+        return;
+    }
     m_player->pause();
 }
 
 void AudioPlayer::stop()
 {
+    if (m_backend == PcmEngineBackend) {
+        m_engine->stop();
+    }
+    resetStandby();
+    m_audioOutput->setVolume(outputVolume(m_playerGain));
     m_player->stop();
 }
 
 void AudioPlayer::setPosition(qint64 position)
 {
+    // Seeking into the trailing silence means the listener wants to hear it.
+    const qint64 cut = trailingCut();
+    if (cut >= 0 && position >= cut) {
+        m_playToEnd = true;
+        applySourceEnds();
+    }
+    if (m_backend == PcmEngineBackend) {
+        m_engine->setPosition(position);
+        return;
+    }
     m_player->setPosition(position);
 }
 
 void AudioPlayer::setVolume(float volume)
 {
-    m_audioOutput->setVolume(volume);
+    m_volume = volume;
+    if (m_engine) {
+        m_engine->setVolume(volume);
+    }
+    m_audioOutput->setVolume(outputVolume(m_playerGain));
+    m_standbyOutput->setVolume(outputVolume(m_standbyGain));
 }
 
 QMediaPlayer::PlaybackState AudioPlayer::state() const
 {
+    if (m_backend == PcmEngineBackend) {
+        return m_engine->playbackState();
+    }
     return m_player->playbackState();
 }
 
 qint64 AudioPlayer::position() const
 {
+    if (m_backend == PcmEngineBackend) {
+        return m_engine->position();
+    }
     return m_player->position();
 }
 
 qint64 AudioPlayer::duration() const
 {
+    if (m_backend == PcmEngineBackend) {
+        return m_engine->duration();
+    }
     return m_player->duration();
 }
 
 float AudioPlayer::volume() const
 {
-    return m_audioOutput->volume();
+    return m_volume;
+}
+
+void AudioPlayer::setPcmCacheSize(int megabytes)
+{
+    m_pcmCacheMb = qMax(0, megabytes);
+    if (m_engine) {
+        m_engine->setCacheCapacity(qint64(m_pcmCacheMb) * 1024 * 1024);
+    }
+}
+
+void AudioPlayer::setResamplerQuality(Resampler::Quality quality)
+{
+    m_resamplerQuality = quality;
+    if (m_engine) {
+        m_engine->setResamplerQuality(quality);
+    }
+}
+
+void AudioPlayer::setOutputBufferSize(int bufferMs, int periodMs)
+{
+    m_outputBufferMs = bufferMs;
+    m_outputPeriodMs = periodMs;
+    if (m_engine) {
+        m_engine->setBufferSizes(bufferMs, periodMs);
+    }
+}
+
+void AudioPlayer::setOutputDevice(const QAudioDevice &device)
+{
+    m_selectedDevice = device;
+    applyOutputDevice();
+}
+
+QAudioDevice AudioPlayer::activeOutputDevice() const
+{
+    if (!m_selectedDevice.isNull()) {
+        for (const QAudioDevice &device : QMediaDevices::audioOutputs()) {
+            if (device.id() == m_selectedDevice.id()) {
+                return device;
+            }
+        }
+    }
+    // The chosen device is gone (or none was chosen): use the default until
+    // it comes back.
+    return QMediaDevices::defaultAudioOutput();
+}
+
+void AudioPlayer::applyOutputDevice()
+{
+    QAudioDevice device = activeOutputDevice();
+    if (m_audioOutput->device().id() != device.id()) {
+        m_audioOutput->setDevice(device);
+        m_standbyOutput->setDevice(device);
+    }
+    if (m_engine) {
+        m_engine->setOutputDevice(device);
+    }
+}
+
+void AudioPlayer::onAudioOutputsChanged()
+{
+    applyOutputDevice();
+    emit outputDevicesChanged();
+}
+
+void AudioPlayer::setGaplessEnabled(bool enabled)
+{
+    if (m_gaplessEnabled == enabled) {
+        return;
+    }
+    m_gaplessEnabled = enabled;
+    if (m_backend == PcmEngineBackend) {
+        updateEngineNextSource();
+        return;
+    }
+    if (!enabled) {
+        resetStandby();
+    } else if (m_trackLoaded && m_player->duration() - m_player->position() <= kGaplessPreloadMs) {
+        prepareStandby();
+    }
+}
+
+void AudioPlayer::setCrossfadeDuration(int milliseconds)
+{
+    m_crossfader.setDuration(milliseconds);
+    if (m_engine) {
+        m_engine->setCrossfade(m_crossfader.duration(), m_crossfader.curve());
+    }
+    if (m_backend == PcmEngineBackend) {
+        updateEngineNextSource();
+    }
+}
+
+void AudioPlayer::setCrossfadeCurve(Crossfader::Curve curve)
+{
+    m_crossfader.setCurve(curve);
+    if (m_engine) {
+        m_engine->setCrossfade(m_crossfader.duration(), m_crossfader.curve());
+    }
+}
+
+void AudioPlayer::setNextTrack(const TrackInfo &track)
+{
+    if (track.id == m_nextTrack.id && track.filePath == m_nextTrack.filePath) {
+        return;
+    }
+    TrackInfo next = track;
+    next.playbackRate = storedPlaybackRate(track);
+    loadAudioRange(next);
+    if (m_backend == PcmEngineBackend) {
+        m_nextTrack = next;
+        updateEngineNextSource();
+        return;
+    }
+    resetStandby();
+    m_nextTrack = next;
+    if (m_trackLoaded && m_player->duration() - m_player->position() <= kGaplessPreloadMs) {
+        prepareStandby();
+    }
+}
+
+void AudioPlayer::clearNextTrack()
+{
+    resetStandby();
+    m_nextTrack = TrackInfo();
+    m_nextTrack.id = -1;
+    if (m_backend == PcmEngineBackend) {
+        m_engine->clearNextSource();
+    }
+}
+
+void AudioPlayer::setMemoryMapped(bool enabled)
+{
+    MappedFile::setEnabled(enabled);
+}
+
+bool AudioPlayer::isMemoryMapped() const
+{
+    return MappedFile::isEnabled();
+}
+
+void AudioPlayer::setPlayerSource(QMediaPlayer *player, const QString &filePath)
+{
+    // The device of the previous source belongs to the player; it can go
+    // once the player has switched away from it.
+    const QList<MappedFileDevice *> previous = player->findChildren<MappedFileDevice *>(Qt::FindDirectChildrenOnly);
+    QSharedPointer<MappedFile> mapping;
+    if (!filePath.isEmpty() && MappedFile::isEnabled()) {
+        mapping = MappedFile::acquire(filePath);
+    }
+    MappedFileDevice *device = mapping ? new MappedFileDevice(mapping, 0, player) : nullptr;
+    if (device && device->open(QIODevice::ReadOnly)) {
+        player->setSourceDevice(device, QUrl::fromLocalFile(filePath));
+    } else {
+        delete device;
+        player->setSource(filePath.isEmpty() ? QUrl() : QUrl::fromLocalFile(filePath));
+    }
+    for (MappedFileDevice *old : previous) {
+        old->deleteLater();
+    }
+}
+
+void AudioPlayer::prefetchNext(qint64 remainingMs)
+{
+    if (m_nextTrack.id >= 0 && remainingMs <= kPrefetchLeadMs) {
+        m_prefetcher->prefetch(m_nextTrack.filePath);
+    }
+}
+
+void AudioPlayer::updateEngineNextSource()
+{
+    applyPlaybackRates();
+    bool wanted = m_gaplessEnabled || m_crossfader.isEnabled();
+    if (!wanted || m_nextTrack.id < 0 || !QFileInfo::exists(m_nextTrack.filePath)) {
+        m_engine->clearNextSource();
+        applySourceEnds();
+        return;
+    }
+    m_engine->setNextSource(m_nextTrack.filePath, replayGainFactor(m_nextTrack), leadingSkip(m_nextTrack));
+    applySourceEnds();
+}
+
+void AudioPlayer::setReplayGainMode(ReplayGainMode mode)
+{
+    if (m_replayGainMode == mode) {
+        return;
+    }
+    m_replayGainMode = mode;
+    applyReplayGain();
+}
+
+void AudioPlayer::refreshReplayGain()
+{
+    if (m_currentTrack.id >= 0) {
+        TrackInfo stored = m_dbManager->getTrack(m_currentTrack.id);
+        if (stored.id >= 0) {
+            m_currentTrack.trackGain = stored.trackGain;
+            m_currentTrack.trackPeak = stored.trackPeak;
+            m_currentTrack.albumGain = stored.albumGain;
+            m_currentTrack.albumPeak = stored.albumPeak;
+            m_currentTrack.hasTrackGain = stored.hasTrackGain;
+            m_currentTrack.hasAlbumGain = stored.hasAlbumGain;
+        }
+    }
+    if (m_nextTrack.id >= 0) {
+        TrackInfo stored = m_dbManager->getTrack(m_nextTrack.id);
+        if (stored.id >= 0) {
+            m_nextTrack.trackGain = stored.trackGain;
+            m_nextTrack.trackPeak = stored.trackPeak;
+            m_nextTrack.albumGain = stored.albumGain;
+            m_nextTrack.albumPeak = stored.albumPeak;
+            m_nextTrack.hasTrackGain = stored.hasTrackGain;
+            m_nextTrack.hasAlbumGain = stored.hasAlbumGain;
+        }
+    }
+    applyReplayGain();
+}
+
+void AudioPlayer::setPlaybackRate(double rate)
+{
+    rate = std::clamp(rate, double(TimeStretcher::MinRate), double(TimeStretcher::MaxRate));
+    if (m_currentTrack.id < 0 || rate == m_currentTrack.playbackRate) {
+        return;
+    }
+    m_currentTrack.playbackRate = rate;
+    if (m_nextTrack.id == m_currentTrack.id) {
+        m_nextTrack.playbackRate = rate;
+    }
+    if (m_dbManager) {
+        m_dbManager->setPlaybackRate(m_currentTrack.id, rate);
+    }
+    if (m_backend == PcmEngineBackend) {
+        applyPlaybackRates();
+    } else {
+        // Whether QMediaPlayer keeps the pitch depends on the platform backend.
+        m_player->setPlaybackRate(rate);
+    }
+}
+
+double AudioPlayer::storedPlaybackRate(const TrackInfo &track) const
+{
+    if (!m_dbManager || track.id < 0) {
+        return 1.0;
+    }
+    return m_dbManager->getPlaybackRate(track.id);
+}
+
+void AudioPlayer::applyPlaybackRates()
+{
+    if (!m_engine) {
+        return;
+    }
+    const float next = m_nextTrack.id >= 0 ? static_cast<float>(m_nextTrack.playbackRate) : 1.0f;
+    m_engine->setSourceRates(static_cast<float>(m_currentTrack.playbackRate), next);
+}
+
+void AudioPlayer::setSilenceSkipping(bool enabled)
+{
+    if (m_skipSilence == enabled) {
+        return;
+    }
+    m_skipSilence = enabled;
+    if (m_backend == PcmEngineBackend) {
+        updateEngineNextSource();
+    }
+}
+
+void AudioPlayer::refreshAudioRanges()
+{
+    loadAudioRange(m_currentTrack);
+    loadAudioRange(m_nextTrack);
+    if (m_backend == PcmEngineBackend) {
+        updateEngineNextSource();
+    }
+}
+
+void AudioPlayer::loadAudioRange(TrackInfo &track) const
+{
+    if (!m_dbManager || track.id < 0) {
+        return;
+    }
+    qint64 start = 0;
+    qint64 end = 0;
+    if (m_dbManager->getAudioRange(track.id, start, end)) {
+        track.audioStart = start;
+        track.audioEnd = end;
+    }
+}
+
+qint64 AudioPlayer::leadingSkip(const TrackInfo &track) const
+{
+    return m_skipSilence && track.hasAudioRange() ? track.audioStart : 0;
+}
+
+qint64 AudioPlayer::trailingCut() const
+{
+    // Only where playback goes on to another track; the last one plays out.
+    if (!m_skipSilence || m_playToEnd || m_nextTrack.id < 0 || !m_currentTrack.hasAudioRange()) {
+        return -1;
+    }
+    return m_currentTrack.audioEnd;
+}
+
+void AudioPlayer::applySourceEnds()
+{
+    if (m_engine) {
+        // The next deck's own cut is set once it has become current.
+        m_engine->setSourceEnds(trailingCut(), -1);
+    }
+}
+
+float AudioPlayer::replayGainFactor(const TrackInfo &track) const
+{
+    if (m_replayGainMode == ReplayGainOff || !track.hasTrackGain) {
+        return 1.0f;
+    }
+    bool useAlbum = m_replayGainMode == ReplayGainAlbum && track.hasAlbumGain;
+    double gainDb = useAlbum ? track.albumGain : track.trackGain;
+    double peak = useAlbum ? track.albumPeak : track.trackPeak;
+    double factor = std::pow(10.0, gainDb / 20.0);
+    if (peak > 0.0) {
+        factor = qMin(factor, 1.0 / peak);
+    }
+    return static_cast<float>(factor);
+}
+
+float AudioPlayer::outputVolume(float gain) const
+{
+    // QAudioOutput cannot amplify, so positive gains only take effect when
+    // the user volume leaves headroom.
+    return qMin(1.0f, m_volume * gain);
+}
+
+void AudioPlayer::applyReplayGain()
+{
+    m_playerGain = replayGainFactor(m_currentTrack);
+    float nextGain = replayGainFactor(m_nextTrack);
+    if (m_engine) {
+        m_engine->setSourceGains(m_playerGain, nextGain);
+    }
+    if (m_standbyPrepared) {
+        m_standbyGain = nextGain;
+    }
+    m_audioOutput->setVolume(outputVolume(m_playerGain));
+    m_standbyOutput->setVolume(outputVolume(m_standbyGain));
+}
+
+void AudioPlayer::prepareStandby()
+{
+    if (m_backend != MediaPlayerBackend || !m_gaplessEnabled || m_standbyPrepared || m_nextTrack.id < 0) {
+        return;
+    }
+    if (!QFileInfo::exists(m_nextTrack.filePath)) {
+        return;
+    }
+    m_standbyPrepared = true;
+    m_standbyReady = false;
+    m_standbyGain = replayGainFactor(m_nextTrack);
+    m_standbyOutput->setVolume(outputVolume(m_standbyGain));
+    m_standbyStartMs = leadingSkip(m_nextTrack);
+    setPlayerSource(m_standbyPlayer, m_nextTrack.filePath);
+    m_standbyPlayer->setPlaybackRate(m_nextTrack.playbackRate);
+}
+
+void AudioPlayer::resetStandby()
+{
+    m_standbyPrepared = false;
+    m_standbyReady = false;
+    m_standbyPlayer->stop();
+    setPlayerSource(m_standbyPlayer, QString());
+}
+
+bool AudioPlayer::isAtEndOfMedia() const
+{
+    if (m_player->mediaStatus() == QMediaPlayer::EndOfMedia) {
+        return true;
+    }
+    qint64 duration = m_player->duration();
+    return duration > 0 && m_player->position() >= duration - kEndOfMediaToleranceMs;
+}
+
+bool AudioPlayer::switchToStandby()
+{
+    if (!m_gaplessEnabled || !m_standbyReady || m_nextTrack.id < 0) {
+        return false;
+    }
+    std::swap(m_player, m_standbyPlayer);
+    std::swap(m_audioOutput, m_standbyOutput);
+    std::swap(m_playerGain, m_standbyGain);
+    m_player->play();
+    
+    m_currentTrack = m_nextTrack;
+    m_nextTrack = TrackInfo();
+    m_nextTrack.id = -1;
+    m_playToEnd = false;
+    m_trackLoaded = true;
+    m_autoPlay = false;
+    m_prefetcher->trackStarted(m_currentTrack.filePath);
+    resetStandby();
+    
+    emit trackChanged(m_currentTrack);
+    emit durationChanged(m_player->duration());
+    extractMetadata(m_player->source());
+    return true;
 }
 
 void AudioPlayer::onMediaStatusChanged(QMediaPlayer::MediaStatus status)
 {
+    if (m_backend == PcmEngineBackend) {
+        if (sender() == m_player && status == QMediaPlayer::LoadedMedia) {
+            extractMetadata(m_player->source());
+        }
+        return;
+    }
+    if (sender() == m_standbyPlayer) {
+        if (status == QMediaPlayer::LoadedMedia || status == QMediaPlayer::BufferedMedia) {
+            if (m_standbyPrepared && !m_standbyReady && m_standbyStartMs > 0) {
+                m_standbyPlayer->setPosition(m_standbyStartMs);
+            }
+            m_standbyReady = m_standbyPrepared;
+        } else if (status == QMediaPlayer::InvalidMedia) {
+            m_standbyReady = false;
+        }
+        return;
+    }
     if (status == QMediaPlayer::LoadedMedia || status == QMediaPlayer::BufferedMedia) {
         m_trackLoaded = true;
+        m_latencyTracker->mark(LatencyTracker::MediaLoaded);
         extractMetadata(m_player->source());
         emit durationChanged(m_player->duration());
+        if (m_pendingStartMs > 0) {
+            m_player->setPosition(m_pendingStartMs);
+            m_pendingStartMs = 0;
+        }
+        if (m_player->duration() <= kGaplessPreloadMs) {
+            prepareStandby();
+        }
         if (m_autoPlay) {
             m_autoPlay = false;
             m_player->play();
         }
+    } else if (status == QMediaPlayer::EndOfMedia) {
+        if (!switchToStandby()) {
+            emit trackFinished();
+        }
     } else if (status == QMediaPlayer::InvalidMedia) {
+        m_latencyTracker->cancel();
         emit errorOccurred("Неверный медиа файл или формат не поддерживается");
         m_trackLoaded = false;
         m_autoPlay = false;
@@ -123,6 +737,13 @@ void AudioPlayer::onMediaStatusChanged(QMediaPlayer::MediaStatus status)
 
 void AudioPlayer::onErrorOccurred(QMediaPlayer::Error error, const QString &errorString)
 {
+    if (m_backend == PcmEngineBackend) {
+        return;
+    }
+    if (sender() == m_standbyPlayer) {
+        m_standbyReady = false;
+        return;
+    }
     QString fullError = QString("Ошибка воспроизведения: %1 (код: %2)").arg(errorString).arg(error);
     emit errorOccurred(fullError);
     qWarning() << "Ошибка аудио плеера:" << fullError;
@@ -132,25 +753,134 @@ void AudioPlayer::onErrorOccurred(QMediaPlayer::Error error, const QString &erro
 
 void AudioPlayer::onPositionChanged(qint64 position)
 {
+    if (m_backend == PcmEngineBackend || sender() != m_player) {
+        return;
+    }
+    m_glitchMonitor->positionUpdated();
+    if (position > 0 && m_player->playbackState() == QMediaPlayer::PlayingState) {
+        // QMediaPlayer does not report output; the first position past zero
+        // is the closest observable point.
+        m_latencyTracker->mark(LatencyTracker::FirstAudio);
+    }
+    qint64 duration = m_player->duration();
+    // Transitions happen at the trailing silence where one was found.
+    const qint64 cut = trailingCut();
+    const qint64 end = cut >= 0 && cut < duration ? cut : duration;
+    if (end > 0) {
+        prefetchNext(end - position);
+    }
+    if (end > 0 && end - position <= kGaplessPreloadMs) {
+        prepareStandby();
+    }
+    const bool playing = m_player->playbackState() == QMediaPlayer::PlayingState;
+    if (end < duration && position >= end && playing) {
+        // Without a prepared standby the window advances the queue.
+        if (!switchToStandby()) {
+            m_player->stop();
+            emit trackFinished();
+        }
+        return;
+    }
     emit positionChanged(position);
 }
 
 void AudioPlayer::onDurationChanged(qint64 duration)
 {
+    if (m_backend == PcmEngineBackend || sender() != m_player) {
+        return;
+    }
     emit durationChanged(duration);
 }
 
 void AudioPlayer::onStateChanged(QMediaPlayer::PlaybackState state)
 {
+    if (m_backend == PcmEngineBackend || sender() != m_player) {
+        return;
+    }
+    if (state == QMediaPlayer::StoppedState && isAtEndOfMedia() && switchToStandby()) {
+        return;
+    }
     emit stateChanged(state);
 }
 
+void AudioPlayer::onEngineMediaStatusChanged(QMediaPlayer::MediaStatus status)
+{
+    if (status == QMediaPlayer::LoadedMedia || status == QMediaPlayer::BufferedMedia) {
+        m_trackLoaded = true;
+        m_latencyTracker->mark(LatencyTracker::MediaLoaded);
+    } else if (status == QMediaPlayer::InvalidMedia || status == QMediaPlayer::NoMedia) {
+        m_trackLoaded = false;
+        if (status == QMediaPlayer::InvalidMedia) {
+            m_latencyTracker->cancel();
+        }
+    } else if (status == QMediaPlayer::EndOfMedia) {
+        // Gapless next sources are taken over inside the engine; this is the
+        // end with nothing after it.
+        emit trackFinished();
+    }
+}
+
+void AudioPlayer::onEngineErrorOccurred(const QString &error)
+{
+    QString fullError = QString("Ошибка воспроизведения: %1").arg(error);
+    emit errorOccurred(fullError);
+    qWarning() << "Ошибка аудио движка:" << fullError;
+    m_trackLoaded = false;
+}
+
+void AudioPlayer::onEngineSourceAdvanced()
+{
+    if (m_nextTrack.id < 0) {
+        return;
+    }
+    m_currentTrack = m_nextTrack;
+    m_nextTrack = TrackInfo();
+    m_nextTrack.id = -1;
+    m_playToEnd = false;
+    m_trackLoaded = true;
+    m_prefetcher->trackStarted(m_currentTrack.filePath);
+    m_playerGain = replayGainFactor(m_currentTrack);
+    applySourceEnds();
+    loadMetadataSource(m_currentTrack);
+    emit trackChanged(m_currentTrack);
+    emit durationChanged(m_engine->duration());
+}
+
+bool AudioPlayer::isMetadataCurrent(const TrackInfo &track) const
+{
+    if (!m_dbManager || track.id < 0) {
+        return false;
+    }
+    QString fingerprint = DatabaseManager::fileFingerprint(track.filePath);
+    return !fingerprint.isEmpty() && fingerprint == m_dbManager->getFileFingerprint(track.id);
+}
+
+void AudioPlayer::loadMetadataSource(const TrackInfo &track)
+{
+    // The PCM engine plays the file itself; m_player is only needed to read
+    // tags, which is skipped while the stored ones match the file.
+    if (isMetadataCurrent(track)) {
+        m_metadataTrackId = track.id;
+        setPlayerSource(m_player, QString());
+    } else {
+        m_metadataTrackId = -1;
+        setPlayerSource(m_player, track.filePath);
+    }
+}
+
 void AudioPlayer::extractMetadata(const QUrl &url)
 {
-    if (!m_dbManager || m_currentTrack.id < 0) {
+    if (!m_dbManager || m_currentTrack.id < 0 || m_metadataTrackId == m_currentTrack.id) {
+        return;
+    }
+    m_metadataTrackId = m_currentTrack.id;
+    QString fingerprint = DatabaseManager::fileFingerprint(url.toLocalFile());
+    if (!fingerprint.isEmpty() && fingerprint == m_dbManager->getFileFingerprint(m_currentTrack.id)) {
         return;
     }
     
+    TrackInfo dbTrack = m_dbManager->getTrack(m_currentTrack.id);
+
     QString title = m_player->metaData().value(QMediaMetaData::Title).toString();
     QString artist = m_player->metaData().value(QMediaMetaData::AlbumArtist).toString();
     if (artist.isEmpty()) {
@@ -159,13 +889,20 @@ void AudioPlayer::extractMetadata(const QUrl &url)
     QString album = m_player->metaData().value(QMediaMetaData::AlbumTitle).toString();
     
     if (title.isEmpty()) {
-        QFileInfo fileInfo(url.toLocalFile());
-        title = fileInfo.baseName();
+        title = dbTrack.title.isEmpty() ? QFileInfo(url.toLocalFile()).baseName() : dbTrack.title;
+    }
+    if (artist.isEmpty()) {
+        artist = dbTrack.artist;
+    }
+    if (album.isEmpty()) {
+        album = dbTrack.album;
     }
     
     int duration = m_player->duration() / 1000;
+    if (duration <= 0) {
+        duration = dbTrack.duration;
+    }
     
-    TrackInfo dbTrack = m_dbManager->getTrack(m_currentTrack.id);
     QString existingCoverPath = dbTrack.coverPath;
     
     bool hasUserCover = !existingCoverPath.isEmpty() && QFileInfo::exists(existingCoverPath);
@@ -187,8 +924,15 @@ void AudioPlayer::extractMetadata(const QUrl &url)
         }
     }
     
-    m_dbManager->updateTrackInfo(m_currentTrack.id, title, artist, album, duration, coverPath);
-    m_currentTrack = m_dbManager->getTrack(m_currentTrack.id);
+    if (!m_dbManager->updateTrackMetadata(m_currentTrack.id, title, artist, album,
+                                          duration, coverPath, fingerprint)) {
+        return;
+    }
+    m_currentTrack.title = title;
+    m_currentTrack.artist = artist;
+    m_currentTrack.album = album;
+    m_currentTrack.duration = duration;
+    m_currentTrack.coverPath = coverPath;
     emit trackChanged(m_currentTrack);
 }
 
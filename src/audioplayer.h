@@ -10,15 +10,34 @@
 #include <QUrl>
 #include <QString>
 #include "databasemanager.h"
+#include "crossfader.h"
+#include "equalizer.h"
+#include "glitchmonitor.h"
+#include "latencytracker.h"
+#include "outputtap.h"
+#include "pcmengine.h"
+#include "prefetcher.h"
 
 class AudioPlayer : public QObject
 {
     Q_OBJECT
 
 public:
+    enum Backend {
+        MediaPlayerBackend,
+        PcmEngineBackend
+    };
+
+    enum ReplayGainMode {
+        ReplayGainOff,
+        ReplayGainTrack,
+        ReplayGainAlbum
+    };
+
     explicit AudioPlayer(DatabaseManager *dbManager, QObject *parent = nullptr);
     ~AudioPlayer();
-    void setTrack(const TrackInfo &track);
+    // An automatic advance starts after the track's leading silence.
+    void setTrack(const TrackInfo &track, bool autoAdvance = false);
     void play();
     void pause();
     void stop();
@@ -28,15 +47,63 @@ public:
     qint64 position() const;
     qint64 duration() const;
     float volume() const;
+    void setBackend(Backend backend);
+    Backend backend() const { return m_backend; }
+    PcmEngine *engine() const { return m_engine; }
+    Equalizer *equalizer() { return &m_equalizer; }
+    OutputTap *outputTap() { return &m_outputTap; }
+    LatencyTracker *latencyTracker() const { return m_latencyTracker; }
+    Prefetcher *prefetcher() const { return m_prefetcher; }
+    GlitchMonitor *glitchMonitor() const { return m_glitchMonitor; }
+    void setMemoryMapped(bool enabled);
+    bool isMemoryMapped() const;
+    void setGaplessEnabled(bool enabled);
+    bool isGaplessEnabled() const { return m_gaplessEnabled; }
+    // Crossfades are mixed sample-accurately by the PCM engine; the
+    // QMediaPlayer backend keeps the setting but does not crossfade.
+    void setCrossfadeDuration(int milliseconds);
+    int crossfadeDuration() const { return m_crossfader.duration(); }
+    void setCrossfadeCurve(Crossfader::Curve curve);
+    Crossfader::Curve crossfadeCurve() const { return m_crossfader.curve(); }
+    void setPcmCacheSize(int megabytes);
+    int pcmCacheSize() const { return m_pcmCacheMb; }
+    void setResamplerQuality(Resampler::Quality quality);
+    Resampler::Quality resamplerQuality() const { return m_resamplerQuality; }
+    // Decoded-ahead buffer and sink period of the PCM engine.
+    void setOutputBufferSize(int bufferMs, int periodMs);
+    int outputBufferMs() const { return m_outputBufferMs; }
+    void setReplayGainMode(ReplayGainMode mode);
+    ReplayGainMode replayGainMode() const { return m_replayGainMode; }
+    void refreshReplayGain();
+    // Leading and trailing silence found by the analysis is skipped where
+    // one track runs into the next.
+    void setSilenceSkipping(bool enabled);
+    bool isSilenceSkipping() const { return m_skipSilence; }
+    void refreshAudioRanges();
+    // Speed of the current track, remembered per track.
+    void setPlaybackRate(double rate);
+    double playbackRate() const { return m_currentTrack.playbackRate; }
+    void setNextTrack(const TrackInfo &track);
+    void clearNextTrack();
     TrackInfo currentTrack() const { return m_currentTrack; }
+    TrackInfo nextTrack() const { return m_nextTrack; }
     QAudioOutput* audioOutput() const { return m_audioOutput; }
+    // A null device follows the system default.
+    void setOutputDevice(const QAudioDevice &device);
+    QAudioDevice outputDevice() const { return m_selectedDevice; }
+    QAudioDevice activeOutputDevice() const;
 
 signals:
     void positionChanged(qint64 position);
     void durationChanged(qint64 duration);
     void stateChanged(QMediaPlayer::PlaybackState state);
     void trackChanged(const TrackInfo &track);
+    // The current track played to its end, or to its trailing silence, and
+    // no gapless or crossfade switch took over. stop(), setTrack() and
+    // backend changes never emit it.
+    void trackFinished();
     void errorOccurred(const QString &error);
+    void outputDevicesChanged();
 
 private slots:
     void onMediaStatusChanged(QMediaPlayer::MediaStatus status);
@@ -44,15 +111,69 @@ private slots:
     void onPositionChanged(qint64 position);
     void onDurationChanged(qint64 duration);
     void onStateChanged(QMediaPlayer::PlaybackState state);
+    void onEngineMediaStatusChanged(QMediaPlayer::MediaStatus status);
+    void onEngineErrorOccurred(const QString &error);
+    void onEngineSourceAdvanced();
+    void onAudioOutputsChanged();
 
 private:
     QMediaPlayer *m_player;
     QAudioOutput *m_audioOutput;
+    QMediaPlayer *m_standbyPlayer;
+    QAudioOutput *m_standbyOutput;
+    PcmEngine *m_engine;
+    QMediaDevices *m_mediaDevices;
+    QAudioDevice m_selectedDevice;
+    Equalizer m_equalizer;
+    OutputTap m_outputTap;
+    LatencyTracker *m_latencyTracker;
+    Prefetcher *m_prefetcher;
+    GlitchMonitor *m_glitchMonitor;
+    Backend m_backend;
     DatabaseManager *m_dbManager;
     TrackInfo m_currentTrack;
+    TrackInfo m_nextTrack;
     bool m_trackLoaded;
     bool m_autoPlay;
+    int m_metadataTrackId;
+    bool m_gaplessEnabled;
+    bool m_skipSilence;
+    qint64 m_pendingStartMs;
+    qint64 m_standbyStartMs;
+    bool m_playToEnd;
+    int m_pcmCacheMb;
+    Resampler::Quality m_resamplerQuality;
+    int m_outputBufferMs;
+    int m_outputPeriodMs;
+    bool m_standbyPrepared;
+    bool m_standbyReady;
+    Crossfader m_crossfader;
+    float m_volume;
+    ReplayGainMode m_replayGainMode;
+    float m_playerGain;
+    float m_standbyGain;
+    void connectPlayer(QMediaPlayer *player);
+    void ensureEngine();
+    void applyOutputDevice();
+    void updateEngineNextSource();
+    void prefetchNext(qint64 remainingMs);
+    void setPlayerSource(QMediaPlayer *player, const QString &filePath);
     void extractMetadata(const QUrl &url);
+    bool isMetadataCurrent(const TrackInfo &track) const;
+    void loadMetadataSource(const TrackInfo &track);
+    float replayGainFactor(const TrackInfo &track) const;
+    float outputVolume(float gain) const;
+    void applyReplayGain();
+    double storedPlaybackRate(const TrackInfo &track) const;
+    void applyPlaybackRates();
+    void loadAudioRange(TrackInfo &track) const;
+    qint64 leadingSkip(const TrackInfo &track) const;
+    qint64 trailingCut() const;
+    void applySourceEnds();
+    void prepareStandby();
+    void resetStandby();
+    bool isAtEndOfMedia() const;
+    bool switchToStandby();
 };
 
 #endif
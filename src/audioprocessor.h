@@ -0,0 +1,15 @@
+#ifndef AUDIOPROCESSOR_H
+#define AUDIOPROCESSOR_H
+
+// A stage of the PCM engine's output chain. prepare() is called from the GUI
+// thread while the output is stopped; process() runs on the audio thread and
+// must not allocate, lock or block. Parameters should reach it via atomics.
+class AudioProcessor
+{
+public:
+    virtual ~AudioProcessor() = default;
+    virtual void prepare(int sampleRate, int channels) = 0;
+    virtual void process(float *interleaved, int frames, int channels) = 0;
+};
+
+#endif
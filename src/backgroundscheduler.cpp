@@ -0,0 +1,142 @@
+#include "backgroundscheduler.h"
+#include <QProcess>
+#include <QThread>
+
+#if defined(Q_OS_LINUX)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+static BackgroundScheduler *s_instance = nullptr;
+
+#if defined(Q_OS_LINUX)
+// From linux/ioprio.h, which is not always installed.
+static const int kIoprioClassBestEffort = 2;
+static const int kIoprioClassIdle = 3;
+static const int kIoprioClassShift = 13;
+static const int kIoprioWhoProcess = 1;
+#endif
+
+BackgroundScheduler::BackgroundScheduler(QObject *parent)
+    : QObject(parent)
+    , m_playbackActive(false)
+{
+    const int threads = qMax(1, QThread::idealThreadCount());
+    for (QThreadPool &pool : m_pools) {
+        pool.setMaxThreadCount(threads);
+    }
+    m_pools[Bulk].setThreadPriority(QThread::LowPriority);
+    s_instance = this;
+}
+
+BackgroundScheduler::~BackgroundScheduler()
+{
+    waitForDone();
+    if (s_instance == this) {
+        s_instance = nullptr;
+    }
+}
+
+BackgroundScheduler *BackgroundScheduler::instance()
+{
+    return s_instance;
+}
+
+void BackgroundScheduler::start(JobClass jobClass, const std::function<void()> &job)
+{
+    m_pools[jobClass].start([this, jobClass, job]() {
+        applyPriority(jobClass, m_playbackActive.load(std::memory_order_relaxed));
+        job();
+    });
+}
+
+int BackgroundScheduler::concurrency(JobClass jobClass) const
+{
+    return m_pools[jobClass].maxThreadCount();
+}
+
+void BackgroundScheduler::setPlaybackActive(bool active)
+{
+    if (m_playbackActive.exchange(active) == active) {
+        return;
+    }
+    const int threads = qMax(1, QThread::idealThreadCount());
+    m_pools[Normal].setMaxThreadCount(active ? qMin(threads, PlayingNormalJobs) : threads);
+    m_pools[Bulk].setMaxThreadCount(active ? PlayingBulkJobs : threads);
+    emit concurrencyChanged();
+}
+
+void BackgroundScheduler::prepareProcess(QProcess *process, JobClass jobClass) const
+{
+#if defined(Q_OS_UNIX)
+    const int nice = niceLevel(jobClass);
+    const int ioPrio = ioPriority(jobClass, isPlaybackActive());
+    process->setChildProcessModifier([nice, ioPrio]() {
+        // Runs in the child between fork and exec.
+        setpriority(PRIO_PROCESS, 0, nice);
+#if defined(Q_OS_LINUX)
+        if (ioPrio >= 0) {
+            syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, ioPrio);
+        }
+#else
+        Q_UNUSED(ioPrio)
+#endif
+    });
+#else
+    Q_UNUSED(process)
+    Q_UNUSED(jobClass)
+#endif
+}
+
+void BackgroundScheduler::waitForDone()
+{
+    for (QThreadPool &pool : m_pools) {
+        pool.waitForDone();
+    }
+}
+
+int BackgroundScheduler::niceLevel(JobClass jobClass)
+{
+    // Fixed per class: an unprivileged thread cannot lower its nice level
+    // again, so pool threads never change class.
+    static const int kNice[JobClassCount] = {0, 5, 10};
+    return kNice[jobClass];
+}
+
+int BackgroundScheduler::ioPriority(JobClass jobClass, bool playing)
+{
+#if defined(Q_OS_LINUX)
+    if (jobClass == Interactive) {
+        return -1;
+    }
+    if (jobClass == Bulk && playing) {
+        return kIoprioClassIdle << kIoprioClassShift;
+    }
+    // Best effort levels run 0 (highest) to 7; 4 is the default.
+    return (kIoprioClassBestEffort << kIoprioClassShift) | (playing ? 7 : 4);
+#else
+    Q_UNUSED(jobClass)
+    Q_UNUSED(playing)
+    return -1;
+#endif
+}
+
+void BackgroundScheduler::applyPriority(JobClass jobClass, bool playing)
+{
+#if defined(Q_OS_LINUX)
+    // On Linux both settings apply to the calling thread only.
+    const pid_t thread = static_cast<pid_t>(syscall(SYS_gettid));
+    setpriority(PRIO_PROCESS, thread, niceLevel(jobClass));
+    const int ioPrio = ioPriority(jobClass, playing);
+    if (ioPrio >= 0) {
+        syscall(SYS_ioprio_set, kIoprioWhoProcess, thread, ioPrio);
+    }
+#else
+    Q_UNUSED(jobClass)
+    Q_UNUSED(playing)
+#endif
+}
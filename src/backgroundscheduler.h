@@ -0,0 +1,58 @@
+#ifndef BACKGROUNDSCHEDULER_H
+#define BACKGROUNDSCHEDULER_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <atomic>
+#include <functional>
+
+class QProcess;
+
+// Runs background work in priority classes so it stays out of the way of
+// playback. Each class has its own pool whose threads run at a fixed CPU
+// nice level; while audio plays, Normal and Bulk work is cut down to one
+// or two jobs at a time and Bulk I/O drops to the idle class. When playback
+// stops they open up to full parallelism again. One instance lives for the
+// whole application and is reachable through instance().
+class BackgroundScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum JobClass {
+        Interactive,    // the user is waiting for it, e.g. the shown waveform
+        Normal,         // helps playback later, e.g. seek indexes
+        Bulk,           // library-wide scans, conversions
+        JobClassCount
+    };
+
+    static const int PlayingNormalJobs = 2;
+    static const int PlayingBulkJobs = 1;
+
+    explicit BackgroundScheduler(QObject *parent = nullptr);
+    ~BackgroundScheduler();
+
+    static BackgroundScheduler *instance();
+
+    void start(JobClass jobClass, const std::function<void()> &job);
+    int concurrency(JobClass jobClass) const;
+    int activeJobs(JobClass jobClass) const { return m_pools[jobClass].activeThreadCount(); }
+    void setPlaybackActive(bool active);
+    bool isPlaybackActive() const { return m_playbackActive.load(std::memory_order_relaxed); }
+    // Makes a child process start at the CPU and I/O priority of the class.
+    void prepareProcess(QProcess *process, JobClass jobClass) const;
+    void waitForDone();
+
+signals:
+    void concurrencyChanged();
+
+private:
+    static int niceLevel(JobClass jobClass);
+    static int ioPriority(JobClass jobClass, bool playing);
+    static void applyPriority(JobClass jobClass, bool playing);
+
+    QThreadPool m_pools[JobClassCount];
+    std::atomic<bool> m_playbackActive;
+};
+
+#endif
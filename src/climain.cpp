@@ -0,0 +1,20 @@
+#include <QCoreApplication>
+#include "backgroundscheduler.h"
+#include "databasemanager.h"
+#include "librarycli.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    // Same names as the player, so both use the same database and caches.
+    app.setApplicationName("Аудио Плеер");
+    app.setOrganizationName("АудиоПлеер");
+
+    BackgroundScheduler scheduler;
+    DatabaseManager dbManager;
+    if (!dbManager.initializeDatabase()) {
+        return 1;
+    }
+    LibraryCli cli(&dbManager);
+    return cli.run(app.arguments());
+}
@@ -0,0 +1,120 @@
+#include "coverthumbnailcache.h"
+#include <QColor>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QMetaObject>
+
+CoverThumbnailCache::CoverThumbnailCache(const QSize &thumbnailSize, int capacity, QObject *parent)
+    : QObject(parent)
+    , m_thumbnailSize(thumbnailSize)
+    , m_cache(capacity)
+    , m_placeholder(thumbnailSize)
+{
+    m_pool.setMaxThreadCount(2);
+    m_placeholder.fill(QColor("#2b2b2b"));
+}
+
+CoverThumbnailCache::~CoverThumbnailCache()
+{
+    m_pending.clear();
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+QPixmap CoverThumbnailCache::thumbnail(const QString &key) const
+{
+    QPixmap *pixmap = m_cache.object(key);
+    if (pixmap) {
+        return *pixmap;
+    }
+    return m_placeholder;
+}
+
+bool CoverThumbnailCache::contains(const QString &key) const
+{
+    return m_cache.contains(key) || m_missing.contains(key);
+}
+
+void CoverThumbnailCache::request(const QList<ThumbnailRequest> &visible)
+{
+    m_pending.clear();
+    for (const ThumbnailRequest &request : visible) {
+        if (contains(request.key) || m_inFlight.contains(request.key)) {
+            continue;
+        }
+        m_pending << request;
+    }
+    startPending();
+}
+
+void CoverThumbnailCache::clear()
+{
+    m_pending.clear();
+    m_cache.clear();
+    m_missing.clear();
+}
+
+void CoverThumbnailCache::startPending()
+{
+    while (!m_pending.isEmpty() && m_inFlight.size() < m_pool.maxThreadCount()) {
+        ThumbnailRequest request = m_pending.takeFirst();
+        m_inFlight.insert(request.key, true);
+        QSize size = m_thumbnailSize;
+        m_pool.start([this, request, size]() {
+            QImage image = decodeThumbnail(request, size);
+            QMetaObject::invokeMethod(this, [this, key = request.key, image]() {
+                onThumbnailDecoded(key, image);
+            }, Qt::QueuedConnection);
+        });
+    }
+}
+
+void CoverThumbnailCache::onThumbnailDecoded(const QString &key, const QImage &image)
+{
+    m_inFlight.remove(key);
+    if (image.isNull()) {
+        m_missing.insert(key, true);
+    } else {
+        m_cache.insert(key, new QPixmap(QPixmap::fromImage(image)));
+        emit thumbnailReady(key);
+    }
+    startPending();
+}
+
+QImage CoverThumbnailCache::decodeThumbnail(const ThumbnailRequest &request, const QSize &size)
+{
+    QStringList candidates;
+    if (!request.coverPath.isEmpty()) {
+        candidates << request.coverPath;
+    }
+    if (!request.trackFilePath.isEmpty()) {
+        QDir dir = QFileInfo(request.trackFilePath).dir();
+        QStringList coverNames = {"cover.jpg", "cover.png", "folder.jpg", "folder.png",
+                                  "album.jpg", "album.png", "artwork.jpg", "artwork.png"};
+        for (const QString &coverName : coverNames) {
+            candidates << dir.absoluteFilePath(coverName);
+        }
+    }
+
+    for (const QString &path : candidates) {
+        if (!QFileInfo::exists(path)) {
+            continue;
+        }
+        QImageReader reader(path);
+        reader.setAutoTransform(true);
+        QSize sourceSize = reader.size();
+        if (sourceSize.isValid()) {
+            reader.setScaledSize(sourceSize.scaled(size, Qt::KeepAspectRatio));
+        }
+        QImage image = reader.read();
+        if (image.isNull()) {
+            continue;
+        }
+        if (image.width() > size.width() || image.height() > size.height()) {
+            image = image.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+        return image;
+    }
+    return QImage();
+}
@@ -0,0 +1,54 @@
+#ifndef COVERTHUMBNAILCACHE_H
+#define COVERTHUMBNAILCACHE_H
+
+#include <QObject>
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QPixmap>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+struct ThumbnailRequest {
+    QString key;
+    QString coverPath;
+    QString trackFilePath;
+};
+
+class CoverThumbnailCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CoverThumbnailCache(const QSize &thumbnailSize, int capacity, QObject *parent = nullptr);
+    ~CoverThumbnailCache();
+
+    QPixmap thumbnail(const QString &key) const;
+    bool contains(const QString &key) const;
+    void request(const QList<ThumbnailRequest> &visible);
+    void clear();
+    QSize thumbnailSize() const { return m_thumbnailSize; }
+    int capacity() const { return m_cache.maxCost(); }
+
+signals:
+    void thumbnailReady(const QString &key);
+
+private slots:
+    void onThumbnailDecoded(const QString &key, const QImage &image);
+
+private:
+    void startPending();
+    static QImage decodeThumbnail(const ThumbnailRequest &request, const QSize &size);
+
+    QSize m_thumbnailSize;
+    QCache<QString, QPixmap> m_cache;
+    QHash<QString, bool> m_missing;
+    QList<ThumbnailRequest> m_pending;
+    QHash<QString, bool> m_inFlight;
+    QThreadPool m_pool;
+    QPixmap m_placeholder;
+};
+
+#endif
@@ -0,0 +1,27 @@
+#include "crossfader.h"
+#include <algorithm>
+#include <cmath>
+
+Crossfader::Crossfader()
+    : m_durationMs(0)
+    , m_curve(EqualPower)
+{
+}
+
+void Crossfader::setDuration(int milliseconds)
+{
+    m_durationMs = std::clamp(milliseconds, 0, static_cast<int>(MaxDurationMs));
+}
+
+void Crossfader::gains(Curve curve, float progress, float &outgoing, float &incoming)
+{
+    progress = std::clamp(progress, 0.0f, 1.0f);
+    if (curve == Linear) {
+        outgoing = 1.0f - progress;
+        incoming = progress;
+        return;
+    }
+    const float halfPi = 1.57079632679f;
+    outgoing = std::cos(progress * halfPi);
+    incoming = std::sin(progress * halfPi);
+}
@@ -0,0 +1,29 @@
+#ifndef CROSSFADER_H
+#define CROSSFADER_H
+
+class Crossfader
+{
+public:
+    enum Curve {
+        EqualPower,
+        Linear
+    };
+
+    static const int MaxDurationMs = 12000;
+
+    Crossfader();
+
+    void setDuration(int milliseconds);
+    int duration() const { return m_durationMs; }
+    void setCurve(Curve curve) { m_curve = curve; }
+    Curve curve() const { return m_curve; }
+    bool isEnabled() const { return m_durationMs > 0; }
+
+    static void gains(Curve curve, float progress, float &outgoing, float &incoming);
+
+private:
+    int m_durationMs;
+    Curve m_curve;
+};
+
+#endif
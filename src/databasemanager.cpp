@@ -3,17 +3,20 @@
 #include <QStandardPaths>
 #include <QDir>
 #include <QFileInfo>
+#include <QDateTime>
 
 DatabaseManager::DatabaseManager(QObject *parent)
     : QObject(parent)
 {
     QString dbPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
     QDir().mkpath(dbPath);
-    m_database = QSqlDatabase::addDatabase("QSQLITE");
-    m_database.setDatabaseName(dbPath + "/audioplayer.db");
-    if (!m_database.open()) {
-        qWarning() << "Не удалось открыть базу данных:" << m_database.lastError();
-    }
+    openDatabase(dbPath + "/audioplayer.db");
+}
+
+DatabaseManager::DatabaseManager(const QString &databasePath, QObject *parent)
+    : QObject(parent)
+{
+    openDatabase(databasePath);
 }
 
 DatabaseManager::~DatabaseManager()
@@ -21,6 +24,25 @@ DatabaseManager::~DatabaseManager()
     if (m_database.isOpen()) {
         m_database.close();
     }
+    m_database = QSqlDatabase();
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+void DatabaseManager::openDatabase(const QString &databasePath)
+{
+    // Own connection per instance, so benchmarks can open several databases
+    // one after another or side by side.
+    m_connectionName = QString("audioplayer-%1").arg(reinterpret_cast<quintptr>(this), 0, 16);
+    m_database = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    m_database.setDatabaseName(databasePath);
+    if (!m_database.open()) {
+        qWarning() << "Не удалось открыть базу данных:" << m_database.lastError();
+    }
+}
+
+QSqlDatabase DatabaseManager::database() const
+{
+    return m_database;
 }
 
 bool DatabaseManager::initializeDatabase()
@@ -46,6 +68,17 @@ bool DatabaseManager::createTables()
         qWarning() << "Ошибка создания таблицы треков:" << query.lastError();
         return false;
     }
+    if (!ensureColumn("tracks", "loudness", "REAL")
+        || !ensureColumn("tracks", "track_gain", "REAL")
+        || !ensureColumn("tracks", "track_peak", "REAL")
+        || !ensureColumn("tracks", "album_gain", "REAL")
+        || !ensureColumn("tracks", "album_peak", "REAL")
+        || !ensureColumn("tracks", "file_fingerprint", "TEXT")
+        || !ensureColumn("tracks", "playback_rate", "REAL")
+        || !ensureColumn("tracks", "audio_start", "INTEGER")
+        || !ensureColumn("tracks", "audio_end", "INTEGER")) {
+        return false;
+    }
 
     query.exec("CREATE TABLE IF NOT EXISTS playlists ("
                "id INTEGER PRIMARY KEY AUTOINCREMENT,"
@@ -149,6 +182,23 @@ bool DatabaseManager::createTables()
     return true;
 }
 
+bool DatabaseManager::ensureColumn(const QString &table, const QString &column, const QString &definition)
+{
+    QSqlQuery query(m_database);
+    query.exec(QString("PRAGMA table_info(%1)").arg(table));
+    while (query.next()) {
+        if (query.value(1).toString() == column) {
+            return true;
+        }
+    }
+    query.exec(QString("ALTER TABLE %1 ADD COLUMN %2 %3").arg(table, column, definition));
+    if (query.lastError().isValid()) {
+        qWarning() << "Ошибка добавления столбца" << column << ":" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
 int DatabaseManager::addTrack(const QString &filePath, const QString &title, 
                               const QString &artist, const QString &album)
 {
@@ -174,6 +224,21 @@ int DatabaseManager::addTrack(const QString &filePath, const QString &title,
     return query.lastInsertId().toInt();
 }
 
+QList<int> DatabaseManager::addTracks(const QStringList &filePaths)
+{
+    QList<int> ids;
+    m_database.transaction();
+    for (const QString &filePath : filePaths) {
+        ids << addTrack(filePath);
+    }
+    if (!m_database.commit()) {
+        qWarning() << "Ошибка добавления треков:" << m_database.lastError();
+        m_database.rollback();
+        return QList<int>(filePaths.size(), -1);
+    }
+    return ids;
+}
+
 bool DatabaseManager::updateTrackInfo(int trackId, const QString &title, 
                                       const QString &artist, const QString &album, 
                                       int duration, const QString &coverPath)
@@ -195,13 +260,126 @@ bool DatabaseManager::updateTrackInfo(int trackId, const QString &title,
     return true;
 }
 
+bool DatabaseManager::updateTrackMetadata(int trackId, const QString &title,
+                                          const QString &artist, const QString &album,
+                                          int duration, const QString &coverPath,
+                                          const QString &fingerprint)
+{
+    QSqlQuery query(m_database);
+    query.prepare("UPDATE tracks SET title = :title, artist = :artist, "
+                  "album = :album, duration = :duration, cover_path = :cover_path, "
+                  "file_fingerprint = :fingerprint WHERE id = :id");
+    query.bindValue(":title", title);
+    query.bindValue(":artist", artist);
+    query.bindValue(":album", album);
+    query.bindValue(":duration", duration);
+    query.bindValue(":cover_path", coverPath);
+    query.bindValue(":fingerprint", fingerprint);
+    query.bindValue(":id", trackId);
+    if (!query.exec()) {
+        qWarning() << "Ошибка обновления метаданных трека:" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+QString DatabaseManager::getFileFingerprint(int trackId)
+{
+    QSqlQuery query(m_database);
+    query.prepare("SELECT file_fingerprint FROM tracks WHERE id = :id");
+    query.bindValue(":id", trackId);
+    if (query.exec() && query.next()) {
+        return query.value(0).toString();
+    }
+    return QString();
+}
+
+QList<TrackFileInfo> DatabaseManager::getTrackFiles()
+{
+    QList<TrackFileInfo> files;
+    QSqlQuery query(m_database);
+    query.exec("SELECT id, file_path, file_fingerprint FROM tracks ORDER BY file_path");
+    if (query.lastError().isValid()) {
+        qWarning() << "Ошибка получения файлов треков:" << query.lastError();
+        return files;
+    }
+    while (query.next()) {
+        files << TrackFileInfo{query.value(0).toInt(), query.value(1).toString(), query.value(2).toString()};
+    }
+    return files;
+}
+
+bool DatabaseManager::resetTrackAnalysis(int trackId)
+{
+    QSqlQuery query(m_database);
+    query.prepare("UPDATE tracks SET file_fingerprint = NULL, loudness = NULL, track_gain = NULL, "
+                  "track_peak = NULL, album_gain = NULL, album_peak = NULL, "
+                  "audio_start = NULL, audio_end = NULL WHERE id = :id");
+    query.bindValue(":id", trackId);
+    if (!query.exec()) {
+        qWarning() << "Ошибка сброса анализа трека:" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+double DatabaseManager::getPlaybackRate(int trackId)
+{
+    QSqlQuery query(m_database);
+    query.prepare("SELECT playback_rate FROM tracks WHERE id = :id");
+    query.bindValue(":id", trackId);
+    if (query.exec() && query.next() && !query.value(0).isNull()) {
+        return query.value(0).toDouble();
+    }
+    return 1.0;
+}
+
+bool DatabaseManager::setPlaybackRate(int trackId, double rate)
+{
+    QSqlQuery query(m_database);
+    query.prepare("UPDATE tracks SET playback_rate = :rate WHERE id = :id");
+    // The default speed is stored as NULL.
+    query.bindValue(":rate", rate == 1.0 ? QVariant() : QVariant(rate));
+    query.bindValue(":id", trackId);
+    if (!query.exec()) {
+        qWarning() << "Ошибка сохранения скорости воспроизведения:" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+bool DatabaseManager::getAudioRange(int trackId, qint64 &start, qint64 &end)
+{
+    QSqlQuery query(m_database);
+    query.prepare("SELECT audio_start, audio_end FROM tracks WHERE id = :id");
+    query.bindValue(":id", trackId);
+    if (!query.exec() || !query.next() || query.value(1).isNull()) {
+        return false;
+    }
+    start = query.value(0).toLongLong();
+    end = query.value(1).toLongLong();
+    return true;
+}
+
+QString DatabaseManager::fileFingerprint(const QString &filePath)
+{
+    QFileInfo info(filePath);
+    if (!info.exists()) {
+        return QString();
+    }
+    return QString("%1:%2").arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch());
+}
+
 TrackInfo DatabaseManager::getTrack(int trackId)
 {
     TrackInfo track;
     track.id = -1;
     QSqlQuery query(m_database);
     query.prepare("SELECT id, file_path, title, artist, album, duration, "
-                  "cover_path, last_played, play_count FROM tracks WHERE id = :id");
+                  "cover_path, last_played, play_count, "
+                  "track_gain, track_peak, album_gain, album_peak, playback_rate, "
+                  "audio_start, audio_end "
+                  "FROM tracks WHERE id = :id");
     query.bindValue(":id", trackId);
     if (query.exec() && query.next()) {
         track.id = query.value(0).toInt();
@@ -213,6 +391,17 @@ TrackInfo DatabaseManager::getTrack(int trackId)
         track.coverPath = query.value(6).toString();
         track.lastPlayed = query.value(7).toDateTime();
         track.playCount = query.value(8).toInt();
+        track.hasTrackGain = !query.value(9).isNull();
+        track.trackGain = query.value(9).toDouble();
+        track.trackPeak = query.value(10).toDouble();
+        track.hasAlbumGain = !query.value(11).isNull();
+        track.albumGain = query.value(11).toDouble();
+        track.albumPeak = query.value(12).toDouble();
+        if (!query.value(13).isNull()) {
+            track.playbackRate = query.value(13).toDouble();
+        }
+        track.audioStart = query.value(14).toLongLong();
+        track.audioEnd = query.value(15).toLongLong();
         QSqlQuery tagQuery(m_database);
         tagQuery.prepare("SELECT t.name FROM tags t "
                         "JOIN track_tags tt ON t.id = tt.tag_id "
@@ -767,3 +956,145 @@ QStringList DatabaseManager::getAlbumsByArtist(int artistId)
     return albums;
 }
 
+QList<AlbumInfo> DatabaseManager::getAlbumSummaries()
+{
+    QList<AlbumInfo> albums;
+    QSqlQuery query(m_database);
+    // Titles such as "Greatest Hits" are shared by many artists; each of
+    // those albums gets its own tile.
+    query.exec("SELECT album, artist, COUNT(DISTINCT id), MAX(cover_path), MIN(file_path) FROM ("
+               "SELECT t.id AS id, COALESCE(al.name, t.album) AS album, COALESCE(t.artist, '') AS artist, "
+               "t.cover_path AS cover_path, t.file_path AS file_path FROM tracks t "
+               "LEFT JOIN track_albums ta ON t.id = ta.track_id "
+               "LEFT JOIN albums al ON ta.album_id = al.id"
+               ") WHERE album IS NOT NULL AND album != '' "
+               "GROUP BY album, artist ORDER BY album, artist");
+    if (query.lastError().isValid()) {
+        qWarning() << "Ошибка получения списка альбомов:" << query.lastError();
+        return albums;
+    }
+    while (query.next()) {
+        AlbumInfo album;
+        album.name = query.value(0).toString();
+        album.artist = query.value(1).toString();
+        album.trackCount = query.value(2).toInt();
+        album.coverPath = query.value(3).toString();
+        album.firstFilePath = query.value(4).toString();
+        albums << album;
+    }
+    
+    return albums;
+}
+
+bool DatabaseManager::updateTrackLoudness(int trackId, double loudness, double gain, double peak)
+{
+    QSqlQuery query(m_database);
+    query.prepare("UPDATE tracks SET loudness = :loudness, track_gain = :gain, "
+                  "track_peak = :peak WHERE id = :id");
+    query.bindValue(":loudness", loudness);
+    query.bindValue(":gain", gain);
+    query.bindValue(":peak", peak);
+    query.bindValue(":id", trackId);
+    if (!query.exec()) {
+        qWarning() << "Ошибка сохранения громкости трека:" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+bool DatabaseManager::updateAlbumGain(const QList<int> &trackIds, double gain, double peak)
+{
+    m_database.transaction();
+    QSqlQuery query(m_database);
+    query.prepare("UPDATE tracks SET album_gain = :gain, album_peak = :peak WHERE id = :id");
+    for (int trackId : trackIds) {
+        query.bindValue(":gain", gain);
+        query.bindValue(":peak", peak);
+        query.bindValue(":id", trackId);
+        if (!query.exec()) {
+            qWarning() << "Ошибка сохранения громкости альбома:" << query.lastError();
+            m_database.rollback();
+            return false;
+        }
+    }
+    return m_database.commit();
+}
+
+bool DatabaseManager::updateAudioRange(int trackId, qint64 start, qint64 end)
+{
+    QSqlQuery query(m_database);
+    query.prepare("UPDATE tracks SET audio_start = :start, audio_end = :end WHERE id = :id");
+    query.bindValue(":start", start);
+    query.bindValue(":end", end);
+    query.bindValue(":id", trackId);
+    if (!query.exec()) {
+        qWarning() << "Ошибка сохранения границ тишины трека:" << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+QList<TrackInfo> DatabaseManager::getTracksPendingLoudness()
+{
+    QList<TrackInfo> tracks;
+    QSqlQuery query(m_database);
+    // Album gain covers the whole album, so one new track puts all of its
+    // album mates back into the queue; an album is one artist's, as in
+    // TrackAnalyzer::albumKey(). Tracks from before the silence analysis
+    // existed come back once for it.
+    query.exec("SELECT id, file_path, artist, album FROM tracks t "
+               "WHERE album_gain IS NULL OR audio_end IS NULL OR (album IS NOT NULL AND album != '' AND EXISTS "
+               "(SELECT 1 FROM tracks o WHERE o.album = t.album AND o.artist IS t.artist AND o.album_gain IS NULL)) "
+               "ORDER BY artist, album, file_path");
+    if (query.lastError().isValid()) {
+        qWarning() << "Ошибка получения треков для анализа громкости:" << query.lastError();
+        return tracks;
+    }
+    while (query.next()) {
+        TrackInfo track;
+        track.id = query.value(0).toInt();
+        track.filePath = query.value(1).toString();
+        track.artist = query.value(2).toString();
+        track.album = query.value(3).toString();
+        track.duration = 0;
+        track.playCount = 0;
+        tracks << track;
+    }
+    
+    return tracks;
+}
+
+QVariantMap DatabaseManager::getLibraryStats()
+{
+    QVariantMap stats;
+    QSqlQuery query(m_database);
+    query.exec("SELECT COUNT(*), COALESCE(SUM(duration), 0), "
+               "COUNT(album_gain), COUNT(audio_end), "
+               "SUM(CASE WHEN album_gain IS NULL OR audio_end IS NULL THEN 1 ELSE 0 END), "
+               "COUNT(DISTINCT NULLIF(artist, '')), COUNT(DISTINCT NULLIF(album, '')) "
+               "FROM tracks");
+    if (query.lastError().isValid() || !query.next()) {
+        qWarning() << "Ошибка получения статистики библиотеки:" << query.lastError();
+        return stats;
+    }
+    stats["tracks"] = query.value(0).toLongLong();
+    stats["totalDurationSeconds"] = query.value(1).toLongLong();
+    stats["loudnessAnalysed"] = query.value(2).toLongLong();
+    stats["silenceAnalysed"] = query.value(3).toLongLong();
+    stats["pendingAnalysis"] = query.value(4).toLongLong();
+    stats["artists"] = query.value(5).toLongLong();
+    stats["albums"] = query.value(6).toLongLong();
+
+    const QList<QPair<QString, QString>> counts = {
+        {"playlists", "SELECT COUNT(*) FROM playlists"},
+        {"playlistEntries", "SELECT COUNT(*) FROM playlist_tracks"},
+        {"tags", "SELECT COUNT(*) FROM tags"},
+        {"historyEntries", "SELECT COUNT(*) FROM history"},
+    };
+    for (const auto &count : counts) {
+        if (query.exec(count.second) && query.next()) {
+            stats[count.first] = query.value(0).toLongLong();
+        }
+    }
+    return stats;
+}
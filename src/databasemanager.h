@@ -8,6 +8,7 @@
 #include <QStringList>
 #include <QDateTime>
 #include <QUrl>
+#include <QVariantMap>
 
 struct TrackInfo {
     int id;
@@ -20,6 +21,25 @@ struct TrackInfo {
     QString coverPath;
     QDateTime lastPlayed;
     int playCount;
+    double trackGain = 0.0;
+    double trackPeak = 0.0;
+    double albumGain = 0.0;
+    double albumPeak = 0.0;
+    bool hasTrackGain = false;
+    bool hasAlbumGain = false;
+    double playbackRate = 1.0;
+    // Audible part of the file in ms, from the silence analysis; empty while
+    // the track has not been analysed or is silent throughout.
+    qint64 audioStart = 0;
+    qint64 audioEnd = 0;
+    bool hasAudioRange() const { return audioEnd > audioStart; }
+};
+
+// Just what a rescan needs to tell missing and changed files apart.
+struct TrackFileInfo {
+    int id;
+    QString filePath;
+    QString fingerprint;
 };
 
 struct PlaylistInfo {
@@ -29,21 +49,49 @@ struct PlaylistInfo {
     QDateTime modified;
 };
 
+struct AlbumInfo {
+    QString name;
+    QString artist;
+    int trackCount;
+    QString coverPath;
+    QString firstFilePath;
+};
+
 class DatabaseManager : public QObject
 {
     Q_OBJECT
 
 public:
     explicit DatabaseManager(QObject *parent = nullptr);
+    // Any SQLite path, including ":memory:"; used by benchmarks and tools.
+    explicit DatabaseManager(const QString &databasePath, QObject *parent = nullptr);
     ~DatabaseManager();
 
     bool initializeDatabase();
     
     int addTrack(const QString &filePath, const QString &title = "", 
                  const QString &artist = "", const QString &album = "");
+    // Inserts many paths in one transaction; ids are in the order of the
+    // paths, -1 where a path failed.
+    QList<int> addTracks(const QStringList &filePaths);
     bool updateTrackInfo(int trackId, const QString &title, 
                         const QString &artist, const QString &album, 
                         int duration, const QString &coverPath = "");
+    // Tag data read from the file, stored together with the file version it
+    // came from so it is only read again once the file changes.
+    bool updateTrackMetadata(int trackId, const QString &title,
+                             const QString &artist, const QString &album,
+                             int duration, const QString &coverPath,
+                             const QString &fingerprint);
+    QString getFileFingerprint(int trackId);
+    QList<TrackFileInfo> getTrackFiles();
+    // Forgets tags, loudness and silence data read from an older version of
+    // the file, so they are read and analysed again.
+    bool resetTrackAnalysis(int trackId);
+    static QString fileFingerprint(const QString &filePath);
+    double getPlaybackRate(int trackId);
+    bool setPlaybackRate(int trackId, double rate);
+    bool getAudioRange(int trackId, qint64 &start, qint64 &end);
     TrackInfo getTrack(int trackId);
     QList<TrackInfo> getAllTracks();
     QList<TrackInfo> searchTracks(const QString &query);
@@ -86,10 +134,23 @@ public:
     QList<TrackInfo> getTracksByAlbum(int albumId);
     int getAlbumId(const QString &name);
     QStringList getAlbumsByArtist(int artistId);
+    QList<AlbumInfo> getAlbumSummaries();
+    
+    bool updateTrackLoudness(int trackId, double loudness, double gain, double peak);
+    bool updateAlbumGain(const QList<int> &trackIds, double gain, double peak);
+    bool updateAudioRange(int trackId, qint64 start, qint64 end);
+    QList<TrackInfo> getTracksPendingLoudness();
+    // Library-wide counts by name, e.g. "tracks" or "pendingAnalysis".
+    QVariantMap getLibraryStats();
+    // The connection itself, for bulk writers such as the benchmark generator.
+    QSqlDatabase database() const;
 
 private:
     QSqlDatabase m_database;
+    QString m_connectionName;
+    void openDatabase(const QString &databasePath);
     bool createTables();
+    bool ensureColumn(const QString &table, const QString &column, const QString &definition);
 };
 
 #endif
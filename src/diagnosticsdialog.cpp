@@ -0,0 +1,181 @@
+#include "diagnosticsdialog.h"
+#include <QDateTime>
+#include <QFile>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QJsonDocument>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+DiagnosticsDialog::DiagnosticsDialog(AudioPlayer *player, QWidget *parent)
+    : QDialog(parent)
+    , m_player(player)
+{
+    setWindowTitle("Диагностика");
+    resize(720, 560);
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    m_table = new QTableWidget(this);
+    m_table->setColumnCount(7);
+    m_table->setHorizontalHeaderLabels({"Этап", "Кол-во", "p50, мс", "p95, мс", "p99, мс", "Среднее, мс", "Макс., мс"});
+    m_table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_table->verticalHeader()->setVisible(false);
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->setSelectionMode(QAbstractItemView::NoSelection);
+    mainLayout->addWidget(m_table);
+
+    m_engineLabel = new QLabel(this);
+    mainLayout->addWidget(m_engineLabel);
+    m_prefetchLabel = new QLabel(this);
+    mainLayout->addWidget(m_prefetchLabel);
+
+    m_glitchLabel = new QLabel(this);
+    m_glitchLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    mainLayout->addWidget(m_glitchLabel);
+    m_glitchTable = new QTableWidget(this);
+    m_glitchTable->setColumnCount(5);
+    m_glitchTable->setHorizontalHeaderLabels({"Время", "Событие", "Значение", "Трек", "Фоновая нагрузка"});
+    m_glitchTable->horizontalHeader()->setSectionResizeMode(4, QHeaderView::Stretch);
+    m_glitchTable->verticalHeader()->setVisible(false);
+    m_glitchTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_glitchTable->setSelectionMode(QAbstractItemView::NoSelection);
+    mainLayout->addWidget(m_glitchTable);
+
+    QHBoxLayout *buttonsLayout = new QHBoxLayout();
+    QPushButton *refreshBtn = new QPushButton("Обновить", this);
+    QPushButton *resetBtn = new QPushButton("Сбросить", this);
+    QPushButton *saveBtn = new QPushButton("Сохранить JSON...", this);
+    QPushButton *closeBtn = new QPushButton("Закрыть", this);
+    buttonsLayout->addWidget(refreshBtn);
+    buttonsLayout->addWidget(resetBtn);
+    buttonsLayout->addWidget(saveBtn);
+    buttonsLayout->addStretch();
+    buttonsLayout->addWidget(closeBtn);
+    mainLayout->addLayout(buttonsLayout);
+
+    connect(refreshBtn, &QPushButton::clicked, this, &DiagnosticsDialog::refresh);
+    connect(resetBtn, &QPushButton::clicked, this, &DiagnosticsDialog::onReset);
+    connect(saveBtn, &QPushButton::clicked, this, &DiagnosticsDialog::onSaveJson);
+    connect(closeBtn, &QPushButton::clicked, this, &QDialog::close);
+    connect(m_player->latencyTracker(), &LatencyTracker::spanFinished, this, &DiagnosticsDialog::refresh);
+    connect(m_player->glitchMonitor(), &GlitchMonitor::glitchRecorded, this, &DiagnosticsDialog::refresh);
+
+    refresh();
+}
+
+void DiagnosticsDialog::refresh()
+{
+    static const char *kKindLabels[LatencyTracker::SpanKindCount] = {"Запуск трека", "Переход"};
+    static const char *kStageLabels[LatencyTracker::StageCount] = {"setTrack()", "LoadedMedia", "PlayingState", "Первый звук"};
+
+    const QList<LatencyTracker::Summary> summaries = m_player->latencyTracker()->summaries();
+    m_table->setRowCount(summaries.size());
+    int row = 0;
+    for (const LatencyTracker::Summary &summary : summaries) {
+        QString stage = QString("%1 → %2").arg(kKindLabels[summary.kind], kStageLabels[summary.stage]);
+        m_table->setItem(row, 0, new QTableWidgetItem(stage));
+        m_table->setItem(row, 1, new QTableWidgetItem(QString::number(summary.count)));
+        const double values[] = {summary.p50, summary.p95, summary.p99, summary.mean, summary.maximum};
+        for (int column = 0; column < 5; ++column) {
+            QString text = summary.count ? QString::number(values[column], 'f', 1) : QString("—");
+            QTableWidgetItem *item = new QTableWidgetItem(text);
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            m_table->setItem(row, column + 2, item);
+        }
+        ++row;
+    }
+
+    PcmEngine *engine = m_player->engine();
+    if (m_player->backend() == AudioPlayer::PcmEngineBackend && engine) {
+        m_engineLabel->setText(QString("Аудиодвижок: буфер %1 мс, период %2 мс, опустошений буфера: %3")
+                               .arg(engine->bufferMs()).arg(engine->periodMs()).arg(engine->underrunCount()));
+    } else {
+        m_engineLabel->setText("Бэкенд: QMediaPlayer (первый звук оценивается по первой позиции после нуля)");
+    }
+
+    const Prefetcher::Stats prefetch = m_player->prefetcher()->stats();
+    QString resident = prefetch.residentSamples
+        ? QString("%1%").arg(100.0 * prefetch.residentSum / prefetch.residentSamples, 0, 'f', 0)
+        : QString("—");
+    m_prefetchLabel->setText(QString("Упреждающее чтение: запросов %1, успело %2, опоздало %3, в кэше ОС %4")
+                             .arg(prefetch.requested).arg(prefetch.inTime).arg(prefetch.late).arg(resident));
+
+    static const char *kGlitchLabels[GlitchMonitor::KindCount] = {
+        "Опустошение буфера", "Низкий уровень буфера", "Поздний вызов вывода", "Остановка позиции"
+    };
+    GlitchMonitor *glitches = m_player->glitchMonitor();
+    m_glitchLabel->setText(QString("Сбои: опустошений %1, низкий буфер %2, поздних вызовов %3, остановок позиции %4. Журнал: %5")
+                           .arg(glitches->count(GlitchMonitor::Underrun))
+                           .arg(glitches->count(GlitchMonitor::LowBuffer))
+                           .arg(glitches->count(GlitchMonitor::LateCallback))
+                           .arg(glitches->count(GlitchMonitor::StalledPosition))
+                           .arg(GlitchMonitor::logFilePath()));
+    const QList<GlitchMonitor::Event> events = glitches->events();
+    m_glitchTable->setRowCount(events.size());
+    // Newest first.
+    for (int i = 0; i < events.size(); ++i) {
+        const GlitchMonitor::Event &event = events[events.size() - 1 - i];
+        QString value = event.kind == GlitchMonitor::Underrun
+            ? QString::number(event.value, 'f', 0)
+            : QString("%1 мс").arg(event.value, 0, 'f', 1);
+        m_glitchTable->setItem(i, 0, new QTableWidgetItem(event.time.toString("HH:mm:ss.zzz")));
+        m_glitchTable->setItem(i, 1, new QTableWidgetItem(kGlitchLabels[event.kind]));
+        m_glitchTable->setItem(i, 2, new QTableWidgetItem(value));
+        m_glitchTable->setItem(i, 3, new QTableWidgetItem(QFileInfo(event.filePath).fileName()));
+        m_glitchTable->setItem(i, 4, new QTableWidgetItem(event.load));
+    }
+}
+
+QJsonObject DiagnosticsDialog::snapshot() const
+{
+    QJsonObject root = m_player->latencyTracker()->toJson();
+    root["generated"] = QDateTime::currentDateTime().toString(Qt::ISODateWithMs);
+    root["backend"] = m_player->backend() == AudioPlayer::PcmEngineBackend ? "pcmEngine" : "mediaPlayer";
+    PcmEngine *engine = m_player->engine();
+    if (engine) {
+        QJsonObject engineInfo;
+        engineInfo["bufferMs"] = engine->bufferMs();
+        engineInfo["periodMs"] = engine->periodMs();
+        engineInfo["underruns"] = static_cast<qint64>(engine->underrunCount());
+        root["engine"] = engineInfo;
+    }
+    const Prefetcher::Stats prefetch = m_player->prefetcher()->stats();
+    QJsonObject prefetchInfo;
+    prefetchInfo["byteCap"] = m_player->prefetcher()->byteCap();
+    prefetchInfo["requested"] = prefetch.requested;
+    prefetchInfo["started"] = prefetch.started;
+    prefetchInfo["inTime"] = prefetch.inTime;
+    prefetchInfo["late"] = prefetch.late;
+    if (prefetch.residentSamples) {
+        prefetchInfo["meanResident"] = prefetch.residentSum / prefetch.residentSamples;
+    }
+    root["prefetch"] = prefetchInfo;
+    root["glitches"] = m_player->glitchMonitor()->toJson();
+    return root;
+}
+
+void DiagnosticsDialog::onSaveJson()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, "Сохранить диагностику", "diagnostics.json",
+                                                    "JSON (*.json)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QMessageBox::warning(this, "Ошибка", "Не удалось сохранить файл: " + file.errorString());
+        return;
+    }
+    file.write(QJsonDocument(snapshot()).toJson(QJsonDocument::Indented));
+}
+
+void DiagnosticsDialog::onReset()
+{
+    m_player->latencyTracker()->reset();
+    m_player->prefetcher()->resetStats();
+    m_player->glitchMonitor()->reset();
+    refresh();
+}
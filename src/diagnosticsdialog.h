@@ -0,0 +1,38 @@
+#ifndef DIAGNOSTICSDIALOG_H
+#define DIAGNOSTICSDIALOG_H
+
+#include <QDialog>
+#include <QJsonObject>
+#include <QLabel>
+#include <QTableWidget>
+#include "audioplayer.h"
+
+// Latency percentiles of track starts and transitions, a few engine
+// counters and the recent playback glitches, with an export of the same
+// data as JSON.
+class DiagnosticsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit DiagnosticsDialog(AudioPlayer *player, QWidget *parent = nullptr);
+
+    QJsonObject snapshot() const;
+
+public slots:
+    void refresh();
+
+private slots:
+    void onSaveJson();
+    void onReset();
+
+private:
+    AudioPlayer *m_player;
+    QTableWidget *m_table;
+    QLabel *m_engineLabel;
+    QLabel *m_prefetchLabel;
+    QLabel *m_glitchLabel;
+    QTableWidget *m_glitchTable;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef DOTPRODUCT_H
+#define DOTPRODUCT_H
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DOTPRODUCT_USE_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define DOTPRODUCT_USE_NEON
+#include <arm_neon.h>
+#endif
+
+// Sum of a[i] * b[i], eight floats per step where SSE2 or NEON is
+// available. Neither pointer needs to be aligned.
+inline float dotProduct(const float *a, const float *b, int count)
+{
+    int index = 0;
+    float sum = 0.0f;
+#if defined(DOTPRODUCT_USE_SSE2)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (; index + 8 <= count; index += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + index), _mm_loadu_ps(b + index)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + index + 4), _mm_loadu_ps(b + index + 4)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(DOTPRODUCT_USE_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    for (; index + 8 <= count; index += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + index), vld1q_f32(b + index));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + index + 4), vld1q_f32(b + index + 4));
+    }
+    sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+    for (; index < count; ++index) {
+        sum += a[index] * b[index];
+    }
+    return sum;
+}
+
+#endif
@@ -0,0 +1,231 @@
+#include "equalizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EQUALIZER_USE_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define EQUALIZER_USE_NEON
+#include <arm_neon.h>
+#endif
+
+static const double kPi = 3.14159265358979323846;
+static const float kBandFrequencies[Equalizer::BandCount] = {
+    31.25f, 62.5f, 125.0f, 250.0f, 500.0f, 1000.0f, 2000.0f, 4000.0f, 8000.0f, 16000.0f
+};
+// One octave per band.
+static const double kBandQ = 1.414;
+
+Equalizer::Equalizer()
+    : m_enabled(false)
+    , m_generation(1)
+    , m_sampleRate(0)
+    , m_appliedGeneration(0)
+    , m_activeCount(0)
+    , m_simdEnabled(true)
+{
+    for (std::atomic<float> &gain : m_gains) {
+        gain.store(0.0f, std::memory_order_relaxed);
+    }
+    std::memset(m_coefficients, 0, sizeof(m_coefficients));
+    std::memset(m_state, 0, sizeof(m_state));
+}
+
+void Equalizer::setEnabled(bool enabled)
+{
+    m_enabled.store(enabled, std::memory_order_relaxed);
+    m_generation.fetch_add(1, std::memory_order_release);
+}
+
+void Equalizer::setBandGain(int band, float gainDb)
+{
+    if (band < 0 || band >= BandCount) {
+        return;
+    }
+    m_gains[band].store(std::clamp(gainDb, -MaxGainDb, MaxGainDb), std::memory_order_relaxed);
+    m_generation.fetch_add(1, std::memory_order_release);
+}
+
+float Equalizer::bandGain(int band) const
+{
+    if (band < 0 || band >= BandCount) {
+        return 0.0f;
+    }
+    return m_gains[band].load(std::memory_order_relaxed);
+}
+
+void Equalizer::setGains(const std::vector<float> &gains)
+{
+    for (int band = 0; band < BandCount && band < static_cast<int>(gains.size()); ++band) {
+        m_gains[band].store(std::clamp(gains[band], -MaxGainDb, MaxGainDb), std::memory_order_relaxed);
+    }
+    m_generation.fetch_add(1, std::memory_order_release);
+}
+
+float Equalizer::bandFrequency(int band)
+{
+    return band >= 0 && band < BandCount ? kBandFrequencies[band] : 0.0f;
+}
+
+const std::vector<EqualizerPreset> &Equalizer::presets()
+{
+    static const std::vector<EqualizerPreset> list = {
+        {"Без эффектов", {0, 0, 0, 0, 0, 0, 0, 0, 0, 0}},
+        {"Рок", {5, 4, 3, 1, -1, -1, 1, 3, 4, 5}},
+        {"Поп", {-1, 0, 2, 4, 5, 4, 2, 0, -1, -1}},
+        {"Джаз", {3, 2, 1, 2, -1, -1, 0, 1, 2, 3}},
+        {"Классика", {4, 3, 2, 1, 0, 0, 0, 1, 2, 3}},
+        {"Электроника", {5, 4, 1, 0, -2, 1, 0, 2, 4, 5}},
+        {"Усиление басов", {7, 6, 4, 2, 0, 0, 0, 0, 0, 0}},
+        {"Усиление высоких", {0, 0, 0, 0, 0, 1, 2, 4, 6, 7}},
+        {"Вокал", {-2, -2, -1, 1, 3, 4, 3, 1, 0, -1}},
+    };
+    return list;
+}
+
+void Equalizer::prepare(int sampleRate, int channels)
+{
+    (void)channels;
+    m_sampleRate = sampleRate;
+    m_appliedGeneration = 0;
+    std::memset(m_state, 0, sizeof(m_state));
+}
+
+void Equalizer::updateCoefficients()
+{
+    m_activeCount = 0;
+    for (int band = 0; band < BandCount; ++band) {
+        const double gainDb = m_gains[band].load(std::memory_order_relaxed);
+        const double frequency = kBandFrequencies[band];
+        // Flat bands and bands too close to Nyquist are skipped entirely.
+        if (std::fabs(gainDb) < 0.05 || frequency >= m_sampleRate * 0.45) {
+            std::memset(m_state[band], 0, sizeof(m_state[band]));
+            continue;
+        }
+        const double a = std::pow(10.0, gainDb / 40.0);
+        const double w0 = 2.0 * kPi * frequency / m_sampleRate;
+        const double alpha = std::sin(w0) / (2.0 * kBandQ);
+        const double cosW0 = std::cos(w0);
+        const double a0 = 1.0 + alpha / a;
+        Coefficients &c = m_coefficients[band];
+        c.b0 = (1.0 + alpha * a) / a0;
+        c.b1 = -2.0 * cosW0 / a0;
+        c.b2 = (1.0 - alpha * a) / a0;
+        c.a1 = -2.0 * cosW0 / a0;
+        c.a2 = (1.0 - alpha / a) / a0;
+        m_activeBands[m_activeCount++] = band;
+    }
+}
+
+void Equalizer::process(float *interleaved, int frames, int channels)
+{
+    if (m_sampleRate <= 0 || channels != 2) {
+        return;
+    }
+    unsigned generation = m_generation.load(std::memory_order_acquire);
+    if (generation != m_appliedGeneration) {
+        m_appliedGeneration = generation;
+        updateCoefficients();
+    }
+    if (!m_enabled.load(std::memory_order_relaxed) || m_activeCount == 0) {
+        return;
+    }
+    if (m_simdEnabled) {
+        processSimd(interleaved, frames);
+    } else {
+        processScalar(interleaved, frames);
+    }
+}
+
+void Equalizer::processScalar(float *interleaved, int frames)
+{
+    for (int index = 0; index < m_activeCount; ++index) {
+        const int band = m_activeBands[index];
+        const Coefficients &c = m_coefficients[band];
+        for (int channel = 0; channel < 2; ++channel) {
+            double z1 = m_state[band][0][channel];
+            double z2 = m_state[band][1][channel];
+            float *sample = interleaved + channel;
+            for (int frame = 0; frame < frames; ++frame, sample += 2) {
+                double x = *sample;
+                double y = c.b0 * x + z1;
+                z1 = c.b1 * x - c.a1 * y + z2;
+                z2 = c.b2 * x - c.a2 * y;
+                *sample = static_cast<float>(y);
+            }
+            m_state[band][0][channel] = z1;
+            m_state[band][1][channel] = z2;
+        }
+    }
+}
+
+void Equalizer::processSimd(float *interleaved, int frames)
+{
+#if defined(EQUALIZER_USE_SSE2)
+    // The frame is widened to double once and runs through every active band
+    // before it is written back.
+    __m128d b0[BandCount], b1[BandCount], b2[BandCount], a1[BandCount], a2[BandCount];
+    __m128d z1[BandCount], z2[BandCount];
+    for (int index = 0; index < m_activeCount; ++index) {
+        const int band = m_activeBands[index];
+        const Coefficients &c = m_coefficients[band];
+        b0[index] = _mm_set1_pd(c.b0);
+        b1[index] = _mm_set1_pd(c.b1);
+        b2[index] = _mm_set1_pd(c.b2);
+        a1[index] = _mm_set1_pd(c.a1);
+        a2[index] = _mm_set1_pd(c.a2);
+        z1[index] = _mm_load_pd(m_state[band][0]);
+        z2[index] = _mm_load_pd(m_state[band][1]);
+    }
+    for (int frame = 0; frame < frames; ++frame) {
+        float *sample = interleaved + frame * 2;
+        __m128d x = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(sample))));
+        for (int index = 0; index < m_activeCount; ++index) {
+            __m128d y = _mm_add_pd(_mm_mul_pd(b0[index], x), z1[index]);
+            z1[index] = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(b1[index], x), _mm_mul_pd(a1[index], y)), z2[index]);
+            z2[index] = _mm_sub_pd(_mm_mul_pd(b2[index], x), _mm_mul_pd(a2[index], y));
+            x = y;
+        }
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(sample), _mm_castps_si128(_mm_cvtpd_ps(x)));
+    }
+    for (int index = 0; index < m_activeCount; ++index) {
+        const int band = m_activeBands[index];
+        _mm_store_pd(m_state[band][0], z1[index]);
+        _mm_store_pd(m_state[band][1], z2[index]);
+    }
+#elif defined(EQUALIZER_USE_NEON)
+    float64x2_t b0[BandCount], b1[BandCount], b2[BandCount], a1[BandCount], a2[BandCount];
+    float64x2_t z1[BandCount], z2[BandCount];
+    for (int index = 0; index < m_activeCount; ++index) {
+        const int band = m_activeBands[index];
+        const Coefficients &c = m_coefficients[band];
+        b0[index] = vdupq_n_f64(c.b0);
+        b1[index] = vdupq_n_f64(c.b1);
+        b2[index] = vdupq_n_f64(c.b2);
+        a1[index] = vdupq_n_f64(c.a1);
+        a2[index] = vdupq_n_f64(c.a2);
+        z1[index] = vld1q_f64(m_state[band][0]);
+        z2[index] = vld1q_f64(m_state[band][1]);
+    }
+    for (int frame = 0; frame < frames; ++frame) {
+        float *sample = interleaved + frame * 2;
+        float64x2_t x = vcvt_f64_f32(vld1_f32(sample));
+        for (int index = 0; index < m_activeCount; ++index) {
+            float64x2_t y = vfmaq_f64(z1[index], b0[index], x);
+            z1[index] = vfmsq_f64(vfmaq_f64(z2[index], b1[index], x), a1[index], y);
+            z2[index] = vfmsq_f64(vmulq_f64(b2[index], x), a2[index], y);
+            x = y;
+        }
+        vst1_f32(sample, vcvt_f32_f64(x));
+    }
+    for (int index = 0; index < m_activeCount; ++index) {
+        const int band = m_activeBands[index];
+        vst1q_f64(m_state[band][0], z1[index]);
+        vst1q_f64(m_state[band][1], z2[index]);
+    }
+#else
+    processScalar(interleaved, frames);
+#endif
+}
@@ -0,0 +1,65 @@
+#ifndef EQUALIZER_H
+#define EQUALIZER_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "audioprocessor.h"
+
+struct EqualizerPreset {
+    std::string name;
+    std::vector<float> gains;
+};
+
+// 10-band graphic equalizer built from RBJ peaking biquads. Gains are set
+// from the GUI thread through atomics; the audio thread notices the bumped
+// generation and recomputes its coefficients before the next block. Left and
+// right share one SIMD register (SSE2 or NEON), in double precision so the
+// low bands stay stable.
+class Equalizer : public AudioProcessor
+{
+public:
+    static const int BandCount = 10;
+    static constexpr float MaxGainDb = 12.0f;
+
+    Equalizer();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void setBandGain(int band, float gainDb);
+    float bandGain(int band) const;
+    void setGains(const std::vector<float> &gains);
+    static float bandFrequency(int band);
+    static const std::vector<EqualizerPreset> &presets();
+    // Forces the portable path, so benchmarks can compare the two. Call
+    // while the output is stopped.
+    void setSimdEnabled(bool enabled) { m_simdEnabled = enabled; }
+
+    void prepare(int sampleRate, int channels) override;
+    void process(float *interleaved, int frames, int channels) override;
+
+private:
+    struct Coefficients {
+        double b0, b1, b2, a1, a2;
+    };
+
+    void updateCoefficients();
+    void processScalar(float *interleaved, int frames);
+    void processSimd(float *interleaved, int frames);
+
+    std::atomic<float> m_gains[BandCount];
+    std::atomic<bool> m_enabled;
+    std::atomic<unsigned> m_generation;
+
+    // Audio thread state.
+    int m_sampleRate;
+    unsigned m_appliedGeneration;
+    int m_activeBands[BandCount];
+    int m_activeCount;
+    bool m_simdEnabled;
+    Coefficients m_coefficients[BandCount];
+    // [band][z1/z2][left/right]
+    alignas(16) double m_state[BandCount][2][2];
+};
+
+#endif
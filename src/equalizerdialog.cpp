@@ -0,0 +1,125 @@
+#include "equalizerdialog.h"
+#include <QGridLayout>
+#include <QHBoxLayout>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <cmath>
+
+// Sliders work in tenths of a decibel.
+static const int kSliderScale = 10;
+
+EqualizerDialog::EqualizerDialog(Equalizer *equalizer, QWidget *parent)
+    : QDialog(parent)
+    , m_equalizer(equalizer)
+    , m_updating(false)
+{
+    setWindowTitle("Эквалайзер");
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    QHBoxLayout *topLayout = new QHBoxLayout();
+    m_enabledCheck = new QCheckBox("Включить", this);
+    m_presetCombo = new QComboBox(this);
+    m_presetCombo->addItem("Пользовательский");
+    for (const EqualizerPreset &preset : Equalizer::presets()) {
+        m_presetCombo->addItem(QString::fromStdString(preset.name));
+    }
+    QPushButton *resetBtn = new QPushButton("Сбросить", this);
+    topLayout->addWidget(m_enabledCheck);
+    topLayout->addStretch();
+    topLayout->addWidget(new QLabel("Пресет:", this));
+    topLayout->addWidget(m_presetCombo);
+    topLayout->addWidget(resetBtn);
+    mainLayout->addLayout(topLayout);
+
+    QGridLayout *bandsLayout = new QGridLayout();
+    for (int band = 0; band < Equalizer::BandCount; ++band) {
+        QLabel *gainLabel = new QLabel(this);
+        gainLabel->setAlignment(Qt::AlignCenter);
+        QSlider *slider = new QSlider(Qt::Vertical, this);
+        int range = static_cast<int>(Equalizer::MaxGainDb) * kSliderScale;
+        slider->setRange(-range, range);
+        slider->setPageStep(kSliderScale);
+        slider->setTickPosition(QSlider::TicksBothSides);
+        slider->setTickInterval(6 * kSliderScale);
+        slider->setMinimumHeight(160);
+        float frequency = Equalizer::bandFrequency(band);
+        QLabel *frequencyLabel = new QLabel(frequency >= 1000.0f
+                                            ? QString("%1 кГц").arg(frequency / 1000.0f)
+                                            : QString("%1 Гц").arg(std::round(frequency)), this);
+        frequencyLabel->setAlignment(Qt::AlignCenter);
+        bandsLayout->addWidget(gainLabel, 0, band);
+        bandsLayout->addWidget(slider, 1, band, Qt::AlignHCenter);
+        bandsLayout->addWidget(frequencyLabel, 2, band);
+        m_bandSliders << slider;
+        m_gainLabels << gainLabel;
+        connect(slider, &QSlider::valueChanged, this, &EqualizerDialog::onBandChanged);
+    }
+    mainLayout->addLayout(bandsLayout);
+
+    m_backendNotice = new QLabel("Эквалайзер работает только с собственным аудиодвижком "
+                                 "(Воспроизведение → Собственный аудиодвижок).", this);
+    m_backendNotice->setWordWrap(true);
+    mainLayout->addWidget(m_backendNotice);
+
+    connect(m_enabledCheck, &QCheckBox::toggled, this, &EqualizerDialog::onEnabledToggled);
+    connect(m_presetCombo, QOverload<int>::of(&QComboBox::activated), this, &EqualizerDialog::onPresetChanged);
+    connect(resetBtn, &QPushButton::clicked, this, [this]() {
+        onPresetChanged(1);
+    });
+
+    syncFromEqualizer();
+}
+
+void EqualizerDialog::setBackendNoticeVisible(bool visible)
+{
+    m_backendNotice->setVisible(visible);
+}
+
+void EqualizerDialog::syncFromEqualizer()
+{
+    m_updating = true;
+    m_enabledCheck->setChecked(m_equalizer->isEnabled());
+    for (int band = 0; band < Equalizer::BandCount; ++band) {
+        float gain = m_equalizer->bandGain(band);
+        m_bandSliders[band]->setValue(qRound(gain * kSliderScale));
+        m_gainLabels[band]->setText(QString("%1 дБ").arg(gain, 0, 'f', 1));
+    }
+    m_updating = false;
+}
+
+void EqualizerDialog::onPresetChanged(int index)
+{
+    const std::vector<EqualizerPreset> &presets = Equalizer::presets();
+    if (index < 1 || index > static_cast<int>(presets.size())) {
+        return;
+    }
+    m_equalizer->setGains(presets[index - 1].gains);
+    if (!m_equalizer->isEnabled()) {
+        m_equalizer->setEnabled(true);
+    }
+    syncFromEqualizer();
+    m_presetCombo->setCurrentIndex(index);
+}
+
+void EqualizerDialog::onBandChanged()
+{
+    if (m_updating) {
+        return;
+    }
+    std::vector<float> gains;
+    for (int band = 0; band < Equalizer::BandCount; ++band) {
+        float gain = m_bandSliders[band]->value() / float(kSliderScale);
+        gains.push_back(gain);
+        m_gainLabels[band]->setText(QString("%1 дБ").arg(gain, 0, 'f', 1));
+    }
+    m_equalizer->setGains(gains);
+    m_presetCombo->setCurrentIndex(0);
+}
+
+void EqualizerDialog::onEnabledToggled(bool enabled)
+{
+    if (m_updating) {
+        return;
+    }
+    m_equalizer->setEnabled(enabled);
+}
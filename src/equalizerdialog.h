@@ -0,0 +1,38 @@
+#ifndef EQUALIZERDIALOG_H
+#define EQUALIZERDIALOG_H
+
+#include <QDialog>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QLabel>
+#include <QList>
+#include <QSlider>
+#include "equalizer.h"
+
+class EqualizerDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit EqualizerDialog(Equalizer *equalizer, QWidget *parent = nullptr);
+
+    void setBackendNoticeVisible(bool visible);
+
+private slots:
+    void onPresetChanged(int index);
+    void onBandChanged();
+    void onEnabledToggled(bool enabled);
+
+private:
+    void syncFromEqualizer();
+
+    Equalizer *m_equalizer;
+    QCheckBox *m_enabledCheck;
+    QComboBox *m_presetCombo;
+    QLabel *m_backendNotice;
+    QList<QSlider *> m_bandSliders;
+    QList<QLabel *> m_gainLabels;
+    bool m_updating;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#include "filerangedevice.h"
+
+FileRangeDevice::FileRangeDevice(const QString &filePath, qint64 offset, QObject *parent)
+    : QIODevice(parent)
+    , m_file(filePath)
+    , m_offset(qMax<qint64>(0, offset))
+{
+}
+
+bool FileRangeDevice::open(OpenMode mode)
+{
+    if (mode & WriteOnly) {
+        return false;
+    }
+    if (!m_file.open(QIODevice::ReadOnly) || !m_file.seek(m_offset)) {
+        m_file.close();
+        return false;
+    }
+    return QIODevice::open(mode | Unbuffered);
+}
+
+void FileRangeDevice::close()
+{
+    QIODevice::close();
+    m_file.close();
+}
+
+qint64 FileRangeDevice::size() const
+{
+    return qMax<qint64>(0, m_file.size() - m_offset);
+}
+
+bool FileRangeDevice::seek(qint64 position)
+{
+    if (position < 0 || !QIODevice::seek(position)) {
+        return false;
+    }
+    return m_file.seek(m_offset + position);
+}
+
+qint64 FileRangeDevice::readData(char *data, qint64 maxSize)
+{
+    return m_file.read(data, maxSize);
+}
+
+qint64 FileRangeDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data)
+    Q_UNUSED(maxSize)
+    return -1;
+}
@@ -0,0 +1,32 @@
+#ifndef FILERANGEDEVICE_H
+#define FILERANGEDEVICE_H
+
+#include <QFile>
+#include <QIODevice>
+
+// Read-only view of a file from a byte offset to its end, presented as a
+// device starting at position 0. Lets a decoder begin at a frame boundary
+// found in a seek index.
+class FileRangeDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    FileRangeDevice(const QString &filePath, qint64 offset, QObject *parent = nullptr);
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return false; }
+    qint64 size() const override;
+    bool seek(qint64 position) override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    QFile m_file;
+    qint64 m_offset;
+};
+
+#endif
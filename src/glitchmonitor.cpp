@@ -0,0 +1,141 @@
+#include "glitchmonitor.h"
+#include "backgroundscheduler.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTextStream>
+#include <algorithm>
+#include <cstdlib>
+
+GlitchMonitor::GlitchMonitor(QObject *parent)
+    : QObject(parent)
+    , m_trackId(-1)
+    , m_playing(false)
+{
+    reset();
+}
+
+void GlitchMonitor::setTrack(const TrackInfo &track)
+{
+    m_trackId = track.id;
+    m_filePath = track.filePath;
+}
+
+void GlitchMonitor::record(Kind kind, double value)
+{
+    Event event;
+    event.time = QDateTime::currentDateTime();
+    event.kind = kind;
+    event.value = value;
+    event.trackId = m_trackId;
+    event.filePath = m_filePath;
+    event.load = currentLoad();
+    if (m_events.size() >= MaxEvents) {
+        m_events.removeFirst();
+    }
+    m_events.append(event);
+    ++m_counts[kind];
+    appendToLog(event);
+    emit glitchRecorded();
+}
+
+void GlitchMonitor::positionUpdated()
+{
+    if (!m_playing) {
+        return;
+    }
+    if (m_sinceUpdate.isValid() && m_sinceUpdate.elapsed() > StallThresholdMs) {
+        record(StalledPosition, m_sinceUpdate.elapsed());
+    }
+    m_sinceUpdate.start();
+}
+
+void GlitchMonitor::setPlaying(bool playing)
+{
+    m_playing = playing;
+    if (playing) {
+        m_sinceUpdate.start();
+    } else {
+        m_sinceUpdate.invalidate();
+    }
+}
+
+void GlitchMonitor::reset()
+{
+    m_events.clear();
+    std::fill(m_counts, m_counts + KindCount, 0);
+}
+
+QJsonObject GlitchMonitor::toJson() const
+{
+    QJsonObject counts;
+    for (int kind = 0; kind < KindCount; ++kind) {
+        counts[kindName(static_cast<Kind>(kind))] = static_cast<qint64>(m_counts[kind]);
+    }
+    QJsonArray events;
+    for (const Event &event : m_events) {
+        QJsonObject item;
+        item["time"] = event.time.toString(Qt::ISODateWithMs);
+        item["kind"] = kindName(event.kind);
+        item["value"] = event.value;
+        item["trackId"] = event.trackId;
+        item["file"] = event.filePath;
+        item["load"] = event.load;
+        events.append(item);
+    }
+    QJsonObject root;
+    root["counts"] = counts;
+    root["events"] = events;
+    return root;
+}
+
+QString GlitchMonitor::logFilePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/glitches.log";
+}
+
+QString GlitchMonitor::kindName(Kind kind)
+{
+    static const char *kNames[KindCount] = {"underrun", "lowBuffer", "lateCallback", "stalledPosition"};
+    return QString::fromLatin1(kNames[kind]);
+}
+
+QString GlitchMonitor::currentLoad() const
+{
+    QStringList parts;
+    if (m_loadProbe) {
+        QString probe = m_loadProbe();
+        if (!probe.isEmpty()) {
+            parts << probe;
+        }
+    }
+    if (BackgroundScheduler *scheduler = BackgroundScheduler::instance()) {
+        parts << QString("jobs %1/%2/%3").arg(scheduler->activeJobs(BackgroundScheduler::Interactive))
+                                         .arg(scheduler->activeJobs(BackgroundScheduler::Normal))
+                                         .arg(scheduler->activeJobs(BackgroundScheduler::Bulk));
+    }
+#if defined(Q_OS_UNIX)
+    double loadAverage[1];
+    if (getloadavg(loadAverage, 1) == 1) {
+        parts << QString("loadavg %1").arg(loadAverage[0], 0, 'f', 2);
+    }
+#endif
+    return parts.join(", ");
+}
+
+void GlitchMonitor::appendToLog(const Event &event) const
+{
+    const QString path = logFilePath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        return;
+    }
+    QTextStream stream(&file);
+    stream << event.time.toString(Qt::ISODateWithMs) << '\t' << kindName(event.kind) << '\t'
+           << QString::number(event.value, 'f', 1) << '\t' << event.trackId << '\t'
+           << event.filePath << '\t' << event.load << '\n';
+}
@@ -0,0 +1,74 @@
+#ifndef GLITCHMONITOR_H
+#define GLITCHMONITOR_H
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <functional>
+#include "databasemanager.h"
+
+// Collects evidence of audible dropouts: underruns and low buffer levels of
+// the PCM engine, late audio callbacks, and gaps in QMediaPlayer position
+// updates. Every event is stamped with the track and the background load at
+// that moment and appended to glitches.log.
+class GlitchMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Kind {
+        Underrun,
+        LowBuffer,
+        LateCallback,
+        StalledPosition,
+        KindCount
+    };
+
+    struct Event {
+        QDateTime time;
+        Kind kind;
+        double value;       // count for underruns, milliseconds otherwise
+        int trackId;
+        QString filePath;
+        QString load;
+    };
+
+    static const int MaxEvents = 500;
+    static const int StallThresholdMs = 2000;
+
+    explicit GlitchMonitor(QObject *parent = nullptr);
+
+    // Describes concurrent background work (imports, analysis) for events.
+    void setLoadProbe(const std::function<QString()> &probe) { m_loadProbe = probe; }
+    void setTrack(const TrackInfo &track);
+    void record(Kind kind, double value);
+    void positionUpdated();
+    void setPlaying(bool playing);
+
+    QList<Event> events() const { return m_events; }
+    quint64 count(Kind kind) const { return m_counts[kind]; }
+    void reset();
+    QJsonObject toJson() const;
+    static QString logFilePath();
+    static QString kindName(Kind kind);
+
+signals:
+    void glitchRecorded();
+
+private:
+    QString currentLoad() const;
+    void appendToLog(const Event &event) const;
+
+    std::function<QString()> m_loadProbe;
+    QList<Event> m_events;
+    quint64 m_counts[KindCount];
+    int m_trackId;
+    QString m_filePath;
+    bool m_playing;
+    QElapsedTimer m_sinceUpdate;
+};
+
+#endif
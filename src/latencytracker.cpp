@@ -0,0 +1,169 @@
+#include "latencytracker.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+static const double kFirstBucketMs = 0.05;
+static const double kBucketGrowth = 1.1;
+
+LatencyTracker::Histogram::Histogram()
+    : m_count(0)
+    , m_sum(0.0)
+    , m_minimum(0.0)
+    , m_maximum(0.0)
+{
+    std::memset(m_buckets, 0, sizeof(m_buckets));
+}
+
+int LatencyTracker::Histogram::bucketFor(double milliseconds)
+{
+    if (milliseconds <= kFirstBucketMs) {
+        return 0;
+    }
+    int bucket = static_cast<int>(std::log(milliseconds / kFirstBucketMs) / std::log(kBucketGrowth));
+    return qBound(0, bucket, BucketCount - 1);
+}
+
+double LatencyTracker::Histogram::bucketLower(int bucket)
+{
+    return kFirstBucketMs * std::pow(kBucketGrowth, bucket);
+}
+
+void LatencyTracker::Histogram::add(double milliseconds)
+{
+    milliseconds = qMax(0.0, milliseconds);
+    ++m_buckets[bucketFor(milliseconds)];
+    m_minimum = m_count ? qMin(m_minimum, milliseconds) : milliseconds;
+    m_maximum = m_count ? qMax(m_maximum, milliseconds) : milliseconds;
+    m_sum += milliseconds;
+    ++m_count;
+}
+
+double LatencyTracker::Histogram::percentile(double fraction) const
+{
+    if (m_count == 0) {
+        return 0.0;
+    }
+    const double rank = fraction * m_count;
+    quint64 seen = 0;
+    for (int bucket = 0; bucket < BucketCount; ++bucket) {
+        if (m_buckets[bucket] == 0) {
+            continue;
+        }
+        if (seen + m_buckets[bucket] >= rank) {
+            // Interpolate geometrically inside the bucket.
+            double within = (rank - seen) / m_buckets[bucket];
+            double value = bucketLower(bucket) * std::pow(kBucketGrowth, within);
+            return qBound(m_minimum, value, m_maximum);
+        }
+        seen += m_buckets[bucket];
+    }
+    return m_maximum;
+}
+
+LatencyTracker::LatencyTracker(QObject *parent)
+    : QObject(parent)
+    , m_active(false)
+    , m_kind(TrackStart)
+    , m_start(0)
+    , m_recorded(0)
+{
+}
+
+qint64 LatencyTracker::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LatencyTracker::begin(SpanKind kind, qint64 timestamp)
+{
+    m_active = true;
+    m_kind = kind;
+    m_start = timestamp;
+    m_recorded = 0;
+}
+
+void LatencyTracker::mark(Stage stage, qint64 timestamp)
+{
+    if (!m_active || (m_recorded & (1 << stage)) || timestamp < m_start) {
+        return;
+    }
+    m_recorded |= 1 << stage;
+    m_histograms[m_kind][stage].add((timestamp - m_start) / 1e6);
+    if (stage == FirstAudio) {
+        m_active = false;
+        emit spanFinished();
+    }
+}
+
+void LatencyTracker::cancel()
+{
+    m_active = false;
+}
+
+void LatencyTracker::reset()
+{
+    m_active = false;
+    for (int kind = 0; kind < SpanKindCount; ++kind) {
+        for (int stage = 0; stage < StageCount; ++stage) {
+            m_histograms[kind][stage] = Histogram();
+        }
+    }
+}
+
+QList<LatencyTracker::Summary> LatencyTracker::summaries() const
+{
+    QList<Summary> result;
+    for (int kind = 0; kind < SpanKindCount; ++kind) {
+        for (int stage = 0; stage < StageCount; ++stage) {
+            const Histogram &histogram = m_histograms[kind][stage];
+            result << Summary{static_cast<SpanKind>(kind), static_cast<Stage>(stage), histogram.count(),
+                              histogram.minimum(), histogram.mean(), histogram.percentile(0.50),
+                              histogram.percentile(0.95), histogram.percentile(0.99), histogram.maximum()};
+        }
+    }
+    return result;
+}
+
+QJsonObject LatencyTracker::toJson() const
+{
+    QJsonObject spans;
+    for (const Summary &summary : summaries()) {
+        QJsonObject stage;
+        stage["count"] = static_cast<qint64>(summary.count);
+        stage["minMs"] = summary.minimum;
+        stage["meanMs"] = summary.mean;
+        stage["p50Ms"] = summary.p50;
+        stage["p95Ms"] = summary.p95;
+        stage["p99Ms"] = summary.p99;
+        stage["maxMs"] = summary.maximum;
+        QJsonObject kind = spans.value(kindName(summary.kind)).toObject();
+        kind[stageName(summary.stage)] = stage;
+        spans[kindName(summary.kind)] = kind;
+    }
+    QJsonObject root;
+    root["spans"] = spans;
+    return root;
+}
+
+QString LatencyTracker::kindName(SpanKind kind)
+{
+    return kind == TrackStart ? "trackStart" : "transition";
+}
+
+QString LatencyTracker::stageName(Stage stage)
+{
+    switch (stage) {
+    case SetTrack:
+        return "setTrack";
+    case MediaLoaded:
+        return "loadedMedia";
+    case Playing:
+        return "playingState";
+    case FirstAudio:
+        return "firstAudio";
+    default:
+        return QString();
+    }
+}
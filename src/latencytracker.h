@@ -0,0 +1,96 @@
+#ifndef LATENCYTRACKER_H
+#define LATENCYTRACKER_H
+
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+// Times the stages of starting a track on the monotonic clock. A span opens
+// when playback is requested and every stage records the time since then
+// into a log-bucketed histogram, from which percentiles are read.
+class LatencyTracker : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum SpanKind {
+        TrackStart,     // user asked for a track
+        Transition,     // automatic advance after the previous track stopped
+        SpanKindCount
+    };
+    enum Stage {
+        SetTrack,
+        MediaLoaded,
+        Playing,
+        FirstAudio,
+        StageCount
+    };
+
+    struct Summary {
+        SpanKind kind;
+        Stage stage;
+        quint64 count;
+        double minimum;
+        double mean;
+        double p50;
+        double p95;
+        double p99;
+        double maximum;
+    };
+
+    explicit LatencyTracker(QObject *parent = nullptr);
+
+    // Monotonic timestamp in nanoseconds, also usable from other threads.
+    static qint64 now();
+
+    void begin(SpanKind kind, qint64 timestamp = now());
+    void mark(Stage stage, qint64 timestamp = now());
+    void cancel();
+    bool isActive() const { return m_active; }
+    bool isPending(Stage stage) const { return m_active && !(m_recorded & (1 << stage)); }
+    void reset();
+
+    QList<Summary> summaries() const;
+    QJsonObject toJson() const;
+
+    static QString kindName(SpanKind kind);
+    static QString stageName(Stage stage);
+
+signals:
+    void spanFinished();
+
+private:
+    class Histogram
+    {
+    public:
+        // 0.05 ms to a few minutes in 10% steps.
+        static const int BucketCount = 160;
+
+        Histogram();
+        void add(double milliseconds);
+        quint64 count() const { return m_count; }
+        double percentile(double fraction) const;
+        double minimum() const { return m_minimum; }
+        double maximum() const { return m_maximum; }
+        double mean() const { return m_count ? m_sum / m_count : 0.0; }
+
+    private:
+        static int bucketFor(double milliseconds);
+        static double bucketLower(int bucket);
+
+        quint64 m_buckets[BucketCount];
+        quint64 m_count;
+        double m_sum;
+        double m_minimum;
+        double m_maximum;
+    };
+
+    Histogram m_histograms[SpanKindCount][StageCount];
+    bool m_active;
+    SpanKind m_kind;
+    qint64 m_start;
+    int m_recorded;
+};
+
+#endif
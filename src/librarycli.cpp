@@ -0,0 +1,453 @@
+#include "librarycli.h"
+#include "backgroundscheduler.h"
+#include "libraryimporter.h"
+#include "peakextractor.h"
+#include "trackanalyzer.h"
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <QSet>
+#include <cstdio>
+#include <vector>
+
+static const char *kUsage =
+    "Использование: AudioPlayerCli <команда> [параметры]\n"
+    "\n"
+    "Команды:\n"
+    "  import [-r] <файл|папка>...        добавить файлы в библиотеку\n"
+    "  rescan [--prune] [-r] [папка]...   найти пропавшие, изменённые и новые файлы\n"
+    "  convert [-o папка] [--import] <файл|папка>...  MP4 в MP3\n"
+    "  analyze                            громкость, тишина и волна для новых треков\n"
+    "  stats                              сводка по библиотеке\n"
+    "  export [--format json|csv|m3u] [--playlist id|имя] [-o файл]\n"
+    "\n"
+    "Результаты выводятся построчно в JSON, последней строкой идёт \"summary\".\n";
+
+// Runs function(index) for every index in the scheduler's pool of the given
+// class, `chunk` indexes per job, and waits for all of them.
+template <typename Function>
+static void runParallel(int count, int chunk, BackgroundScheduler::JobClass jobClass, const Function &function)
+{
+    const int jobs = (count + chunk - 1) / chunk;
+    QSemaphore done;
+    for (int job = 0; job < jobs; ++job) {
+        BackgroundScheduler::instance()->start(jobClass, [&function, &done, job, chunk, count]() {
+            const int end = qMin(count, (job + 1) * chunk);
+            for (int index = job * chunk; index < end; ++index) {
+                function(index);
+            }
+            done.release();
+        });
+    }
+    done.acquire(jobs);
+}
+
+static QString csvField(const QString &value)
+{
+    if (!value.contains(',') && !value.contains('"') && !value.contains('\n')) {
+        return value;
+    }
+    return '"' + QString(value).replace("\"", "\"\"") + '"';
+}
+
+static QJsonObject trackToJson(const TrackInfo &track)
+{
+    QJsonObject object;
+    object["id"] = track.id;
+    object["file"] = track.filePath;
+    object["title"] = track.title;
+    object["artist"] = track.artist;
+    object["album"] = track.album;
+    object["duration"] = track.duration;
+    object["tags"] = QJsonArray::fromStringList(track.tags);
+    object["playCount"] = track.playCount;
+    object["lastPlayed"] = track.lastPlayed.isValid() ? track.lastPlayed.toString(Qt::ISODate) : QString();
+    if (track.hasTrackGain) {
+        object["trackGain"] = track.trackGain;
+        object["trackPeak"] = track.trackPeak;
+    }
+    if (track.hasAlbumGain) {
+        object["albumGain"] = track.albumGain;
+        object["albumPeak"] = track.albumPeak;
+    }
+    if (track.hasAudioRange()) {
+        object["audioStart"] = track.audioStart;
+        object["audioEnd"] = track.audioEnd;
+    }
+    object["playbackRate"] = track.playbackRate;
+    return object;
+}
+
+LibraryCli::LibraryCli(DatabaseManager *dbManager)
+    : m_dbManager(dbManager)
+    , m_out(stdout)
+    , m_err(stderr)
+{
+}
+
+int LibraryCli::run(const QStringList &arguments)
+{
+    const QString command = arguments.value(1);
+    // The parser of each command sees the program name and its own options.
+    const QStringList rest = QStringList{arguments.value(0)} + arguments.mid(2);
+    if (command == "import") {
+        return runImport(rest);
+    } else if (command == "rescan") {
+        return runRescan(rest);
+    } else if (command == "convert") {
+        return runConvert(rest);
+    } else if (command == "analyze") {
+        return runAnalyze(rest);
+    } else if (command == "stats") {
+        return runStats(rest);
+    } else if (command == "export") {
+        return runExport(rest);
+    } else if (command == "help" || command == "-h" || command == "--help") {
+        m_out << kUsage;
+        m_out.flush();
+        return 0;
+    }
+    return usage(command.isEmpty() ? QString("Не указана команда") : QString("Неизвестная команда: %1").arg(command));
+}
+
+int LibraryCli::usage(const QString &message)
+{
+    m_err << message << "\n\n" << kUsage;
+    m_err.flush();
+    return 2;
+}
+
+void LibraryCli::emitRecord(const QJsonObject &record)
+{
+    QMutexLocker locker(&m_outputMutex);
+    m_out << QJsonDocument(record).toJson(QJsonDocument::Compact) << '\n';
+    m_out.flush();
+}
+
+QStringList LibraryCli::expandPaths(const QStringList &paths, bool recursive)
+{
+    QStringList files;
+    for (const QString &path : paths) {
+        QFileInfo info(path);
+        if (info.isDir()) {
+            files << LibraryImporter::collectFiles(info.absoluteFilePath(), recursive);
+        } else if (info.isFile()) {
+            files << info.absoluteFilePath();
+        } else {
+            emitRecord({{"event", "error"}, {"source", path}, {"error", "Файл не найден"}});
+        }
+    }
+    return files;
+}
+
+int LibraryCli::runImport(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    QCommandLineOption recursiveOption({"r", "recursive"}, "Обходить вложенные папки.");
+    parser.addOption(recursiveOption);
+    if (!parser.parse(arguments)) {
+        return usage(parser.errorText());
+    }
+    if (parser.positionalArguments().isEmpty()) {
+        return usage("Не указаны файлы или папки для импорта");
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const QStringList files = expandPaths(parser.positionalArguments(), parser.isSet(recursiveOption));
+    LibraryImporter importer(m_dbManager);
+    const QList<LibraryImporter::Result> results = importer.import(files);
+    int added = 0;
+    int converted = 0;
+    int failed = 0;
+    for (const LibraryImporter::Result &result : results) {
+        QJsonObject record{{"event", "import"}, {"source", result.sourcePath}, {"file", result.filePath},
+                           {"trackId", result.trackId}, {"converted", result.converted}};
+        if (result.trackId >= 0) {
+            ++added;
+            converted += result.converted ? 1 : 0;
+        } else {
+            ++failed;
+            record["error"] = result.error;
+        }
+        emitRecord(record);
+    }
+    emitRecord({{"event", "summary"}, {"command", "import"}, {"files", files.size()}, {"added", added},
+                {"converted", converted}, {"failed", failed}, {"elapsedMs", timer.elapsed()}});
+    return failed > 0 ? 1 : 0;
+}
+
+int LibraryCli::runRescan(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    QCommandLineOption pruneOption("prune", "Удалить из библиотеки треки, файлов которых больше нет.");
+    QCommandLineOption recursiveOption({"r", "recursive"}, "Обходить вложенные папки.");
+    parser.addOption(pruneOption);
+    parser.addOption(recursiveOption);
+    if (!parser.parse(arguments)) {
+        return usage(parser.errorText());
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const QList<TrackFileInfo> files = m_dbManager->getTrackFiles();
+    // Stat calls are I/O bound and run in parallel; the database stays on
+    // this thread.
+    std::vector<QString> fingerprints(files.size());
+    runParallel(files.size(), 256, BackgroundScheduler::Normal, [&files, &fingerprints](int index) {
+        fingerprints[index] = DatabaseManager::fileFingerprint(files[index].filePath);
+    });
+
+    int missing = 0;
+    int removed = 0;
+    int changed = 0;
+    QSet<QString> known;
+    for (int index = 0; index < files.size(); ++index) {
+        const TrackFileInfo &file = files[index];
+        known.insert(file.filePath);
+        if (fingerprints[index].isEmpty()) {
+            ++missing;
+            const bool prune = parser.isSet(pruneOption) && m_dbManager->deleteTrack(file.id);
+            removed += prune ? 1 : 0;
+            emitRecord({{"event", "missing"}, {"trackId", file.id}, {"file", file.filePath}, {"removed", prune}});
+        } else if (!file.fingerprint.isEmpty() && file.fingerprint != fingerprints[index]) {
+            // Tags are read again on the next play; analyze picks it up.
+            ++changed;
+            m_dbManager->resetTrackAnalysis(file.id);
+            QFile::remove(PeakExtractor::peakFilePath(file.id));
+            emitRecord({{"event", "changed"}, {"trackId", file.id}, {"file", file.filePath}});
+        }
+    }
+
+    QStringList newFiles;
+    for (const QString &path : expandPaths(parser.positionalArguments(), parser.isSet(recursiveOption))) {
+        if (!known.contains(path)) {
+            newFiles << path;
+        }
+    }
+    int added = 0;
+    int failed = 0;
+    LibraryImporter importer(m_dbManager);
+    for (const LibraryImporter::Result &result : importer.import(newFiles)) {
+        QJsonObject record{{"event", "added"}, {"source", result.sourcePath}, {"file", result.filePath},
+                           {"trackId", result.trackId}};
+        if (result.trackId >= 0) {
+            ++added;
+        } else {
+            ++failed;
+            record["error"] = result.error;
+        }
+        emitRecord(record);
+    }
+    emitRecord({{"event", "summary"}, {"command", "rescan"}, {"tracks", files.size()}, {"missing", missing},
+                {"removed", removed}, {"changed", changed}, {"added", added}, {"failed", failed},
+                {"elapsedMs", timer.elapsed()}});
+    return failed > 0 ? 1 : 0;
+}
+
+int LibraryCli::runConvert(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    QCommandLineOption outputOption({"o", "output"}, "Папка для MP3.", "папка");
+    QCommandLineOption importOption("import", "Добавить результат в библиотеку.");
+    QCommandLineOption recursiveOption({"r", "recursive"}, "Обходить вложенные папки.");
+    parser.addOption(outputOption);
+    parser.addOption(importOption);
+    parser.addOption(recursiveOption);
+    if (!parser.parse(arguments)) {
+        return usage(parser.errorText());
+    }
+    if (parser.positionalArguments().isEmpty()) {
+        return usage("Не указаны файлы для конвертации");
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QStringList sources;
+    for (const QString &file : expandPaths(parser.positionalArguments(), parser.isSet(recursiveOption))) {
+        if (LibraryImporter::needsConversion(file)) {
+            sources << file;
+        }
+    }
+    const QString outputDir = parser.isSet(outputOption)
+        ? QFileInfo(parser.value(outputOption)).absoluteFilePath() : LibraryImporter::convertedDirectory();
+    std::vector<QString> outputs(sources.size());
+    runParallel(sources.size(), 1, BackgroundScheduler::Bulk, [this, &sources, &outputs, &outputDir](int index) {
+        QString error;
+        outputs[index] = LibraryImporter::convertToMp3(sources[index], outputDir, &error);
+        QJsonObject record{{"event", "convert"}, {"source", sources[index]}, {"file", outputs[index]}};
+        if (outputs[index].isEmpty()) {
+            record["error"] = error;
+        }
+        emitRecord(record);
+    });
+
+    QStringList converted;
+    for (const QString &output : outputs) {
+        if (!output.isEmpty()) {
+            converted << output;
+        }
+    }
+    int added = 0;
+    if (parser.isSet(importOption)) {
+        const QList<int> ids = m_dbManager->addTracks(converted);
+        for (int index = 0; index < converted.size(); ++index) {
+            added += ids.value(index, -1) >= 0 ? 1 : 0;
+            emitRecord({{"event", "import"}, {"file", converted[index]}, {"trackId", ids.value(index, -1)}});
+        }
+    }
+    const int failed = sources.size() - converted.size();
+    emitRecord({{"event", "summary"}, {"command", "convert"}, {"files", sources.size()},
+                {"converted", converted.size()}, {"added", added}, {"failed", failed},
+                {"elapsedMs", timer.elapsed()}});
+    return failed > 0 ? 1 : 0;
+}
+
+int LibraryCli::runAnalyze(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    if (!parser.parse(arguments)) {
+        return usage(parser.errorText());
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const QList<TrackInfo> tracks = m_dbManager->getTracksPendingLoudness();
+    TrackAnalyzer analyzer(m_dbManager);
+    QSet<int> analysed;
+    QEventLoop loop;
+    // Album gain reports every album track again once the album is done.
+    QObject::connect(&analyzer, &TrackAnalyzer::trackAnalyzed, &loop, [this, &analysed](int trackId) {
+        if (analysed.contains(trackId)) {
+            return;
+        }
+        analysed.insert(trackId);
+        const TrackInfo track = m_dbManager->getTrack(trackId);
+        QJsonObject record{{"event", "analyzed"}, {"trackId", trackId}, {"file", track.filePath},
+                           {"trackGain", track.trackGain}, {"trackPeak", track.trackPeak}};
+        if (track.hasAudioRange()) {
+            record["audioStart"] = track.audioStart;
+            record["audioEnd"] = track.audioEnd;
+        }
+        emitRecord(record);
+    });
+    QObject::connect(&analyzer, &TrackAnalyzer::finished, &loop, &QEventLoop::quit);
+    if (!tracks.isEmpty()) {
+        analyzer.analyze(tracks);
+        loop.exec();
+    }
+    const int failed = tracks.size() - analysed.size();
+    emitRecord({{"event", "summary"}, {"command", "analyze"}, {"tracks", tracks.size()},
+                {"analyzed", analysed.size()}, {"failed", failed}, {"elapsedMs", timer.elapsed()}});
+    return failed > 0 ? 1 : 0;
+}
+
+int LibraryCli::runStats(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    if (!parser.parse(arguments)) {
+        return usage(parser.errorText());
+    }
+    QJsonObject record = QJsonObject::fromVariantMap(m_dbManager->getLibraryStats());
+    record["event"] = "summary";
+    record["command"] = "stats";
+    emitRecord(record);
+    return 0;
+}
+
+int LibraryCli::runExport(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    QCommandLineOption formatOption("format", "json (по умолчанию), csv или m3u.", "формат", "json");
+    QCommandLineOption playlistOption("playlist", "Только треки плейлиста.", "id|имя");
+    QCommandLineOption outputOption({"o", "output"}, "Записать в файл вместо stdout.", "файл");
+    parser.addOption(formatOption);
+    parser.addOption(playlistOption);
+    parser.addOption(outputOption);
+    if (!parser.parse(arguments)) {
+        return usage(parser.errorText());
+    }
+    const QString format = parser.value(formatOption);
+    if (format != "json" && format != "csv" && format != "m3u") {
+        return usage(QString("Неизвестный формат: %1").arg(format));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QList<TrackInfo> tracks;
+    if (parser.isSet(playlistOption)) {
+        const QString wanted = parser.value(playlistOption);
+        int playlistId = -1;
+        for (const PlaylistInfo &playlist : m_dbManager->getAllPlaylists()) {
+            if (QString::number(playlist.id) == wanted || playlist.name == wanted) {
+                playlistId = playlist.id;
+                break;
+            }
+        }
+        if (playlistId < 0) {
+            m_err << "Плейлист не найден: " << wanted << '\n';
+            m_err.flush();
+            return 1;
+        }
+        tracks = m_dbManager->getPlaylistTracks(playlistId);
+    } else {
+        tracks = m_dbManager->getAllTracks();
+    }
+
+    QFile file;
+    QTextStream fileStream;
+    const bool toFile = parser.isSet(outputOption);
+    if (toFile) {
+        file.setFileName(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            m_err << "Не удалось открыть файл: " << file.fileName() << '\n';
+            m_err.flush();
+            return 1;
+        }
+        fileStream.setDevice(&file);
+    }
+    QTextStream &stream = toFile ? fileStream : m_out;
+
+    if (format == "json") {
+        for (const TrackInfo &track : tracks) {
+            QJsonObject record = trackToJson(track);
+            if (toFile) {
+                stream << QJsonDocument(record).toJson(QJsonDocument::Compact) << '\n';
+            } else {
+                record["event"] = "track";
+                emitRecord(record);
+            }
+        }
+    } else if (format == "csv") {
+        stream << "id,file,title,artist,album,duration,tags,play_count,last_played\n";
+        for (const TrackInfo &track : tracks) {
+            stream << track.id << ',' << csvField(track.filePath) << ',' << csvField(track.title) << ','
+                   << csvField(track.artist) << ',' << csvField(track.album) << ',' << track.duration << ','
+                   << csvField(track.tags.join(';')) << ',' << track.playCount << ','
+                   << (track.lastPlayed.isValid() ? track.lastPlayed.toString(Qt::ISODate) : QString()) << '\n';
+        }
+    } else {
+        stream << "#EXTM3U\n";
+        for (const TrackInfo &track : tracks) {
+            const QString title = track.title.isEmpty() ? QFileInfo(track.filePath).completeBaseName() : track.title;
+            stream << "#EXTINF:" << track.duration << ','
+                   << (track.artist.isEmpty() ? title : track.artist + " - " + title) << '\n'
+                   << track.filePath << '\n';
+        }
+    }
+    stream.flush();
+    // CSV and M3U on stdout are the output itself; no records around them.
+    if (toFile || format == "json") {
+        emitRecord({{"event", "summary"}, {"command", "export"}, {"format", format}, {"tracks", tracks.size()},
+                    {"file", toFile ? QFileInfo(file).absoluteFilePath() : QString()},
+                    {"elapsedMs", timer.elapsed()}});
+    }
+    return 0;
+}
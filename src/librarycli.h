@@ -0,0 +1,41 @@
+#ifndef LIBRARYCLI_H
+#define LIBRARYCLI_H
+
+#include <QJsonObject>
+#include <QMutex>
+#include <QStringList>
+#include <QTextStream>
+#include "databasemanager.h"
+
+// Library maintenance from the command line: import, rescan, convert,
+// analyze, stats and export against the same database as the player.
+// Every result is one JSON object per line on stdout, ending with a
+// "summary" record; diagnostics go to stderr. Exit codes: 0 success,
+// 1 some items failed, 2 bad usage.
+class LibraryCli
+{
+public:
+    explicit LibraryCli(DatabaseManager *dbManager);
+
+    int run(const QStringList &arguments);
+
+private:
+    int runImport(const QStringList &arguments);
+    int runRescan(const QStringList &arguments);
+    int runConvert(const QStringList &arguments);
+    int runAnalyze(const QStringList &arguments);
+    int runStats(const QStringList &arguments);
+    int runExport(const QStringList &arguments);
+
+    QStringList expandPaths(const QStringList &paths, bool recursive);
+    // Thread-safe; conversions report from the pool.
+    void emitRecord(const QJsonObject &record);
+    int usage(const QString &message);
+
+    DatabaseManager *m_dbManager;
+    QMutex m_outputMutex;
+    QTextStream m_out;
+    QTextStream m_err;
+};
+
+#endif
@@ -0,0 +1,272 @@
+#include "libraryimporter.h"
+#include "backgroundscheduler.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QProcess>
+#include <QSemaphore>
+#include <QStandardPaths>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+static const int kConversionTimeoutMs = 300000;
+
+namespace {
+
+// Shared with the conversion jobs, which may outlive a cancelled wait.
+struct Conversions {
+    QMutex mutex;
+    QList<int> finished;
+    std::vector<QString> outputs;
+    std::vector<QString> errors;
+    QSemaphore ready;
+    std::atomic<bool> cancelled{false};
+    QElapsedTimer clock;
+    qint64 firstStart = -1;
+    qint64 lastFinish = 0;
+    qint64 busyMs = 0;
+};
+
+}
+
+LibraryImporter::LibraryImporter(DatabaseManager *dbManager)
+    : m_dbManager(dbManager)
+{
+}
+
+QList<LibraryImporter::Result> LibraryImporter::import(const QStringList &files, const Progress &progress)
+{
+    m_timing = Timing();
+    QElapsedTimer insertTimer;
+    QList<Result> results;
+    results.reserve(files.size());
+    QList<int> direct;
+    QList<int> converting;
+    for (int index = 0; index < files.size(); ++index) {
+        Result result;
+        result.sourcePath = files[index];
+        result.filePath = files[index];
+        results << result;
+        if (needsConversion(files[index])) {
+            converting << index;
+        } else {
+            direct << index;
+        }
+    }
+
+    const int total = files.size();
+    int done = 0;
+    bool keepGoing = true;
+    auto report = [&]() {
+        if (progress && keepGoing && !progress(done, total)) {
+            keepGoing = false;
+        }
+    };
+
+    // Conversions start first so ffmpeg runs while plain files are inserted.
+    auto conversions = std::make_shared<Conversions>();
+    conversions->outputs.resize(files.size());
+    conversions->errors.resize(files.size());
+    conversions->clock.start();
+    const QString outputDir = m_outputDirectory.isEmpty() ? convertedDirectory() : m_outputDirectory;
+    for (int index : converting) {
+        const QString source = files[index];
+        BackgroundScheduler::instance()->start(BackgroundScheduler::Bulk, [conversions, index, source, outputDir]() {
+            QString output;
+            QString error = "Отменено";
+            const qint64 started = conversions->clock.elapsed();
+            if (!conversions->cancelled.load(std::memory_order_relaxed)) {
+                output = convertToMp3(source, outputDir, &error);
+            }
+            const qint64 finished = conversions->clock.elapsed();
+            {
+                QMutexLocker locker(&conversions->mutex);
+                if (conversions->firstStart < 0 || started < conversions->firstStart) {
+                    conversions->firstStart = started;
+                }
+                conversions->lastFinish = std::max(conversions->lastFinish, finished);
+                conversions->busyMs += finished - started;
+                conversions->outputs[index] = output;
+                conversions->errors[index] = error;
+                conversions->finished << index;
+            }
+            conversions->ready.release();
+        });
+    }
+
+    int collected = 0;
+    auto collect = [&](int timeoutMs) {
+        if (!conversions->ready.tryAcquire(1, timeoutMs)) {
+            return false;
+        }
+        int index;
+        QString output;
+        QString error;
+        {
+            QMutexLocker locker(&conversions->mutex);
+            index = conversions->finished.takeFirst();
+            output = conversions->outputs[index];
+            error = conversions->errors[index];
+        }
+        ++collected;
+        ++done;
+        Result &result = results[index];
+        if (output.isEmpty()) {
+            result.error = error;
+            return true;
+        }
+        result.filePath = output;
+        result.converted = true;
+        ++m_timing.converted;
+        insertTimer.start();
+        result.trackId = m_dbManager->addTrack(output);
+        m_timing.insertMs += insertTimer.elapsed();
+        ++m_timing.inserted;
+        if (result.trackId < 0) {
+            result.error = "Не удалось добавить трек в базу данных";
+        }
+        return true;
+    };
+
+    for (int start = 0; start < direct.size() && keepGoing; start += BatchSize) {
+        QStringList batch;
+        const int end = qMin(start + BatchSize, static_cast<int>(direct.size()));
+        for (int position = start; position < end; ++position) {
+            batch << files[direct[position]];
+        }
+        insertTimer.start();
+        const QList<int> ids = m_dbManager->addTracks(batch);
+        m_timing.insertMs += insertTimer.elapsed();
+        m_timing.inserted += batch.size();
+        for (int position = start; position < end; ++position) {
+            Result &result = results[direct[position]];
+            result.trackId = ids.value(position - start, -1);
+            if (result.trackId < 0) {
+                result.error = "Не удалось добавить трек в базу данных";
+            }
+        }
+        done += end - start;
+        while (collect(0)) {
+        }
+        report();
+    }
+    if (!keepGoing) {
+        for (int index : direct) {
+            if (results[index].trackId < 0 && results[index].error.isEmpty()) {
+                results[index].error = "Отменено";
+            }
+        }
+    }
+
+    while (collected < converting.size()) {
+        if (!keepGoing) {
+            conversions->cancelled.store(true, std::memory_order_relaxed);
+        }
+        collect(ProgressIntervalMs);
+        report();
+    }
+    {
+        QMutexLocker locker(&conversions->mutex);
+        if (conversions->firstStart >= 0) {
+            m_timing.conversionWallMs = conversions->lastFinish - conversions->firstStart;
+        }
+        m_timing.conversionBusyMs = conversions->busyMs;
+    }
+    return results;
+}
+
+QStringList LibraryImporter::nameFilters()
+{
+    return {"*.mp3", "*.wav", "*.flac", "*.ogg", "*.m4a", "*.aac", "*.wma", "*.mp4", "*.m4v"};
+}
+
+bool LibraryImporter::isSupported(const QString &filePath)
+{
+    const QString suffix = "*." + QFileInfo(filePath).suffix().toLower();
+    return nameFilters().contains(suffix);
+}
+
+bool LibraryImporter::needsConversion(const QString &filePath)
+{
+    return filePath.endsWith(".mp4", Qt::CaseInsensitive) || filePath.endsWith(".m4v", Qt::CaseInsensitive);
+}
+
+QStringList LibraryImporter::collectFiles(const QString &folder, bool recursive)
+{
+    QStringList files;
+    QDirIterator it(folder, nameFilters(), QDir::Files,
+                    recursive ? QDirIterator::Subdirectories | QDirIterator::FollowSymlinks
+                              : QDirIterator::NoIteratorFlags);
+    while (it.hasNext()) {
+        files << QFileInfo(it.next()).absoluteFilePath();
+    }
+    files.sort();
+    return files;
+}
+
+QString LibraryImporter::convertedDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::MusicLocation) + "/Converted";
+}
+
+QString LibraryImporter::convertToMp3(const QString &sourcePath, const QString &outputDir, QString *error)
+{
+    QFileInfo fileInfo(sourcePath);
+    const QString directory = outputDir.isEmpty() ? convertedDirectory() : outputDir;
+    QDir().mkpath(directory);
+
+    // Creating the file claims the name, so parallel conversions of equally
+    // named files do not pick the same one.
+    QString mp3Path;
+    for (int counter = 0; ; ++counter) {
+        mp3Path = directory + "/" + fileInfo.baseName()
+            + (counter > 0 ? "_" + QString::number(counter) : QString()) + ".mp3";
+        QFile claim(mp3Path);
+        if (claim.open(QIODevice::WriteOnly | QIODevice::NewOnly)) {
+            break;
+        }
+        if (!claim.exists()) {
+            if (error) {
+                *error = QString("Не удалось создать файл %1").arg(mp3Path);
+            }
+            return QString();
+        }
+    }
+
+    QProcess process;
+    QStringList arguments;
+    arguments << "-i" << sourcePath
+              << "-vn"
+              << "-acodec" << "libmp3lame"
+              << "-ab" << "192k"
+              << "-ar" << "44100"
+              << "-y"
+              << mp3Path;
+    BackgroundScheduler::instance()->prepareProcess(&process, BackgroundScheduler::Bulk);
+    process.start("ffmpeg", arguments);
+    if (!process.waitForStarted()) {
+        QFile::remove(mp3Path);
+        if (error) {
+            *error = "Не удалось запустить ffmpeg";
+        }
+        return QString();
+    }
+    if (!process.waitForFinished(kConversionTimeoutMs) || process.exitStatus() != QProcess::NormalExit
+        || process.exitCode() != 0) {
+        process.kill();
+        process.waitForFinished();
+        QFile::remove(mp3Path);
+        if (error) {
+            const QStringList lines = QString::fromLocal8Bit(process.readAllStandardError()).trimmed().split('\n');
+            *error = QString("Ошибка конвертации: %1").arg(lines.last().trimmed());
+        }
+        return QString();
+    }
+    return mp3Path;
+}
@@ -0,0 +1,66 @@
+#ifndef LIBRARYIMPORTER_H
+#define LIBRARYIMPORTER_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <functional>
+#include "databasemanager.h"
+
+// Adds files to the library without any UI, for the main window and the
+// command line tool alike. MP4 video is converted to MP3 with ffmpeg first;
+// conversions run in parallel as Bulk work of the BackgroundScheduler while
+// the database is written from the calling thread, in batches of one
+// transaction each.
+class LibraryImporter
+{
+public:
+    struct Result {
+        QString sourcePath;
+        QString filePath;       // what went into the library
+        int trackId = -1;
+        bool converted = false;
+        QString error;
+    };
+
+    // Called after every batch or finished conversion and at least every
+    // ProgressIntervalMs while waiting; returning false stops the import
+    // once the running conversions are done.
+    using Progress = std::function<bool(int done, int total)>;
+
+    // Where the time of the last import() went. Conversions overlap each
+    // other and the inserts, so their wall time and their summed time differ.
+    struct Timing {
+        qint64 insertMs = 0;
+        int inserted = 0;
+        qint64 conversionWallMs = 0;
+        qint64 conversionBusyMs = 0;
+        int converted = 0;
+    };
+
+    static const int BatchSize = 500;
+    static const int ProgressIntervalMs = 100;
+
+    explicit LibraryImporter(DatabaseManager *dbManager);
+
+    QList<Result> import(const QStringList &files, const Progress &progress = Progress());
+    // Where converted files go; convertedDirectory() unless set.
+    void setOutputDirectory(const QString &directory) { m_outputDirectory = directory; }
+    const Timing &lastTiming() const { return m_timing; }
+
+    static QStringList nameFilters();
+    static bool isSupported(const QString &filePath);
+    static bool needsConversion(const QString &filePath);
+    static QStringList collectFiles(const QString &folder, bool recursive);
+    static QString convertedDirectory();
+    // Returns the MP3 path, or an empty string with `error` set.
+    static QString convertToMp3(const QString &sourcePath, const QString &outputDir = QString(),
+                                QString *error = nullptr);
+
+private:
+    DatabaseManager *m_dbManager;
+    QString m_outputDirectory;
+    Timing m_timing;
+};
+
+#endif
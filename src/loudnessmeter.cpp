@@ -0,0 +1,263 @@
+#include "loudnessmeter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LOUDNESS_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+static const double kPi = 3.14159265358979323846;
+
+LoudnessMeter::LoudnessMeter()
+    : m_sampleRate(0)
+    , m_segmentFrames(0)
+    , m_segmentFill(0)
+    , m_segmentCount(0)
+    , m_totalEnergy(0.0)
+    , m_totalFrames(0)
+    , m_historyPos(0)
+    , m_truePeak(0.0)
+{
+    std::memset(m_stages, 0, sizeof(m_stages));
+    std::memset(m_state, 0, sizeof(m_state));
+    std::memset(m_segmentEnergy, 0, sizeof(m_segmentEnergy));
+    std::memset(m_segments, 0, sizeof(m_segments));
+    std::memset(m_phases, 0, sizeof(m_phases));
+    std::memset(m_history, 0, sizeof(m_history));
+}
+
+void LoudnessMeter::prepare(int sampleRate)
+{
+    m_sampleRate = sampleRate;
+    m_segmentFrames = std::max(1, sampleRate / 10);
+    m_segmentFill = 0;
+    m_segmentCount = 0;
+    m_totalEnergy = 0.0;
+    m_totalFrames = 0;
+    m_blocks.clear();
+    m_historyPos = 0;
+    m_truePeak = 0.0;
+    std::memset(m_state, 0, sizeof(m_state));
+    std::memset(m_segmentEnergy, 0, sizeof(m_segmentEnergy));
+    std::memset(m_history, 0, sizeof(m_history));
+
+    // BS.1770 pre-filter (high shelf) and RLB high-pass, derived for the
+    // actual sample rate rather than the tabulated 48 kHz coefficients.
+    double f0 = 1681.974450955533;
+    double gain = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = std::tan(kPi * f0 / sampleRate);
+    double vh = std::pow(10.0, gain / 20.0);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    m_stages[0].b0 = (vh + vb * k / q + k * k) / a0;
+    m_stages[0].b1 = 2.0 * (k * k - vh) / a0;
+    m_stages[0].b2 = (vh - vb * k / q + k * k) / a0;
+    m_stages[0].a1 = 2.0 * (k * k - 1.0) / a0;
+    m_stages[0].a2 = (1.0 - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = std::tan(kPi * f0 / sampleRate);
+    a0 = 1.0 + k / q + k * k;
+    m_stages[1].b0 = 1.0;
+    m_stages[1].b1 = -2.0;
+    m_stages[1].b2 = 1.0;
+    m_stages[1].a1 = 2.0 * (k * k - 1.0) / a0;
+    m_stages[1].a2 = (1.0 - k / q + k * k) / a0;
+
+    // Hann-windowed sinc lowpass at the original Nyquist, split into phases;
+    // each phase is normalised to unity DC gain.
+    const int taps = OversampleFactor * TapsPerPhase;
+    const double center = (taps - 1) / 2.0;
+    for (int phase = 0; phase < OversampleFactor; ++phase) {
+        double sum = 0.0;
+        for (int tap = 0; tap < TapsPerPhase; ++tap) {
+            int index = phase + tap * OversampleFactor;
+            double x = (index - center) / OversampleFactor;
+            double sinc = x == 0.0 ? 1.0 : std::sin(kPi * x) / (kPi * x);
+            double window = 0.5 - 0.5 * std::cos(2.0 * kPi * (index + 0.5) / taps);
+            m_phases[phase][tap][0] = sinc * window;
+            sum += sinc * window;
+        }
+        for (int tap = 0; tap < TapsPerPhase; ++tap) {
+            m_phases[phase][tap][0] /= sum;
+            m_phases[phase][tap][1] = m_phases[phase][tap][0];
+        }
+    }
+}
+
+void LoudnessMeter::process(const float *interleaved, int frames)
+{
+    if (m_sampleRate <= 0) {
+        return;
+    }
+    while (frames > 0) {
+        int chunk = std::min(frames, m_segmentFrames - m_segmentFill);
+#ifdef LOUDNESS_USE_SSE2
+        processSse2(interleaved, chunk);
+#else
+        processScalar(interleaved, chunk);
+#endif
+        m_segmentFill += chunk;
+        m_totalFrames += chunk;
+        interleaved += chunk * 2;
+        frames -= chunk;
+        if (m_segmentFill == m_segmentFrames) {
+            endSegment();
+        }
+    }
+}
+
+void LoudnessMeter::processScalar(const float *interleaved, int frames)
+{
+    const Biquad &pre = m_stages[0];
+    const Biquad &rlb = m_stages[1];
+    for (int frame = 0; frame < frames; ++frame) {
+        int pos = m_historyPos = (m_historyPos + TapsPerPhase - 1) % TapsPerPhase;
+        for (int channel = 0; channel < 2; ++channel) {
+            double x = interleaved[frame * 2 + channel];
+
+            double y = pre.b0 * x + m_state[0][0][channel];
+            m_state[0][0][channel] = pre.b1 * x - pre.a1 * y + m_state[0][1][channel];
+            m_state[0][1][channel] = pre.b2 * x - pre.a2 * y;
+            double z = rlb.b0 * y + m_state[1][0][channel];
+            m_state[1][0][channel] = rlb.b1 * y - rlb.a1 * z + m_state[1][1][channel];
+            m_state[1][1][channel] = rlb.b2 * y - rlb.a2 * z;
+            m_segmentEnergy[channel] += z * z;
+
+            m_history[pos][channel] = x;
+            m_history[pos + TapsPerPhase][channel] = x;
+            double peak = std::fabs(x);
+            for (int phase = 0; phase < OversampleFactor; ++phase) {
+                double acc = 0.0;
+                for (int tap = 0; tap < TapsPerPhase; ++tap) {
+                    acc += m_phases[phase][tap][channel] * m_history[pos + tap][channel];
+                }
+                peak = std::max(peak, std::fabs(acc));
+            }
+            m_truePeak = std::max(m_truePeak, peak);
+        }
+    }
+}
+
+void LoudnessMeter::processSse2(const float *interleaved, int frames)
+{
+#ifdef LOUDNESS_USE_SSE2
+    const __m128d preB0 = _mm_set1_pd(m_stages[0].b0);
+    const __m128d preB1 = _mm_set1_pd(m_stages[0].b1);
+    const __m128d preB2 = _mm_set1_pd(m_stages[0].b2);
+    const __m128d preA1 = _mm_set1_pd(m_stages[0].a1);
+    const __m128d preA2 = _mm_set1_pd(m_stages[0].a2);
+    const __m128d rlbB0 = _mm_set1_pd(m_stages[1].b0);
+    const __m128d rlbB1 = _mm_set1_pd(m_stages[1].b1);
+    const __m128d rlbB2 = _mm_set1_pd(m_stages[1].b2);
+    const __m128d rlbA1 = _mm_set1_pd(m_stages[1].a1);
+    const __m128d rlbA2 = _mm_set1_pd(m_stages[1].a2);
+    const __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+
+    __m128d preZ1 = _mm_load_pd(m_state[0][0]);
+    __m128d preZ2 = _mm_load_pd(m_state[0][1]);
+    __m128d rlbZ1 = _mm_load_pd(m_state[1][0]);
+    __m128d rlbZ2 = _mm_load_pd(m_state[1][1]);
+    __m128d energy = _mm_load_pd(m_segmentEnergy);
+    __m128d peak = _mm_set1_pd(m_truePeak);
+    int pos = m_historyPos;
+
+    for (int frame = 0; frame < frames; ++frame) {
+        __m128d x = _mm_cvtps_pd(_mm_castsi128_ps(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i *>(interleaved + frame * 2))));
+
+        __m128d y = _mm_add_pd(_mm_mul_pd(preB0, x), preZ1);
+        preZ1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(preB1, x), _mm_mul_pd(preA1, y)), preZ2);
+        preZ2 = _mm_sub_pd(_mm_mul_pd(preB2, x), _mm_mul_pd(preA2, y));
+        __m128d z = _mm_add_pd(_mm_mul_pd(rlbB0, y), rlbZ1);
+        rlbZ1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(rlbB1, y), _mm_mul_pd(rlbA1, z)), rlbZ2);
+        rlbZ2 = _mm_sub_pd(_mm_mul_pd(rlbB2, y), _mm_mul_pd(rlbA2, z));
+        energy = _mm_add_pd(energy, _mm_mul_pd(z, z));
+
+        pos = (pos + TapsPerPhase - 1) % TapsPerPhase;
+        _mm_store_pd(m_history[pos], x);
+        _mm_store_pd(m_history[pos + TapsPerPhase], x);
+        peak = _mm_max_pd(peak, _mm_and_pd(x, absMask));
+        for (int phase = 0; phase < OversampleFactor; ++phase) {
+            __m128d acc = _mm_setzero_pd();
+            for (int tap = 0; tap < TapsPerPhase; ++tap) {
+                acc = _mm_add_pd(acc, _mm_mul_pd(_mm_load_pd(m_phases[phase][tap]),
+                                                 _mm_load_pd(m_history[pos + tap])));
+            }
+            peak = _mm_max_pd(peak, _mm_and_pd(acc, absMask));
+        }
+    }
+
+    _mm_store_pd(m_state[0][0], preZ1);
+    _mm_store_pd(m_state[0][1], preZ2);
+    _mm_store_pd(m_state[1][0], rlbZ1);
+    _mm_store_pd(m_state[1][1], rlbZ2);
+    _mm_store_pd(m_segmentEnergy, energy);
+    alignas(16) double peaks[2];
+    _mm_store_pd(peaks, peak);
+    m_truePeak = std::max(peaks[0], peaks[1]);
+    m_historyPos = pos;
+#else
+    processScalar(interleaved, frames);
+#endif
+}
+
+void LoudnessMeter::endSegment()
+{
+    double energy = m_segmentEnergy[0] + m_segmentEnergy[1];
+    m_segmentEnergy[0] = 0.0;
+    m_segmentEnergy[1] = 0.0;
+    m_segmentFill = 0;
+    m_totalEnergy += energy;
+    m_segments[m_segmentCount % SegmentsPerBlock] = energy;
+    ++m_segmentCount;
+    if (m_segmentCount >= SegmentsPerBlock) {
+        double sum = 0.0;
+        for (double segment : m_segments) {
+            sum += segment;
+        }
+        m_blocks.push_back(sum / (double(SegmentsPerBlock) * m_segmentFrames));
+    }
+}
+
+void LoudnessMeter::finish()
+{
+    // Tracks shorter than one gating block still get a measurement.
+    if (m_blocks.empty() && m_totalFrames > 0) {
+        double energy = m_totalEnergy + m_segmentEnergy[0] + m_segmentEnergy[1];
+        m_blocks.push_back(energy / double(m_totalFrames));
+    }
+}
+
+double LoudnessMeter::gatedLoudness(const std::vector<double> &blocks)
+{
+    const double absoluteGate = std::pow(10.0, (SilenceLoudness + 0.691) / 10.0);
+    double sum = 0.0;
+    long long count = 0;
+    for (double block : blocks) {
+        if (block > absoluteGate) {
+            sum += block;
+            ++count;
+        }
+    }
+    if (count == 0) {
+        return SilenceLoudness;
+    }
+    const double relativeGate = sum / count * 0.1;
+    sum = 0.0;
+    count = 0;
+    for (double block : blocks) {
+        if (block > absoluteGate && block > relativeGate) {
+            sum += block;
+            ++count;
+        }
+    }
+    if (count == 0) {
+        return SilenceLoudness;
+    }
+    return -0.691 + 10.0 * std::log10(sum / count);
+}
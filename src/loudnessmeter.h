@@ -0,0 +1,64 @@
+#ifndef LOUDNESSMETER_H
+#define LOUDNESSMETER_H
+
+#include <vector>
+
+// EBU R128 / ITU-R BS.1770 meter for interleaved stereo float input:
+// K-weighting, 400 ms gating blocks with 75% overlap, absolute and relative
+// gates, and true peak via 4x oversampling. Both channels go through the
+// filters together in one SSE2 register where the target has it.
+class LoudnessMeter
+{
+public:
+    static constexpr double ReferenceLoudness = -18.0;
+    static constexpr double SilenceLoudness = -70.0;
+
+    LoudnessMeter();
+
+    void prepare(int sampleRate);
+    bool isPrepared() const { return m_sampleRate > 0; }
+    void process(const float *interleaved, int frames);
+    void finish();
+
+    double integratedLoudness() const { return gatedLoudness(m_blocks); }
+    double truePeak() const { return m_truePeak; }
+    const std::vector<double> &blockEnergies() const { return m_blocks; }
+
+    static double gatedLoudness(const std::vector<double> &blocks);
+    static double replayGain(double loudness) { return ReferenceLoudness - loudness; }
+
+private:
+    static const int OversampleFactor = 4;
+    static const int TapsPerPhase = 12;
+    static const int SegmentsPerBlock = 4;
+
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+    };
+
+    void processScalar(const float *interleaved, int frames);
+    void processSse2(const float *interleaved, int frames);
+    void endSegment();
+
+    int m_sampleRate;
+    int m_segmentFrames;
+    int m_segmentFill;
+    Biquad m_stages[2];
+    // [stage][z1/z2][left/right]
+    alignas(16) double m_state[2][2][2];
+    alignas(16) double m_segmentEnergy[2];
+    double m_segments[SegmentsPerBlock];
+    long long m_segmentCount;
+    double m_totalEnergy;
+    long long m_totalFrames;
+    std::vector<double> m_blocks;
+
+    // Polyphase interpolator taps duplicated per channel, and a doubled
+    // history so the newest TapsPerPhase frames are always contiguous.
+    alignas(16) double m_phases[OversampleFactor][TapsPerPhase][2];
+    alignas(16) double m_history[2 * TapsPerPhase][2];
+    int m_historyPos;
+    double m_truePeak;
+};
+
+#endif
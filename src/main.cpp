@@ -1,4 +1,5 @@
 #include <QApplication>
+#include "backgroundscheduler.h"
 #include "mainwindow.h"
 
 int main(int argc, char *argv[])
@@ -7,6 +8,7 @@ int main(int argc, char *argv[])
     app.setApplicationName("Аудио Плеер");
     app.setOrganizationName("АудиоПлеер");
     
+    BackgroundScheduler scheduler;
     MainWindow window;
     window.show();
     return app.exec();
@@ -1,4 +1,6 @@
 #include "mainwindow.h"
+#include "backgroundscheduler.h"
+#include "libraryimporter.h"
 #include <QStandardItemModel>
 #include <QStandardItem>
 #include <QHeaderView>
@@ -9,19 +11,18 @@
 #include <QUrl>
 #include <QStandardPaths>
 #include <QApplication>
-#include <QRandomGenerator>
+#include <QDebug>
 #include <QKeySequence>
 #include <QMenu>
-#include <QProcess>
 #include <QProgressDialog>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , m_currentPlaylistId(-1)
-    , m_currentTrackIndex(-1)
     , m_shuffleEnabled(false)
     , m_repeatEnabled(false)
     , m_seeking(false)
+    , m_importing(false)
 {
     m_dbManager = new DatabaseManager(this);
     m_dbManager->initializeDatabase();
@@ -29,6 +30,21 @@ MainWindow::MainWindow(QWidget *parent)
     m_audioPlayer = new AudioPlayer(m_dbManager, this);
     m_playlistModel = new PlaylistModel(this);
     m_historyModel = new PlaylistModel(this);
+    m_coverThumbnails = new CoverThumbnailCache(QSize(128, 128), 400, this);
+    m_albumModel = new AlbumModel(m_coverThumbnails, this);
+    m_trackAnalyzer = new TrackAnalyzer(m_dbManager, this);
+    m_audioPlayer->glitchMonitor()->setLoadProbe([this]() {
+        QStringList jobs;
+        if (m_importing) {
+            jobs << "импорт";
+        }
+        if (m_trackAnalyzer->pendingCount() > 0) {
+            jobs << QString("анализ %1").arg(m_trackAnalyzer->pendingCount());
+        }
+        return jobs.join(", ");
+    });
+    m_equalizerDialog = nullptr;
+    m_diagnosticsDialog = nullptr;
     
     setupUI();
     setupMenuBar();
@@ -43,6 +59,8 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    // The analyzer thread reads the player's output tap; stop it first.
+    delete m_spectrumWidget;
 }
 
 void MainWindow::setupUI()
@@ -120,9 +138,14 @@ void MainWindow::setupUI()
     filterLayout->addStretch();
     m_trackList = new QListView(this);
     m_trackList->setModel(m_playlistModel);
+    m_albumGrid = new AlbumGridView(this);
+    m_albumGrid->setAlbumModel(m_albumModel);
+    m_libraryTabs = new QTabWidget(this);
+    m_libraryTabs->addTab(m_trackList, "Треки");
+    m_libraryTabs->addTab(m_albumGrid, "Альбомы");
     centerLayout->addLayout(searchLayout);
     centerLayout->addLayout(filterLayout);
-    centerLayout->addWidget(m_trackList);
+    centerLayout->addWidget(m_libraryTabs);
     m_rightPanel = new QWidget(this);
     QVBoxLayout *rightLayout = new QVBoxLayout(m_rightPanel);
     rightLayout->setContentsMargins(0, 0, 0, 0);
@@ -133,10 +156,12 @@ void MainWindow::setupUI()
     m_albumCoverLabel->setStyleSheet("border: 1px solid gray; background-color: #2b2b2b;");
     m_albumCoverLabel->setText("Нет обложки");
     m_albumCoverLabel->setScaledContents(false);
+    m_spectrumWidget = new SpectrumWidget(m_audioPlayer->outputTap(), this);
     m_trackInfoLabel = new QLabel("Трек не выбран", this);
     m_trackInfoLabel->setAlignment(Qt::AlignCenter);
     m_trackInfoLabel->setWordWrap(true);
     rightLayout->addWidget(m_albumCoverLabel);
+    rightLayout->addWidget(m_spectrumWidget);
     rightLayout->addWidget(m_trackInfoLabel);
     rightLayout->addStretch();
     m_rightPanel->setMaximumWidth(350);
@@ -151,7 +176,7 @@ void MainWindow::setupUI()
     QVBoxLayout *controlsLayout = new QVBoxLayout(m_controlsPanel);
     controlsLayout->setContentsMargins(5, 5, 5, 5);
     QHBoxLayout *positionLayout = new QHBoxLayout();
-    m_positionSlider = new QSlider(Qt::Horizontal, this);
+    m_positionSlider = new WaveformSlider(this);
     m_timeLabel = new QLabel("00:00 / 00:00", this);
     m_timeLabel->setMinimumWidth(100);
     positionLayout->addWidget(m_positionSlider);
@@ -192,6 +217,7 @@ void MainWindow::setupMenuBar()
     m_addFilesAction = fileMenu->addAction("Добавить файлы...");
     m_addFilesAction->setShortcut(QKeySequence::Open);
     m_addFolderAction = fileMenu->addAction("Добавить папку...");
+    m_analyzeLoudnessAction = fileMenu->addAction("Анализ громкости");
     fileMenu->addSeparator();
     m_exitAction = fileMenu->addAction("Выход");
     m_exitAction->setShortcut(QKeySequence::Quit);
@@ -199,7 +225,99 @@ void MainWindow::setupMenuBar()
     m_showHistoryAction = viewMenu->addAction("Показать историю");
     m_showHistoryAction->setCheckable(true);
     m_showHistoryAction->setChecked(true);
-    
+    m_diagnosticsAction = viewMenu->addAction("Диагностика...");
+    QMenu *playbackMenu = menuBar()->addMenu("Воспроизведение");
+    m_gaplessAction = playbackMenu->addAction("Без пауз между треками");
+    m_gaplessAction->setCheckable(true);
+    m_gaplessAction->setChecked(m_audioPlayer->isGaplessEnabled());
+    m_skipSilenceAction = playbackMenu->addAction("Пропускать тишину на стыках треков");
+    m_skipSilenceAction->setCheckable(true);
+    m_skipSilenceAction->setChecked(m_audioPlayer->isSilenceSkipping());
+    m_pcmEngineAction = playbackMenu->addAction("Собственный аудиодвижок");
+    m_pcmEngineAction->setCheckable(true);
+    m_pcmEngineAction->setChecked(m_audioPlayer->backend() == AudioPlayer::PcmEngineBackend);
+    m_memoryMappedAction = playbackMenu->addAction("Читать файлы через отображение в память");
+    m_memoryMappedAction->setCheckable(true);
+    m_memoryMappedAction->setChecked(m_audioPlayer->isMemoryMapped());
+    m_equalizerAction = playbackMenu->addAction("Эквалайзер...");
+    QMenu *replayGainMenu = playbackMenu->addMenu("Нормализация громкости");
+    m_replayGainGroup = new QActionGroup(this);
+    QAction *replayGainOffAction = replayGainMenu->addAction("Выкл");
+    replayGainOffAction->setData(static_cast<int>(AudioPlayer::ReplayGainOff));
+    QAction *replayGainTrackAction = replayGainMenu->addAction("По треку");
+    replayGainTrackAction->setData(static_cast<int>(AudioPlayer::ReplayGainTrack));
+    QAction *replayGainAlbumAction = replayGainMenu->addAction("По альбому");
+    replayGainAlbumAction->setData(static_cast<int>(AudioPlayer::ReplayGainAlbum));
+    for (QAction *action : {replayGainOffAction, replayGainTrackAction, replayGainAlbumAction}) {
+        action->setCheckable(true);
+        action->setChecked(action->data().toInt() == m_audioPlayer->replayGainMode());
+        m_replayGainGroup->addAction(action);
+    }
+    QMenu *pcmCacheMenu = playbackMenu->addMenu("Кэш декодированного звука");
+    m_pcmCacheGroup = new QActionGroup(this);
+    for (int megabytes : {0, 64, 128, 256, 512}) {
+        QAction *action = pcmCacheMenu->addAction(megabytes == 0 ? "Выкл" : QString("%1 МБ").arg(megabytes));
+        action->setCheckable(true);
+        action->setData(megabytes);
+        action->setChecked(megabytes == m_audioPlayer->pcmCacheSize());
+        m_pcmCacheGroup->addAction(action);
+    }
+    QMenu *outputBufferMenu = playbackMenu->addMenu("Буфер вывода");
+    m_outputBufferGroup = new QActionGroup(this);
+    for (const QPoint &sizes : {QPoint(250, 10), QPoint(500, 10), QPoint(1000, 20), QPoint(2000, 40), QPoint(4000, 80)}) {
+        QAction *action = outputBufferMenu->addAction(QString("%1 мс, период %2 мс").arg(sizes.x()).arg(sizes.y()));
+        action->setCheckable(true);
+        action->setData(sizes);
+        action->setChecked(sizes.x() == m_audioPlayer->outputBufferMs());
+        m_outputBufferGroup->addAction(action);
+    }
+    QMenu *resamplerMenu = playbackMenu->addMenu("Качество передискретизации");
+    m_resamplerQualityGroup = new QActionGroup(this);
+    QAction *resamplerFastAction = resamplerMenu->addAction("Быстрое");
+    resamplerFastAction->setData(static_cast<int>(Resampler::Fast));
+    QAction *resamplerStandardAction = resamplerMenu->addAction("Стандартное");
+    resamplerStandardAction->setData(static_cast<int>(Resampler::Standard));
+    QAction *resamplerHighAction = resamplerMenu->addAction("Высокое");
+    resamplerHighAction->setData(static_cast<int>(Resampler::High));
+    for (QAction *action : {resamplerFastAction, resamplerStandardAction, resamplerHighAction}) {
+        action->setCheckable(true);
+        action->setChecked(action->data().toInt() == m_audioPlayer->resamplerQuality());
+        m_resamplerQualityGroup->addAction(action);
+    }
+    // Only the PCM engine mixes a crossfade; see onPcmEngineToggled().
+    m_crossfadeMenu = playbackMenu->addMenu("Кроссфейд");
+    m_crossfadeMenu->setEnabled(m_audioPlayer->backend() == AudioPlayer::PcmEngineBackend);
+    m_crossfadeGroup = new QActionGroup(this);
+    for (int seconds : {0, 2, 4, 6, 8, 10, 12}) {
+        QAction *action = m_crossfadeMenu->addAction(seconds == 0 ? "Выкл" : QString("%1 с").arg(seconds));
+        action->setCheckable(true);
+        action->setData(seconds * 1000);
+        action->setChecked(seconds * 1000 == m_audioPlayer->crossfadeDuration());
+        m_crossfadeGroup->addAction(action);
+    }
+    m_crossfadeMenu->addSeparator();
+    m_crossfadeCurveGroup = new QActionGroup(this);
+    QAction *equalPowerAction = m_crossfadeMenu->addAction("Равная мощность");
+    equalPowerAction->setData(static_cast<int>(Crossfader::EqualPower));
+    QAction *linearAction = m_crossfadeMenu->addAction("Линейная");
+    linearAction->setData(static_cast<int>(Crossfader::Linear));
+    for (QAction *action : {equalPowerAction, linearAction}) {
+        action->setCheckable(true);
+        action->setChecked(action->data().toInt() == m_audioPlayer->crossfadeCurve());
+        m_crossfadeCurveGroup->addAction(action);
+    }
+    QMenu *playbackRateMenu = playbackMenu->addMenu("Скорость");
+    m_playbackRateGroup = new QActionGroup(this);
+    for (double rate : {0.5, 0.75, 1.0, 1.25, 1.5, 1.75, 2.0, 2.5, 3.0}) {
+        QAction *action = playbackRateMenu->addAction(rate == 1.0 ? "Обычная" : QString("%1×").arg(rate));
+        action->setCheckable(true);
+        action->setData(rate);
+        m_playbackRateGroup->addAction(action);
+    }
+    updatePlaybackRateActions(m_audioPlayer->playbackRate());
+    m_outputDeviceMenu = playbackMenu->addMenu("Устройство вывода");
+    m_outputDeviceGroup = new QActionGroup(this);
+    updateOutputDeviceMenu();
 }
 
 void MainWindow::setupToolBar()
@@ -221,6 +339,63 @@ void MainWindow::setupConnections()
     connect(m_addFolderAction, &QAction::triggered, this, &MainWindow::onAddFolder);
     connect(m_exitAction, &QAction::triggered, this, &QWidget::close);
     connect(m_showHistoryAction, &QAction::toggled, this, &MainWindow::onShowHistory);
+    connect(m_gaplessAction, &QAction::toggled, this, &MainWindow::onGaplessToggled);
+    connect(m_skipSilenceAction, &QAction::toggled, m_audioPlayer, &AudioPlayer::setSilenceSkipping);
+    connect(m_pcmEngineAction, &QAction::toggled, this, &MainWindow::onPcmEngineToggled);
+    connect(m_memoryMappedAction, &QAction::toggled, m_audioPlayer, &AudioPlayer::setMemoryMapped);
+    connect(m_equalizerAction, &QAction::triggered, this, &MainWindow::onShowEqualizer);
+    connect(m_diagnosticsAction, &QAction::triggered, this, &MainWindow::onShowDiagnostics);
+    connect(m_crossfadeGroup, &QActionGroup::triggered, this, [this](QAction *action) {
+        m_audioPlayer->setCrossfadeDuration(action->data().toInt());
+        updateNextTrack();
+    });
+    connect(m_crossfadeCurveGroup, &QActionGroup::triggered, this, [this](QAction *action) {
+        m_audioPlayer->setCrossfadeCurve(static_cast<Crossfader::Curve>(action->data().toInt()));
+    });
+    connect(m_outputDeviceGroup, &QActionGroup::triggered, this, [this](QAction *action) {
+        QAudioDevice selected;
+        for (const QAudioDevice &device : QMediaDevices::audioOutputs()) {
+            if (device.id() == action->data().toByteArray()) {
+                selected = device;
+            }
+        }
+        m_audioPlayer->setOutputDevice(selected);
+    });
+    connect(m_audioPlayer, &AudioPlayer::outputDevicesChanged, this, &MainWindow::updateOutputDeviceMenu);
+    connect(m_playbackRateGroup, &QActionGroup::triggered, this, [this](QAction *action) {
+        m_audioPlayer->setPlaybackRate(action->data().toDouble());
+    });
+    connect(m_pcmCacheGroup, &QActionGroup::triggered, this, [this](QAction *action) {
+        m_audioPlayer->setPcmCacheSize(action->data().toInt());
+    });
+    connect(m_outputBufferGroup, &QActionGroup::triggered, this, [this](QAction *action) {
+        const QPoint sizes = action->data().toPoint();
+        m_audioPlayer->setOutputBufferSize(sizes.x(), sizes.y());
+    });
+    connect(m_resamplerQualityGroup, &QActionGroup::triggered, this, [this](QAction *action) {
+        m_audioPlayer->setResamplerQuality(static_cast<Resampler::Quality>(action->data().toInt()));
+    });
+    connect(m_replayGainGroup, &QActionGroup::triggered, this, [this](QAction *action) {
+        m_audioPlayer->setReplayGainMode(static_cast<AudioPlayer::ReplayGainMode>(action->data().toInt()));
+    });
+    connect(m_analyzeLoudnessAction, &QAction::triggered, this, &MainWindow::onAnalyzeLoudness);
+    connect(m_trackAnalyzer, &TrackAnalyzer::progress, this, &MainWindow::onLoudnessAnalysisProgress);
+    connect(m_trackAnalyzer, &TrackAnalyzer::finished, this, &MainWindow::onLoudnessAnalysisFinished);
+    connect(m_trackAnalyzer, &TrackAnalyzer::peaksReady, this, [this](int trackId) {
+        if (trackId == m_audioPlayer->currentTrack().id) {
+            updateWaveform(m_audioPlayer->currentTrack());
+        }
+    });
+    connect(m_trackAnalyzer, &TrackAnalyzer::trackAnalyzed, this, [this](int trackId) {
+        if (trackId == m_audioPlayer->currentTrack().id || trackId == m_audioPlayer->nextTrack().id) {
+            m_audioPlayer->refreshReplayGain();
+        }
+    });
+    connect(m_trackAnalyzer, &TrackAnalyzer::audioRangeFound, this, [this](int trackId) {
+        if (trackId == m_audioPlayer->currentTrack().id || trackId == m_audioPlayer->nextTrack().id) {
+            m_audioPlayer->refreshAudioRanges();
+        }
+    });
     
     connect(m_createPlaylistBtn, &QPushButton::clicked, this, &MainWindow::onCreatePlaylist);
     connect(m_deletePlaylistBtn, &QPushButton::clicked, this, &MainWindow::onDeletePlaylist);
@@ -242,16 +417,18 @@ void MainWindow::setupConnections()
     connect(m_audioPlayer, &AudioPlayer::durationChanged, this, &MainWindow::onDurationChanged);
     connect(m_audioPlayer, &AudioPlayer::stateChanged, this, &MainWindow::onStateChanged);
     connect(m_audioPlayer, &AudioPlayer::trackChanged, this, &MainWindow::onTrackChanged);
+    connect(m_audioPlayer, &AudioPlayer::trackFinished, this, &MainWindow::onTrackFinished);
     connect(m_audioPlayer, &AudioPlayer::errorOccurred, this, [this](const QString &error) {
         QMessageBox::warning(this, "Ошибка воспроизведения", error);
     });
     
     connect(m_trackList, &QListView::doubleClicked, this, &MainWindow::onTrackDoubleClicked);
+    connect(m_albumGrid, &QListView::doubleClicked, this, &MainWindow::onAlbumDoubleClicked);
     connect(m_trackList->selectionModel(), &QItemSelectionModel::currentChanged, 
             this, [this](const QModelIndex &current, const QModelIndex &previous) {
         Q_UNUSED(previous)
         if (current.isValid()) {
-            TrackInfo track = m_playlistModel->trackAt(current.row());
+            const TrackInfo &track = m_playlistModel->trackRef(current.row());
             TrackInfo playingTrack = m_audioPlayer->currentTrack();
             if (playingTrack.id < 0) {
                 updateAlbumCoverForTrack(track);
@@ -263,19 +440,7 @@ void MainWindow::setupConnections()
     connect(m_historyList, &QListView::doubleClicked, this, [this](const QModelIndex &index) {
         TrackInfo track = m_historyModel->trackAt(index.row());
         if (track.id >= 0) {
-            bool found = false;
-            for (int i = 0; i < m_playlistModel->trackCount(); ++i) {
-                if (m_playlistModel->trackAt(i).id == track.id) {
-                    m_currentTrackIndex = i;
-                    m_trackList->setCurrentIndex(m_playlistModel->index(i));
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-                m_playlistModel->addTrack(track);
-                m_currentTrackIndex = m_playlistModel->trackCount() - 1;
-            }
+            m_playQueue.playNow(track);
             m_audioPlayer->setTrack(track);
             m_audioPlayer->play();
         }
@@ -286,6 +451,7 @@ void MainWindow::setupConnections()
         
         QMenu menu(this);
         QAction *playAction = menu.addAction("Воспроизвести");
+        QAction *playNextAction = menu.addAction("Воспроизвести следующим");
         QAction *addToPlaylistAction = menu.addAction("Добавить в плейлист...");
         QAction *removeFromPlaylistAction = menu.addAction("Удалить из плейлиста");
         QAction *addArtistAction = menu.addAction("Добавить исполнителя...");
@@ -313,12 +479,11 @@ void MainWindow::setupConnections()
         QAction *selected = menu.exec(m_trackList->mapToGlobal(pos));
         if (selected == playAction) {
             m_trackList->setCurrentIndex(index);
-            TrackInfo playTrack = m_playlistModel->trackAt(index.row());
-            if (playTrack.id >= 0) {
-                m_currentTrackIndex = index.row();
-                m_audioPlayer->setTrack(playTrack);
-                m_audioPlayer->play();
-            }
+            onTrackDoubleClicked(index);
+        } else if (selected == playNextAction) {
+            m_playQueue.playNext(track);
+            updateNextTrack();
+            statusBar()->showMessage(QString("Следующим: %1").arg(index.data().toString()), 2000);
         } else if (selected == addToPlaylistAction) {
             m_trackList->setCurrentIndex(index);
             onAddToPlaylist();
@@ -369,44 +534,7 @@ void MainWindow::onAddFiles()
     if (files.isEmpty()) {
         return;
     }
-    int added = 0;
-    int converted = 0;
-    QProgressDialog progress("Обработка файлов...", "Отмена", 0, files.size(), this);
-    progress.setWindowModality(Qt::WindowModal);
-    progress.show();
-    for (int i = 0; i < files.size(); ++i) {
-        const QString &file = files[i];
-        progress.setValue(i);
-        progress.setLabelText(QString("Обработка: %1").arg(QFileInfo(file).fileName()));
-        QApplication::processEvents();
-        if (progress.wasCanceled()) {
-            break;
-        }
-        
-        QString fileToAdd = file;
-        if (file.endsWith(".mp4", Qt::CaseInsensitive) || file.endsWith(".m4v", Qt::CaseInsensitive)) {
-            QString mp3Path = convertMp4ToMp3(file);
-            if (!mp3Path.isEmpty()) {
-                fileToAdd = mp3Path;
-                converted++;
-            } else {
-                statusBar()->showMessage(QString("Ошибка конвертации: %1").arg(file), 5000);
-                continue;
-            }
-        }
-        int trackId = m_dbManager->addTrack(fileToAdd);
-        if (trackId >= 0) {
-            added++;
-        }
-    }
-    
-    progress.setValue(files.size());
-    QString message = QString("Добавлено файлов: %1").arg(added);
-    if (converted > 0) {
-        message += QString(", конвертировано: %1").arg(converted);
-    }
-    statusBar()->showMessage(message, 3000);
-    loadTracks();
+    importFiles(files, "Добавлено файлов");
 }
 
 void MainWindow::onAddFolder()
@@ -415,48 +543,44 @@ void MainWindow::onAddFolder()
     if (folder.isEmpty()) {
         return;
     }
-    
-    QDir dir(folder);
-    QStringList filters = {"*.mp3", "*.wav", "*.flac", "*.ogg", "*.m4a", "*.aac", "*.wma", "*.mp4", "*.m4v"};
-    QStringList files = dir.entryList(filters, QDir::Files);
-    int added = 0;
-    int converted = 0;
-    
+    importFiles(LibraryImporter::collectFiles(folder, false), "Добавлено файлов из папки");
+}
+
+void MainWindow::importFiles(const QStringList &files, const QString &messagePrefix)
+{
     QProgressDialog progress("Обработка файлов...", "Отмена", 0, files.size(), this);
     progress.setWindowModality(Qt::WindowModal);
     progress.show();
-    for (int i = 0; i < files.size(); ++i) {
-        const QString &file = files[i];
-        progress.setValue(i);
-        progress.setLabelText(QString("Обработка: %1").arg(file));
+    m_importing = true;
+    LibraryImporter importer(m_dbManager);
+    const QList<LibraryImporter::Result> results = importer.import(files, [&progress](int done, int total) {
+        progress.setValue(done);
+        progress.setLabelText(QString("Обработано файлов: %1 из %2").arg(done).arg(total));
         QApplication::processEvents();
-        if (progress.wasCanceled()) {
-            break;
-        }
-        
-        QString filePath = dir.absoluteFilePath(file);
-        QString fileToAdd = filePath;
-        if (file.endsWith(".mp4", Qt::CaseInsensitive) || file.endsWith(".m4v", Qt::CaseInsensitive)) {
-            QString mp3Path = convertMp4ToMp3(filePath);
-            if (!mp3Path.isEmpty()) {
-                fileToAdd = mp3Path;
-                converted++;
-            } else {
-                continue;
-            }
-        }
-        
-        int trackId = m_dbManager->addTrack(fileToAdd);
-        if (trackId >= 0) {
-            added++;
+        return !progress.wasCanceled();
+    });
+    m_importing = false;
+    progress.setValue(files.size());
+
+    int added = 0;
+    int converted = 0;
+    int failed = 0;
+    for (const LibraryImporter::Result &result : results) {
+        if (result.trackId >= 0) {
+            ++added;
+            converted += result.converted ? 1 : 0;
+        } else if (LibraryImporter::needsConversion(result.sourcePath)) {
+            ++failed;
+            qWarning() << "Не удалось импортировать" << result.sourcePath << ":" << result.error;
         }
     }
-    
-    progress.setValue(files.size());
-    QString message = QString("Добавлено файлов из папки: %1").arg(added);
+    QString message = QString("%1: %2").arg(messagePrefix).arg(added);
     if (converted > 0) {
         message += QString(", конвертировано: %1").arg(converted);
     }
+    if (failed > 0) {
+        message += QString(", ошибок конвертации: %1").arg(failed);
+    }
     statusBar()->showMessage(message, 3000);
     loadTracks();
 }
@@ -466,14 +590,14 @@ void MainWindow::onPlayPause()
     if (m_audioPlayer->state() == QMediaPlayer::PlayingState) {
         m_audioPlayer->pause();
     } else {
-        if (m_currentTrackIndex < 0 || m_audioPlayer->currentTrack().id < 0) {
+        if (m_playQueue.isEmpty() || m_audioPlayer->currentTrack().id < 0) {
             QModelIndex currentIndex = m_trackList->currentIndex();
             if (currentIndex.isValid()) {
                 onTrackDoubleClicked(currentIndex);
                 return;
             } else if (m_playlistModel->trackCount() > 0) {
-                m_currentTrackIndex = 0;
-                TrackInfo track = m_playlistModel->trackAt(0);
+                m_playQueue.setTracks(m_playlistModel->tracks(), 0);
+                TrackInfo track = m_playQueue.current();
                 if (track.id >= 0) {
                     m_audioPlayer->setTrack(track);
                     m_trackList->setCurrentIndex(m_playlistModel->index(0));
@@ -489,33 +613,18 @@ void MainWindow::onPlayPause()
 
 void MainWindow::onStop()
 {
-    if (m_currentTrackIndex >= 0 && m_currentTrackIndex < m_playlistModel->trackCount()) {
-        TrackInfo track = m_playlistModel->trackAt(m_currentTrackIndex);
-        if (track.id >= 0) {
-            m_audioPlayer->setTrack(track);
-            m_audioPlayer->play();
-        }
+    TrackInfo track = m_playQueue.current();
+    if (track.id >= 0) {
+        m_audioPlayer->setTrack(track);
+        m_audioPlayer->play();
     } else {
         m_audioPlayer->stop();
-        m_currentTrackIndex = -1;
     }
 }
 
 void MainWindow::onPrevious()
 {
-    if (m_playlistModel->trackCount() == 0) {
-        return;
-    }
-    if (m_shuffleEnabled) {
-        m_currentTrackIndex = QRandomGenerator::global()->bounded(m_playlistModel->trackCount());
-    } else {
-        m_currentTrackIndex--;
-        if (m_currentTrackIndex < 0) {
-            m_currentTrackIndex = m_playlistModel->trackCount() - 1;
-        }
-    }
-    
-    TrackInfo track = m_playlistModel->trackAt(m_currentTrackIndex);
+    TrackInfo track = m_playQueue.previous();
     if (track.id >= 0) {
         m_audioPlayer->setTrack(track);
         m_audioPlayer->play();
@@ -524,24 +633,13 @@ void MainWindow::onPrevious()
 
 void MainWindow::onNext()
 {
-    if (m_playlistModel->trackCount() == 0) {
+    if (m_playQueue.isEmpty()) {
         return;
     }
-    if (m_shuffleEnabled) {
-        m_currentTrackIndex = QRandomGenerator::global()->bounded(m_playlistModel->trackCount());
-    } else {
-        m_currentTrackIndex++;
-        if (m_currentTrackIndex >= m_playlistModel->trackCount()) {
-            m_currentTrackIndex = m_repeatEnabled ? 0 : -1;
-        }
-    }
-    
-    if (m_currentTrackIndex >= 0) {
-        TrackInfo track = m_playlistModel->trackAt(m_currentTrackIndex);
-        if (track.id >= 0) {
-            m_audioPlayer->setTrack(track);
-            m_audioPlayer->play();
-        }
+    TrackInfo track = m_playQueue.next(m_repeatEnabled);
+    if (track.id >= 0) {
+        m_audioPlayer->setTrack(track);
+        m_audioPlayer->play();
     } else {
         m_audioPlayer->stop();
     }
@@ -551,12 +649,15 @@ void MainWindow::onShuffle()
 {
     m_shuffleEnabled = !m_shuffleEnabled;
     m_shuffleBtn->setStyleSheet(m_shuffleEnabled ? "font-weight: bold;" : "");
+    m_playQueue.setShuffle(m_shuffleEnabled);
+    updateNextTrack();
 }
 
 void MainWindow::onRepeat()
 {
     m_repeatEnabled = !m_repeatEnabled;
     m_repeatBtn->setStyleSheet(m_repeatEnabled ? "font-weight: bold;" : "");
+    updateNextTrack();
 }
 
 void MainWindow::onVolumeChanged(int value)
@@ -574,12 +675,10 @@ void MainWindow::onPositionChanged(qint64 position)
         
         qint64 duration = m_audioPlayer->duration();
         if (duration > 0 && position >= duration - 100 && m_repeatEnabled) {
-            if (m_currentTrackIndex >= 0 && m_currentTrackIndex < m_playlistModel->trackCount()) {
-                TrackInfo track = m_playlistModel->trackAt(m_currentTrackIndex);
-                if (track.id >= 0 && track.id == m_audioPlayer->currentTrack().id) {
-                    m_audioPlayer->setPosition(0);
-                    m_audioPlayer->play();
-                }
+            TrackInfo track = m_playQueue.current();
+            if (track.id >= 0 && track.id == m_audioPlayer->currentTrack().id) {
+                m_audioPlayer->setPosition(0);
+                m_audioPlayer->play();
             }
         }
     }
@@ -603,53 +702,94 @@ void MainWindow::onStateChanged(QMediaPlayer::PlaybackState state)
             }
         }
     }
-    
-    if (state == QMediaPlayer::StoppedState) {
-        if (m_repeatEnabled) {
-            if (m_currentTrackIndex >= 0 && m_currentTrackIndex < m_playlistModel->trackCount()) {
-                TrackInfo track = m_playlistModel->trackAt(m_currentTrackIndex);
-                if (track.id >= 0) {
-                    m_audioPlayer->setTrack(track);
-                    m_audioPlayer->play();
-                }
-            }
-        } else {
-            if (m_currentTrackIndex >= 0 && 
-                m_currentTrackIndex < m_playlistModel->trackCount() - 1) {
-                onNext();
-            }
-        }
+}
+
+void MainWindow::onTrackFinished()
+{
+    TrackInfo track;
+    track.id = -1;
+    if (m_repeatEnabled) {
+        track = m_playQueue.current();
+    } else if (m_playQueue.peekNext(false).id >= 0) {
+        track = m_playQueue.next(false);
+    }
+    if (track.id >= 0) {
+        m_audioPlayer->latencyTracker()->begin(LatencyTracker::Transition);
+        m_audioPlayer->setTrack(track, true);
+        m_audioPlayer->play();
     }
 }
 
 void MainWindow::onTrackChanged(const TrackInfo &track)
 {
     updateAlbumCover();
+    updateWaveform(track);
+    updatePlaybackRateActions(track.playbackRate);
     QString info = QString("<b>%1</b><br>%2<br>%3")
                    .arg(track.title.isEmpty() ? QFileInfo(track.filePath).baseName() : track.title)
                    .arg(track.artist.isEmpty() ? "Неизвестный исполнитель" : track.artist)
                    .arg(track.album.isEmpty() ? "Неизвестный альбом" : track.album);
     m_trackInfoLabel->setText(info);
     
-    for (int i = 0; i < m_playlistModel->trackCount(); ++i) {
-        if (m_playlistModel->trackAt(i).id == track.id) {
-            m_currentTrackIndex = i;
-            m_trackList->setCurrentIndex(m_playlistModel->index(i));
-            break;
-        }
+    // Gapless and crossfade switches advance the player on their own.
+    if (track.id != m_playQueue.current().id && track.id == m_playQueue.peekNext(false).id) {
+        m_playQueue.next(false);
+    }
+    int row = m_playlistModel->rowForTrackId(track.id);
+    if (row >= 0) {
+        m_trackList->setCurrentIndex(m_playlistModel->index(row));
+    }
+    updateNextTrack();
+}
+
+void MainWindow::updateWaveform(const TrackInfo &track)
+{
+    WaveformPeaks peaks;
+    if (track.id >= 0 && PeakExtractor::load(PeakExtractor::peakFilePath(track.id), peaks)) {
+        m_positionSlider->setPeaks(peaks);
+        return;
+    }
+    m_positionSlider->clearPeaks();
+    if (track.id >= 0) {
+        m_trackAnalyzer->requestPeaks(track);
     }
 }
 
 void MainWindow::onTrackDoubleClicked(const QModelIndex &index)
 {
-    TrackInfo track = m_playlistModel->trackAt(index.row());
+    m_audioPlayer->latencyTracker()->begin(LatencyTracker::TrackStart);
+    m_playQueue.setTracks(m_playlistModel->tracks(), index.row());
+    TrackInfo track = m_playQueue.current();
     if (track.id >= 0) {
-        m_currentTrackIndex = index.row();
         m_audioPlayer->setTrack(track);
         m_audioPlayer->play();
     }
 }
 
+void MainWindow::onAlbumDoubleClicked(const QModelIndex &index)
+{
+    AlbumInfo album = m_albumModel->albumAt(index.row());
+    if (album.name.isEmpty()) {
+        return;
+    }
+    m_searchEdit->clear();
+    // The artist keeps same-titled albums of other artists out.
+    int artistIndex = album.artist.isEmpty() ? 0 : m_artistFilter->findText(album.artist);
+    if (artistIndex >= 0) {
+        m_artistFilter->setCurrentIndex(artistIndex);
+    } else {
+        m_artistFilter->setCurrentText(album.artist);
+    }
+    int albumIndex = m_albumFilter->findText(album.name);
+    if (albumIndex >= 0) {
+        m_albumFilter->setCurrentIndex(albumIndex);
+    } else {
+        m_albumFilter->setCurrentText(album.name);
+    }
+    applyFilters();
+    m_libraryTabs->setCurrentWidget(m_trackList);
+}
+
 void MainWindow::onSearchTextChanged(const QString &text)
 {
     applyFilters();
@@ -714,6 +854,70 @@ void MainWindow::onShowHistory()
     }
 }
 
+void MainWindow::onGaplessToggled(bool enabled)
+{
+    m_audioPlayer->setGaplessEnabled(enabled);
+    updateNextTrack();
+}
+
+void MainWindow::onPcmEngineToggled(bool enabled)
+{
+    m_audioPlayer->setBackend(enabled ? AudioPlayer::PcmEngineBackend : AudioPlayer::MediaPlayerBackend);
+    updateNextTrack();
+    m_crossfadeMenu->setEnabled(enabled);
+    if (m_equalizerDialog) {
+        m_equalizerDialog->setBackendNoticeVisible(!enabled);
+    }
+}
+
+void MainWindow::onShowEqualizer()
+{
+    if (!m_equalizerDialog) {
+        m_equalizerDialog = new EqualizerDialog(m_audioPlayer->equalizer(), this);
+    }
+    m_equalizerDialog->setBackendNoticeVisible(m_audioPlayer->backend() != AudioPlayer::PcmEngineBackend);
+    m_equalizerDialog->show();
+    m_equalizerDialog->raise();
+    m_equalizerDialog->activateWindow();
+}
+
+void MainWindow::onShowDiagnostics()
+{
+    if (!m_diagnosticsDialog) {
+        m_diagnosticsDialog = new DiagnosticsDialog(m_audioPlayer, this);
+    }
+    m_diagnosticsDialog->refresh();
+    m_diagnosticsDialog->show();
+    m_diagnosticsDialog->raise();
+    m_diagnosticsDialog->activateWindow();
+}
+
+void MainWindow::onAnalyzeLoudness()
+{
+    if (m_trackAnalyzer->isRunning()) {
+        m_trackAnalyzer->cancel();
+        return;
+    }
+    QList<TrackInfo> tracks = m_dbManager->getTracksPendingLoudness();
+    if (tracks.isEmpty()) {
+        statusBar()->showMessage("Громкость всех треков уже проанализирована", 3000);
+        return;
+    }
+    m_analyzeLoudnessAction->setText("Остановить анализ громкости");
+    m_trackAnalyzer->analyze(tracks);
+}
+
+void MainWindow::onLoudnessAnalysisProgress(int done, int total)
+{
+    statusBar()->showMessage(QString("Анализ громкости: %1 из %2").arg(done).arg(total));
+}
+
+void MainWindow::onLoudnessAnalysisFinished()
+{
+    m_analyzeLoudnessAction->setText("Анализ громкости");
+    statusBar()->showMessage("Анализ громкости завершён", 3000);
+}
+
 void MainWindow::onAddToPlaylist()
 {
     QModelIndex index = m_trackList->currentIndex();
@@ -843,6 +1047,7 @@ void MainWindow::onDeleteTrack()
                                     QMessageBox::No);
     if (ret == QMessageBox::Yes) {
         if (m_dbManager->deleteTrack(track.id)) {
+            QFile::remove(PeakExtractor::peakFilePath(track.id));
             loadTracks();
             statusBar()->showMessage("Композиция удалена", 2000);
         } else {
@@ -1180,6 +1385,7 @@ void MainWindow::loadTracks()
     }
     
     m_playlistModel->setTracks(tracks);
+    m_albumModel->setAlbums(m_dbManager->getAlbumSummaries());
     
     TrackInfo playingTrack = m_audioPlayer->currentTrack();
     if (playingTrack.id < 0) {
@@ -1266,53 +1472,62 @@ void MainWindow::applyFilters()
     m_playlistModel->setTracks(tracks);
 }
 
-QString MainWindow::formatTime(qint64 milliseconds) const
+TrackInfo MainWindow::autoAdvanceTrack()
 {
-    int seconds = milliseconds / 1000;
-    int minutes = seconds / 60;
-    seconds %= 60;
-    return QString("%1:%2").arg(minutes, 2, 10, QChar('0'))
-                          .arg(seconds, 2, 10, QChar('0'));
+    if (m_repeatEnabled) {
+        return m_playQueue.current();
+    }
+    return m_playQueue.peekNext(false);
 }
 
-QString MainWindow::convertMp4ToMp3(const QString &mp4Path)
+void MainWindow::updateNextTrack()
 {
-    QFileInfo fileInfo(mp4Path);
-    QString outputDir = QStandardPaths::writableLocation(QStandardPaths::MusicLocation) + "/Converted";
-    QDir().mkpath(outputDir);
-    QString mp3Path = outputDir + "/" + fileInfo.baseName() + ".mp3";
-    
-    int counter = 1;
-    QString originalMp3Path = mp3Path;
-    while (QFileInfo::exists(mp3Path)) {
-        mp3Path = outputDir + "/" + fileInfo.baseName() + "_" + QString::number(counter) + ".mp3";
-        counter++;
+    if (m_audioPlayer->currentTrack().id < 0) {
+        m_audioPlayer->clearNextTrack();
+        return;
     }
-    
-    QString ffmpegPath = "ffmpeg";
-    QProcess process;
-    QStringList arguments;
-    arguments << "-i" << mp4Path
-              << "-vn"
-              << "-acodec" << "libmp3lame"
-              << "-ab" << "192k"
-              << "-ar" << "44100"
-              << "-y"
-              << mp3Path;
-    
-    process.start(ffmpegPath, arguments);
-    if (!process.waitForFinished(300000)) {
-        return QString();
+    TrackInfo next = autoAdvanceTrack();
+    if (next.id < 0) {
+        m_audioPlayer->clearNextTrack();
+        return;
     }
-    
-    if (process.exitCode() != 0) {
-        QString errorOutput = process.readAllStandardError();
-        return QString();
+    m_audioPlayer->setNextTrack(next);
+}
+
+void MainWindow::updateOutputDeviceMenu()
+{
+    // The menu owns the actions; deleting them also takes them out of the group.
+    m_outputDeviceMenu->clear();
+    const QByteArray selectedId = m_audioPlayer->outputDevice().id();
+    QAction *defaultAction = m_outputDeviceMenu->addAction("Системное по умолчанию");
+    defaultAction->setData(QByteArray());
+    defaultAction->setCheckable(true);
+    defaultAction->setChecked(selectedId.isEmpty());
+    m_outputDeviceGroup->addAction(defaultAction);
+    m_outputDeviceMenu->addSeparator();
+    for (const QAudioDevice &device : QMediaDevices::audioOutputs()) {
+        QAction *action = m_outputDeviceMenu->addAction(device.description());
+        action->setData(device.id());
+        action->setCheckable(true);
+        action->setChecked(device.id() == selectedId);
+        m_outputDeviceGroup->addAction(action);
     }
-    if (QFileInfo::exists(mp3Path)) {
-        return mp3Path;
+}
+
+void MainWindow::updatePlaybackRateActions(double rate)
+{
+    for (QAction *action : m_playbackRateGroup->actions()) {
+        if (qFuzzyCompare(action->data().toDouble(), rate)) {
+            action->setChecked(true);
+        }
     }
-    
-    return QString();
 }
 
+QString MainWindow::formatTime(qint64 milliseconds) const
+{
+    int seconds = milliseconds / 1000;
+    int minutes = seconds / 60;
+    seconds %= 60;
+    return QString("%1:%2").arg(minutes, 2, 10, QChar('0'))
+                          .arg(seconds, 2, 10, QChar('0'));
+}
@@ -21,9 +21,19 @@
 #include <QToolBar>
 #include <QGroupBox>
 #include <QScrollArea>
+#include <QActionGroup>
 #include "audioplayer.h"
 #include "databasemanager.h"
 #include "playlistmodel.h"
+#include "albummodel.h"
+#include "albumgridview.h"
+#include "coverthumbnailcache.h"
+#include "trackanalyzer.h"
+#include "waveformslider.h"
+#include "equalizerdialog.h"
+#include "diagnosticsdialog.h"
+#include "spectrumwidget.h"
+#include "playqueue.h"
 
 class MainWindow : public QMainWindow
 {
@@ -46,8 +56,10 @@ private slots:
     void onPositionChanged(qint64 position);
     void onDurationChanged(qint64 duration);
     void onStateChanged(QMediaPlayer::PlaybackState state);
+    void onTrackFinished();
     void onTrackChanged(const TrackInfo &track);
     void onTrackDoubleClicked(const QModelIndex &index);
+    void onAlbumDoubleClicked(const QModelIndex &index);
     void onSearchTextChanged(const QString &text);
     void onFilterChanged();
     void onPlaylistSelected(int index);
@@ -56,6 +68,13 @@ private slots:
     void onAddToPlaylist();
     void onRemoveFromPlaylist();
     void onShowHistory();
+    void onGaplessToggled(bool enabled);
+    void onPcmEngineToggled(bool enabled);
+    void onShowEqualizer();
+    void onShowDiagnostics();
+    void onAnalyzeLoudness();
+    void onLoudnessAnalysisProgress(int done, int total);
+    void onLoudnessAnalysisFinished();
     void onAddArtist();
     void onRemoveArtist();
     void onAddAlbum();
@@ -76,12 +95,17 @@ private:
     void updateTimeLabels();
     void updateAlbumCover();
     void updateAlbumCoverForTrack(const TrackInfo &track);
+    void updateWaveform(const TrackInfo &track);
     void loadPlaylists();
     void loadTracks();
     void loadHistory();
     void applyFilters();
+    TrackInfo autoAdvanceTrack();
+    void updateNextTrack();
+    void updatePlaybackRateActions(double rate);
+    void updateOutputDeviceMenu();
     QString formatTime(qint64 milliseconds) const;
-    QString convertMp4ToMp3(const QString &mp4Path);
+    void importFiles(const QStringList &files, const QString &messagePrefix);
     QWidget *m_centralWidget;
     QSplitter *m_mainSplitter;
     QSplitter *m_leftSplitter;
@@ -93,7 +117,9 @@ private:
     QPushButton *m_createPlaylistBtn;
     QPushButton *m_deletePlaylistBtn;
     QWidget *m_centerPanel;
+    QTabWidget *m_libraryTabs;
     QListView *m_trackList;
+    AlbumGridView *m_albumGrid;
     QLineEdit *m_searchEdit;
     QComboBox *m_artistFilter;
     QComboBox *m_albumFilter;
@@ -101,6 +127,7 @@ private:
     QPushButton *m_addToPlaylistBtn;
     QWidget *m_rightPanel;
     QLabel *m_albumCoverLabel;
+    SpectrumWidget *m_spectrumWidget;
     QLabel *m_trackInfoLabel;
     QWidget *m_controlsPanel;
     QPushButton *m_playPauseBtn;
@@ -109,7 +136,7 @@ private:
     QPushButton *m_nextBtn;
     QPushButton *m_shuffleBtn;
     QPushButton *m_repeatBtn;
-    QSlider *m_positionSlider;
+    WaveformSlider *m_positionSlider;
     QSlider *m_volumeSlider;
     QLabel *m_timeLabel;
     QLabel *m_volumeLabel;
@@ -117,15 +144,38 @@ private:
     AudioPlayer *m_audioPlayer;
     PlaylistModel *m_playlistModel;
     PlaylistModel *m_historyModel;
+    CoverThumbnailCache *m_coverThumbnails;
+    AlbumModel *m_albumModel;
+    TrackAnalyzer *m_trackAnalyzer;
+    EqualizerDialog *m_equalizerDialog;
+    DiagnosticsDialog *m_diagnosticsDialog;
     int m_currentPlaylistId;
-    int m_currentTrackIndex;
+    PlayQueue m_playQueue;
     bool m_shuffleEnabled;
     bool m_repeatEnabled;
     bool m_seeking;
+    bool m_importing;
     QAction *m_addFilesAction;
     QAction *m_addFolderAction;
     QAction *m_exitAction;
     QAction *m_showHistoryAction;
+    QAction *m_diagnosticsAction;
+    QAction *m_gaplessAction;
+    QAction *m_skipSilenceAction;
+    QAction *m_pcmEngineAction;
+    QAction *m_memoryMappedAction;
+    QAction *m_equalizerAction;
+    QAction *m_analyzeLoudnessAction;
+    QActionGroup *m_replayGainGroup;
+    QActionGroup *m_pcmCacheGroup;
+    QActionGroup *m_outputBufferGroup;
+    QActionGroup *m_resamplerQualityGroup;
+    QMenu *m_crossfadeMenu;
+    QActionGroup *m_crossfadeGroup;
+    QActionGroup *m_crossfadeCurveGroup;
+    QActionGroup *m_playbackRateGroup;
+    QMenu *m_outputDeviceMenu;
+    QActionGroup *m_outputDeviceGroup;
 };
 
 #endif
@@ -0,0 +1,158 @@
+#include "mappedfile.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWeakPointer>
+#include <atomic>
+#include <cstring>
+
+#if defined(Q_OS_UNIX)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::atomic<bool> &enabledFlag()
+{
+    static std::atomic<bool> enabled{false};
+    return enabled;
+}
+
+QMutex &registryMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+QHash<QString, QWeakPointer<MappedFile>> &registry()
+{
+    static QHash<QString, QWeakPointer<MappedFile>> files;
+    return files;
+}
+
+}
+
+MappedFile::MappedFile(const QString &filePath)
+    : m_file(filePath)
+    , m_data(nullptr)
+    , m_size(0)
+    , m_modified(0)
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    m_size = m_file.size();
+    m_modified = QFileInfo(m_file).lastModified().toMSecsSinceEpoch();
+    if (m_size > 0) {
+        m_data = m_file.map(0, m_size);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data) {
+        m_file.unmap(m_data);
+    }
+}
+
+QSharedPointer<MappedFile> MappedFile::acquire(const QString &filePath)
+{
+    const QString key = QFileInfo(filePath).absoluteFilePath();
+    QMutexLocker locker(&registryMutex());
+    QSharedPointer<MappedFile> file = registry().value(key).toStrongRef();
+    if (file) {
+        QFileInfo info(key);
+        // A file replaced on disk gets a fresh mapping.
+        if (info.size() == file->m_size && info.lastModified().toMSecsSinceEpoch() == file->m_modified) {
+            return file;
+        }
+    }
+    file = QSharedPointer<MappedFile>(new MappedFile(key));
+    if (!file->m_data) {
+        qWarning() << "Не удалось отобразить файл в память:" << key;
+        return QSharedPointer<MappedFile>();
+    }
+    registry().insert(key, file);
+    // Forget mappings nobody holds any more.
+    for (auto it = registry().begin(); it != registry().end(); ) {
+        if (it.value().isNull()) {
+            it = registry().erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return file;
+}
+
+void MappedFile::setEnabled(bool enabled)
+{
+    enabledFlag().store(enabled, std::memory_order_relaxed);
+}
+
+bool MappedFile::isEnabled()
+{
+    return enabledFlag().load(std::memory_order_relaxed);
+}
+
+void MappedFile::willNeed(qint64 offset, qint64 length) const
+{
+    if (!m_data || offset >= m_size) {
+        return;
+    }
+    length = qMin(length, m_size - offset);
+#if defined(Q_OS_UNIX)
+    const qint64 pageSize = sysconf(_SC_PAGESIZE);
+    // madvise wants a page-aligned start.
+    const qint64 aligned = offset - offset % pageSize;
+    madvise(m_data + aligned, static_cast<size_t>(length + offset - aligned), MADV_WILLNEED);
+#else
+    const qint64 pageSize = 4096;
+#endif
+    // Touch every page so the range is resident even where the hint is ignored.
+    volatile uchar sink = 0;
+    for (qint64 position = offset; position < offset + length; position += pageSize) {
+        sink = sink + m_data[position];
+    }
+}
+
+MappedFileDevice::MappedFileDevice(const QSharedPointer<MappedFile> &file, qint64 offset, QObject *parent)
+    : QIODevice(parent)
+    , m_file(file)
+    , m_offset(qMax<qint64>(0, offset))
+{
+}
+
+bool MappedFileDevice::open(OpenMode mode)
+{
+    if ((mode & WriteOnly) || !m_file || m_offset > m_file->size()) {
+        return false;
+    }
+    return QIODevice::open(mode | Unbuffered);
+}
+
+qint64 MappedFileDevice::size() const
+{
+    return m_file ? m_file->size() - m_offset : 0;
+}
+
+qint64 MappedFileDevice::readData(char *data, qint64 maxSize)
+{
+    const qint64 available = size() - pos();
+    if (available <= 0) {
+        return 0;
+    }
+    const qint64 count = qMin(maxSize, available);
+    std::memcpy(data, m_file->data() + m_offset + pos(), static_cast<size_t>(count));
+    return count;
+}
+
+qint64 MappedFileDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data)
+    Q_UNUSED(maxSize)
+    return -1;
+}
@@ -0,0 +1,61 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <QFile>
+#include <QIODevice>
+#include <QSharedPointer>
+#include <QString>
+
+// Read-only mapping of a whole file. Everything that reads the same file
+// while one of them still holds it - player, decoder, tag reader, waveform
+// extractor, prefetcher - gets the same mapping, so the file is opened and
+// paged in once.
+class MappedFile
+{
+public:
+    ~MappedFile();
+
+    static QSharedPointer<MappedFile> acquire(const QString &filePath);
+
+    // Whether playback and analysis read through mappings instead of
+    // opening files themselves. Off by default.
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    const uchar *data() const { return m_data; }
+    qint64 size() const { return m_size; }
+    QString filePath() const { return m_file.fileName(); }
+    void willNeed(qint64 offset, qint64 length) const;
+
+private:
+    explicit MappedFile(const QString &filePath);
+
+    QFile m_file;
+    uchar *m_data;
+    qint64 m_size;
+    qint64 m_modified;
+};
+
+// Presents a mapping from a byte offset to its end as a device starting at
+// position 0; reads are copies straight out of the page cache.
+class MappedFileDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    MappedFileDevice(const QSharedPointer<MappedFile> &file, qint64 offset = 0, QObject *parent = nullptr);
+
+    bool open(OpenMode mode) override;
+    bool isSequential() const override { return false; }
+    qint64 size() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    QSharedPointer<MappedFile> m_file;
+    qint64 m_offset;
+};
+
+#endif
@@ -0,0 +1,322 @@
+#include "mp3seekindex.h"
+#include "backgroundscheduler.h"
+#include "mappedfile.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <cstring>
+
+static const quint32 kSeekFileMagic = 0x41534b31;
+static const quint16 kSeekFileVersion = 1;
+// Decoder delay of the MPEG Layer III synthesis filterbank, which decoders
+// skip together with the encoder delay from the LAME tag.
+static const int kDecoderDelay = 529;
+
+namespace {
+
+struct FrameHeader {
+    int version;        // 1 = MPEG 1, 2 = MPEG 2, 3 = MPEG 2.5
+    int sampleRate;
+    int samplesPerFrame;
+    int length;
+    bool mono;
+};
+
+bool parseHeader(const uchar *data, FrameHeader &header)
+{
+    static const int kBitratesV1[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, -1};
+    static const int kBitratesV2[16] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, -1};
+    static const int kSampleRates[4] = {44100, 48000, 32000, -1};
+
+    if (data[0] != 0xFF || (data[1] & 0xE0) != 0xE0) {
+        return false;
+    }
+    const int versionBits = (data[1] >> 3) & 0x03;
+    const int layerBits = (data[1] >> 1) & 0x03;
+    const int bitrateIndex = (data[2] >> 4) & 0x0F;
+    const int sampleRateIndex = (data[2] >> 2) & 0x03;
+    const int padding = (data[2] >> 1) & 0x01;
+    // Layer III only; free-format streams have no computable frame length.
+    if (versionBits == 1 || layerBits != 1 || bitrateIndex == 0 || bitrateIndex == 15 || sampleRateIndex == 3) {
+        return false;
+    }
+    header.version = versionBits == 3 ? 1 : (versionBits == 2 ? 2 : 3);
+    header.sampleRate = kSampleRates[sampleRateIndex] >> (header.version - 1);
+    header.samplesPerFrame = header.version == 1 ? 1152 : 576;
+    const int bitrate = (header.version == 1 ? kBitratesV1 : kBitratesV2)[bitrateIndex] * 1000;
+    header.length = (header.samplesPerFrame / 8) * bitrate / header.sampleRate + padding;
+    header.mono = ((data[3] >> 6) & 0x03) == 3;
+    return header.length > 4;
+}
+
+bool sameStream(const FrameHeader &a, const FrameHeader &b)
+{
+    return a.version == b.version && a.sampleRate == b.sampleRate;
+}
+
+qint64 id3v2Size(const uchar *data, qint64 size)
+{
+    if (size < 10 || std::memcmp(data, "ID3", 3) != 0) {
+        return 0;
+    }
+    qint64 tagSize = (qint64(data[6] & 0x7F) << 21) | (qint64(data[7] & 0x7F) << 14)
+        | (qint64(data[8] & 0x7F) << 7) | qint64(data[9] & 0x7F);
+    return 10 + tagSize + ((data[5] & 0x10) ? 10 : 0);
+}
+
+// Locks on to the first header that is followed by a matching one.
+qint64 findFirstFrame(const uchar *data, qint64 size, FrameHeader &first)
+{
+    qint64 offset = id3v2Size(data, size);
+    for (; offset + 4 <= size; ++offset) {
+        FrameHeader next;
+        if (parseHeader(data + offset, first)
+            && offset + first.length + 4 <= size
+            && parseHeader(data + offset + first.length, next)
+            && sameStream(first, next)) {
+            return offset;
+        }
+    }
+    return -1;
+}
+
+quint32 readBigEndian32(const uchar *data)
+{
+    return (quint32(data[0]) << 24) | (quint32(data[1]) << 16) | (quint32(data[2]) << 8) | quint32(data[3]);
+}
+
+QMutex &pendingMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+QSet<QString> &pendingBuilds()
+{
+    static QSet<QString> pending;
+    return pending;
+}
+
+}
+
+Mp3SeekIndex::Mp3SeekIndex()
+    : m_sampleRate(0)
+    , m_samplesPerFrame(0)
+    , m_skipSamples(0)
+    , m_paddingSamples(0)
+    , m_frameCount(0)
+{
+}
+
+qint64 Mp3SeekIndex::totalSamples() const
+{
+    return qMax<qint64>(0, m_frameCount * m_samplesPerFrame - m_skipSamples - m_paddingSamples);
+}
+
+bool Mp3SeekIndex::locate(qint64 sample, qint64 *byteOffset, qint64 *firstSample) const
+{
+    if (!isValid() || sample < 0) {
+        return false;
+    }
+    qint64 frame = (sample + m_skipSamples) / m_samplesPerFrame;
+    if (frame >= m_frameCount) {
+        return false;
+    }
+    frame = qMax<qint64>(0, frame - PrerollFrames);
+    const qint64 checkpoint = frame / CheckpointInterval;
+    *byteOffset = m_checkpoints[static_cast<size_t>(checkpoint)];
+    *firstSample = checkpoint * CheckpointInterval * m_samplesPerFrame - m_skipSamples;
+    return true;
+}
+
+bool Mp3SeekIndex::isSupported(const QString &filePath)
+{
+    return QFileInfo(filePath).suffix().compare("mp3", Qt::CaseInsensitive) == 0;
+}
+
+Mp3SeekIndex Mp3SeekIndex::build(const QString &filePath)
+{
+    Mp3SeekIndex index;
+    QSharedPointer<MappedFile> mapping = MappedFile::acquire(filePath);
+    if (!mapping) {
+        return index;
+    }
+    const qint64 size = mapping->size();
+    const uchar *data = mapping->data();
+
+    FrameHeader first = {};
+    qint64 offset = findFirstFrame(data, size, first);
+    if (offset < 0) {
+        return index;
+    }
+    index.m_sampleRate = first.sampleRate;
+    index.m_samplesPerFrame = first.samplesPerFrame;
+
+    // A Xing/Info or VBRI frame carries no audio; decoders skip it.
+    const int sideInfo = first.version == 1 ? (first.mono ? 17 : 32) : (first.mono ? 9 : 17);
+    const uchar *xing = data + offset + 4 + sideInfo;
+    if (offset + 4 + sideInfo + 8 <= size
+        && (std::memcmp(xing, "Xing", 4) == 0 || std::memcmp(xing, "Info", 4) == 0)) {
+        const quint32 flags = readBigEndian32(xing + 4);
+        qint64 lame = 8 + ((flags & 1) ? 4 : 0) + ((flags & 2) ? 4 : 0) + ((flags & 4) ? 100 : 0) + ((flags & 8) ? 4 : 0);
+        const uchar *tag = xing + lame;
+        if (4 + sideInfo + lame + 24 <= first.length && std::memcmp(tag, "LAME", 4) == 0) {
+            index.m_skipSamples = ((tag[21] << 4) | (tag[22] >> 4)) + kDecoderDelay;
+            index.m_paddingSamples = ((tag[22] & 0x0F) << 8) | tag[23];
+        }
+        offset += first.length;
+    } else if (offset + 36 + 4 <= size && std::memcmp(data + offset + 36, "VBRI", 4) == 0) {
+        offset += first.length;
+    }
+
+    while (offset + 4 <= size) {
+        FrameHeader header;
+        if (!parseHeader(data + offset, header) || !sameStream(first, header)) {
+            // Junk or a trailing tag: look for the next header that checks out.
+            qint64 resync = offset + 1;
+            for (; resync + 4 <= size; ++resync) {
+                FrameHeader next;
+                if (parseHeader(data + resync, header) && sameStream(first, header)
+                    && (resync + header.length + 4 > size
+                        || (parseHeader(data + resync + header.length, next) && sameStream(first, next)))) {
+                    break;
+                }
+            }
+            if (resync + 4 > size) {
+                break;
+            }
+            offset = resync;
+        }
+        if (offset + header.length > size) {
+            break;
+        }
+        if (index.m_frameCount % CheckpointInterval == 0) {
+            index.m_checkpoints.push_back(offset);
+        }
+        ++index.m_frameCount;
+        offset += header.length;
+    }
+    return index;
+}
+
+int Mp3SeekIndex::probeSampleRate(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    const QByteArray tag = file.read(10);
+    // Past the tag, two frames are enough to lock on.
+    if (!file.seek(id3v2Size(reinterpret_cast<const uchar *>(tag.constData()), tag.size()))) {
+        return 0;
+    }
+    const QByteArray head = file.read(16 * 1024);
+    FrameHeader first = {};
+    if (findFirstFrame(reinterpret_cast<const uchar *>(head.constData()), head.size(), first) < 0) {
+        return 0;
+    }
+    return first.sampleRate;
+}
+
+QString Mp3SeekIndex::indexFilePath(const QString &filePath)
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/seek";
+    QByteArray hash = QCryptographicHash::hash(QFileInfo(filePath).absoluteFilePath().toUtf8(),
+                                               QCryptographicHash::Sha1).toHex();
+    return dir + "/" + QString::fromLatin1(hash) + ".seek";
+}
+
+bool Mp3SeekIndex::save(const QString &indexPath, const QString &sourcePath) const
+{
+    QFileInfo source(sourcePath);
+    QDir().mkpath(QFileInfo(indexPath).absolutePath());
+    QSaveFile file(indexPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream << kSeekFileMagic << kSeekFileVersion
+           << source.size() << source.lastModified().toMSecsSinceEpoch()
+           << qint32(m_sampleRate) << qint32(m_samplesPerFrame) << m_skipSamples << m_paddingSamples
+           << m_frameCount << quint32(m_checkpoints.size());
+    for (qint64 checkpoint : m_checkpoints) {
+        stream << checkpoint;
+    }
+    return file.commit();
+}
+
+bool Mp3SeekIndex::load(const QString &indexPath, const QString &sourcePath, Mp3SeekIndex &index)
+{
+    QFile file(indexPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    quint32 magic = 0;
+    quint16 version = 0;
+    qint64 sourceSize = 0;
+    qint64 sourceModified = 0;
+    stream >> magic >> version >> sourceSize >> sourceModified;
+    QFileInfo source(sourcePath);
+    if (magic != kSeekFileMagic || version != kSeekFileVersion
+        || sourceSize != source.size() || sourceModified != source.lastModified().toMSecsSinceEpoch()) {
+        return false;
+    }
+    Mp3SeekIndex loaded;
+    qint32 sampleRate = 0;
+    qint32 samplesPerFrame = 0;
+    quint32 checkpointCount = 0;
+    stream >> sampleRate >> samplesPerFrame >> loaded.m_skipSamples >> loaded.m_paddingSamples
+           >> loaded.m_frameCount >> checkpointCount;
+    const quint64 expected = (quint64(qMax<qint64>(0, loaded.m_frameCount)) + CheckpointInterval - 1) / CheckpointInterval;
+    if (stream.status() != QDataStream::Ok || sampleRate <= 0 || samplesPerFrame <= 0 || checkpointCount != expected) {
+        return false;
+    }
+    loaded.m_sampleRate = sampleRate;
+    loaded.m_samplesPerFrame = samplesPerFrame;
+    loaded.m_checkpoints.resize(checkpointCount);
+    for (qint64 &checkpoint : loaded.m_checkpoints) {
+        stream >> checkpoint;
+    }
+    if (stream.status() != QDataStream::Ok) {
+        return false;
+    }
+    index = std::move(loaded);
+    return true;
+}
+
+bool Mp3SeekIndex::ensure(const QString &filePath)
+{
+    const QString indexPath = indexFilePath(filePath);
+    Mp3SeekIndex index;
+    if (load(indexPath, filePath, index)) {
+        return true;
+    }
+    index = build(filePath);
+    return index.isValid() && index.save(indexPath, filePath);
+}
+
+void Mp3SeekIndex::ensureAsync(const QString &filePath)
+{
+    {
+        QMutexLocker locker(&pendingMutex());
+        if (pendingBuilds().contains(filePath)) {
+            return;
+        }
+        pendingBuilds().insert(filePath);
+    }
+    BackgroundScheduler::instance()->start(BackgroundScheduler::Normal, [filePath]() {
+        ensure(filePath);
+        QMutexLocker locker(&pendingMutex());
+        pendingBuilds().remove(filePath);
+    });
+}
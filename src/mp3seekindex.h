@@ -0,0 +1,50 @@
+#ifndef MP3SEEKINDEX_H
+#define MP3SEEKINDEX_H
+
+#include <QString>
+#include <vector>
+
+// Byte offsets of MPEG Layer III frames, gathered once by walking the frame
+// headers and stored per file. Every MPEG frame carries the same number of
+// samples, so the frame for a sample position is found directly; only every
+// CheckpointInterval-th offset is kept to keep the table compact.
+class Mp3SeekIndex
+{
+public:
+    static const int CheckpointInterval = 8;
+    // Frames decoded and thrown away before the target so the bit reservoir
+    // and the MDCT overlap are filled again.
+    static const int PrerollFrames = 8;
+
+    Mp3SeekIndex();
+
+    bool isValid() const { return m_frameCount > 0; }
+    int sampleRate() const { return m_sampleRate; }
+    // Playable samples, with encoder delay and padding removed.
+    qint64 totalSamples() const;
+    // Where to start decoding to reach sample (at the source rate) and which
+    // sample the first decoded frame corresponds to; the latter may be
+    // negative while the encoder delay is still being skipped.
+    bool locate(qint64 sample, qint64 *byteOffset, qint64 *firstSample) const;
+
+    static bool isSupported(const QString &filePath);
+    static Mp3SeekIndex build(const QString &filePath);
+    // Sample rate from the first frame headers, or 0.
+    static int probeSampleRate(const QString &filePath);
+    static QString indexFilePath(const QString &filePath);
+    bool save(const QString &indexPath, const QString &sourcePath) const;
+    static bool load(const QString &indexPath, const QString &sourcePath, Mp3SeekIndex &index);
+    // Builds and stores the index unless an up-to-date one exists.
+    static bool ensure(const QString &filePath);
+    static void ensureAsync(const QString &filePath);
+
+private:
+    int m_sampleRate;
+    int m_samplesPerFrame;
+    qint32 m_skipSamples;
+    qint32 m_paddingSamples;
+    qint64 m_frameCount;
+    std::vector<qint64> m_checkpoints;
+};
+
+#endif
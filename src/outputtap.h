@@ -0,0 +1,46 @@
+#ifndef OUTPUTTAP_H
+#define OUTPUTTAP_H
+
+#include <atomic>
+#include "audioprocessor.h"
+#include "spscringbuffer.h"
+
+// Last stage of the PCM engine chain: copies what goes to the device into a
+// ring for visualisation. Never blocks the audio thread; if the reader falls
+// behind the newest samples are dropped.
+class OutputTap : public AudioProcessor
+{
+public:
+    static const int Channels = 2;
+
+    OutputTap()
+        : m_ring(1 << 15)
+        , m_sampleRate(0)
+    {
+    }
+
+    void prepare(int sampleRate, int channels) override
+    {
+        (void)channels;
+        m_sampleRate.store(sampleRate, std::memory_order_release);
+    }
+
+    void process(float *interleaved, int frames, int channels) override
+    {
+        if (channels != Channels) {
+            return;
+        }
+        // Whole frames only, so the reader never loses channel alignment.
+        size_t writable = m_ring.availableWrite() / Channels * Channels;
+        m_ring.write(interleaved, std::min(writable, static_cast<size_t>(frames) * Channels));
+    }
+
+    int sampleRate() const { return m_sampleRate.load(std::memory_order_acquire); }
+    SpscRingBuffer<float> &ring() { return m_ring; }
+
+private:
+    SpscRingBuffer<float> m_ring;
+    std::atomic<int> m_sampleRate;
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include "pcmcache.h"
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cstring>
+
+PcmCache::PcmCache(qint64 capacityBytes)
+    : m_capacity(qMax<qint64>(0, capacityBytes))
+    , m_bytes(0)
+    , m_useCounter(0)
+{
+}
+
+void PcmCache::setCapacity(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_capacity = qMax<qint64>(0, bytes);
+    shrinkTo(m_capacity, QString());
+}
+
+qint64 PcmCache::capacity() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_capacity;
+}
+
+qint64 PcmCache::size() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bytes;
+}
+
+void PcmCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+    m_bytes = 0;
+}
+
+PcmCache::Entry *PcmCache::findEntry(const QString &filePath, int sampleRate)
+{
+    auto it = m_entries.find(filePath);
+    if (it == m_entries.end()) {
+        return nullptr;
+    }
+    if (it->sampleRate != sampleRate) {
+        return nullptr;
+    }
+    it->lastUse = ++m_useCounter;
+    return &it.value();
+}
+
+void PcmCache::removeEntry(const QString &filePath)
+{
+    auto it = m_entries.find(filePath);
+    if (it == m_entries.end()) {
+        return;
+    }
+    m_bytes -= qint64(it->chunks.size()) * chunkBytes();
+    m_entries.erase(it);
+}
+
+bool PcmCache::evictOne(const QString &keep)
+{
+    QString oldest;
+    quint64 oldestUse = 0;
+    bool found = false;
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        if (it.key() != keep && (!found || it->lastUse < oldestUse)) {
+            oldest = it.key();
+            oldestUse = it->lastUse;
+            found = true;
+        }
+    }
+    if (found) {
+        removeEntry(oldest);
+    }
+    return found;
+}
+
+void PcmCache::shrinkTo(qint64 bytes, const QString &keep)
+{
+    while (m_bytes > bytes && evictOne(keep)) {
+    }
+    if (m_bytes > bytes) {
+        removeEntry(keep);
+    }
+}
+
+bool PcmCache::lookup(const QString &filePath, int sampleRate, qint64 *frames, bool *complete)
+{
+    QMutexLocker locker(&m_mutex);
+    Entry *entry = findEntry(filePath, sampleRate);
+    if (!entry) {
+        return false;
+    }
+    if (QFileInfo(filePath).lastModified() != entry->modified) {
+        removeEntry(filePath);
+        return false;
+    }
+    *frames = entry->frames;
+    *complete = entry->complete;
+    return entry->frames > 0;
+}
+
+qint64 PcmCache::read(const QString &filePath, int sampleRate, qint64 frame, float *destination, qint64 frames)
+{
+    QMutexLocker locker(&m_mutex);
+    Entry *entry = findEntry(filePath, sampleRate);
+    if (!entry || frame < 0 || frame >= entry->frames) {
+        return 0;
+    }
+    frames = qMin(frames, entry->frames - frame);
+    qint64 copied = 0;
+    while (copied < frames) {
+        qint64 position = frame + copied;
+        const std::vector<float> &chunk = entry->chunks[static_cast<size_t>(position / ChunkFrames)];
+        qint64 offset = position % ChunkFrames;
+        qint64 count = qMin(frames - copied, ChunkFrames - offset);
+        std::memcpy(destination + copied * Channels, chunk.data() + offset * Channels,
+                    static_cast<size_t>(count) * Channels * sizeof(float));
+        copied += count;
+    }
+    return copied;
+}
+
+bool PcmCache::append(const QString &filePath, int sampleRate, qint64 atFrame, const float *source, qint64 frames)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_capacity < chunkBytes()) {
+        return false;
+    }
+    Entry *entry = findEntry(filePath, sampleRate);
+    if (!entry) {
+        if (atFrame != 0) {
+            return false;
+        }
+        removeEntry(filePath);
+        Entry created;
+        created.sampleRate = sampleRate;
+        created.modified = QFileInfo(filePath).lastModified();
+        created.lastUse = ++m_useCounter;
+        entry = &m_entries.insert(filePath, created).value();
+    }
+    if (entry->complete || entry->frames != atFrame) {
+        return false;
+    }
+    qint64 written = 0;
+    while (written < frames) {
+        qint64 offset = entry->frames % ChunkFrames;
+        if (offset == 0 && entry->frames / ChunkFrames == qint64(entry->chunks.size())) {
+            if (m_bytes + chunkBytes() > m_capacity) {
+                while (m_bytes + chunkBytes() > m_capacity && evictOne(filePath)) {
+                }
+                if (m_bytes + chunkBytes() > m_capacity) {
+                    return false;
+                }
+                // Erasing from the hash may have moved the entry.
+                entry = findEntry(filePath, sampleRate);
+            }
+            entry->chunks.emplace_back(static_cast<size_t>(ChunkFrames) * Channels);
+            m_bytes += chunkBytes();
+        }
+        qint64 count = qMin(frames - written, ChunkFrames - offset);
+        std::memcpy(entry->chunks.back().data() + offset * Channels, source + written * Channels,
+                    static_cast<size_t>(count) * Channels * sizeof(float));
+        entry->frames += count;
+        written += count;
+    }
+    return true;
+}
+
+void PcmCache::markComplete(const QString &filePath, int sampleRate, qint64 totalFrames)
+{
+    QMutexLocker locker(&m_mutex);
+    Entry *entry = findEntry(filePath, sampleRate);
+    if (entry && entry->frames == totalFrames) {
+        entry->complete = true;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef PCMCACHE_H
+#define PCMCACHE_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <vector>
+
+// Memory-bounded cache of decoded stereo float PCM, keyed by file path. Each
+// entry holds a contiguous prefix of the track starting at frame 0, so
+// restarts, repeats and seeks back within the prefix need no decoding. The
+// least recently used entries are evicted once the byte cap is reached.
+// Thread-safe.
+class PcmCache
+{
+public:
+    static const int Channels = 2;
+    static const int ChunkFrames = 32768;
+
+    explicit PcmCache(qint64 capacityBytes = 0);
+
+    void setCapacity(qint64 bytes);
+    qint64 capacity() const;
+    qint64 size() const;
+    void clear();
+
+    // Returns false if nothing usable is cached for the file at this rate.
+    bool lookup(const QString &filePath, int sampleRate, qint64 *frames, bool *complete);
+    // Copies up to frames frames starting at frame; returns how many were copied.
+    qint64 read(const QString &filePath, int sampleRate, qint64 frame, float *destination, qint64 frames);
+    // Extends the entry, which must currently end at atFrame (0 creates it).
+    // Returns false once the data no longer fits, the entry keeps what did.
+    bool append(const QString &filePath, int sampleRate, qint64 atFrame, const float *source, qint64 frames);
+    void markComplete(const QString &filePath, int sampleRate, qint64 totalFrames);
+
+private:
+    struct Entry {
+        int sampleRate = 0;
+        qint64 frames = 0;
+        bool complete = false;
+        quint64 lastUse = 0;
+        QDateTime modified;
+        std::vector<std::vector<float>> chunks;
+    };
+
+    static qint64 chunkBytes() { return qint64(ChunkFrames) * Channels * sizeof(float); }
+    Entry *findEntry(const QString &filePath, int sampleRate);
+    void removeEntry(const QString &filePath);
+    bool evictOne(const QString &keep);
+    void shrinkTo(qint64 bytes, const QString &keep);
+
+    mutable QMutex m_mutex;
+    QHash<QString, Entry> m_entries;
+    qint64 m_capacity;
+    qint64 m_bytes;
+    quint64 m_useCounter;
+};
+
+#endif
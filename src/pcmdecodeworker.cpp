@@ -0,0 +1,416 @@
+#include "pcmdecodeworker.h"
+#include "filerangedevice.h"
+#include "mappedfile.h"
+#include <QAudioBuffer>
+#include <QUrl>
+#include <algorithm>
+#include <cstring>
+
+// Largest block copied from the cache into the ring per step.
+static const qint64 kReplayChunkFrames = 8192;
+
+PcmDecodeWorker::PcmDecodeWorker(PcmDeck *deck, PcmCache *cache, QObject *parent)
+    : QObject(parent)
+    , m_deck(deck)
+    , m_cache(cache)
+    , m_decoder(nullptr)
+    , m_pumpTimer(nullptr)
+    , m_sourceDevice(nullptr)
+    , m_indexedDuration(false)
+    , m_carryOffset(0)
+    , m_resamplerQuality(Resampler::Standard)
+    , m_resampling(false)
+    , m_skipUntilFrame(0)
+    , m_decodedFrames(0)
+    , m_cacheFrame(0)
+    , m_cacheEnd(0)
+    , m_recordFrame(0)
+    , m_recording(false)
+    , m_requestId(0)
+    , m_active(false)
+    , m_finished(false)
+    , m_primed(false)
+{
+}
+
+PcmDecodeWorker::~PcmDecodeWorker()
+{
+    if (m_decoder) {
+        m_decoder->stop();
+    }
+}
+
+void PcmDecodeWorker::ensureDecoder()
+{
+    if (m_decoder) {
+        return;
+    }
+    m_decoder = new QAudioDecoder(this);
+    m_pumpTimer = new QTimer(this);
+    m_pumpTimer->setSingleShot(true);
+    m_pumpTimer->setInterval(5);
+    connect(m_pumpTimer, &QTimer::timeout, this, &PcmDecodeWorker::pump);
+    connect(m_decoder, &QAudioDecoder::bufferReady, this, &PcmDecodeWorker::pump);
+    connect(m_decoder, &QAudioDecoder::finished, this, &PcmDecodeWorker::onDecoderFinished);
+    connect(m_decoder, &QAudioDecoder::durationChanged, this, &PcmDecodeWorker::onDecoderDurationChanged);
+    connect(m_decoder, QOverload<QAudioDecoder::Error>::of(&QAudioDecoder::error),
+            this, &PcmDecodeWorker::onDecoderError);
+}
+
+void PcmDecodeWorker::load(const QString &filePath, const QAudioFormat &format, qint64 startMs, quint64 requestId)
+{
+    ensureDecoder();
+    m_decoder->stop();
+    m_pumpTimer->stop();
+    m_format = format;
+    m_filePath = filePath;
+    m_requestId = requestId;
+    m_active = true;
+    m_finished = false;
+    m_primed = false;
+    m_carry.clear();
+    m_carryOffset = 0;
+    m_deck->totalFrames.store(-1, std::memory_order_relaxed);
+    const qint64 startFrame = qMax<qint64>(0, startMs) * format.sampleRate() / 1000;
+    beginEpoch(startFrame);
+    if (m_seekIndexPath != filePath) {
+        ensureSeekIndex();
+    }
+
+    qint64 cachedFrames = 0;
+    bool complete = false;
+    bool cached = m_cache && m_cache->lookup(filePath, format.sampleRate(), &cachedFrames, &complete);
+    m_cacheFrame = startFrame;
+    m_cacheEnd = cached && startFrame < cachedFrames ? cachedFrames : startFrame;
+    m_recordFrame = cached ? cachedFrames : 0;
+    m_recording = m_cache && !complete;
+
+    if (cached && complete && startFrame < cachedFrames) {
+        m_finished = true;
+        m_deck->totalFrames.store(cachedFrames, std::memory_order_relaxed);
+        emit durationChanged(requestId, cachedFrames * 1000 / format.sampleRate());
+    } else {
+        startDecoder(qMax(startFrame, m_cacheEnd));
+    }
+    pump();
+}
+
+void PcmDecodeWorker::startDecoder(qint64 skipFrames)
+{
+    m_decoder->stop();
+    m_finished = false;
+    m_decodedFrames = 0;
+    m_skipUntilFrame = skipFrames;
+    m_indexedDuration = false;
+    m_resampler.reset();
+    m_resampling = false;
+    // An unset format makes the decoder deliver the file's native one.
+    m_decoder->setAudioFormat(QAudioFormat());
+    QIODevice *previousDevice = m_sourceDevice;
+    m_sourceDevice = nullptr;
+    if (!(skipFrames > 0 && openIndexedSource(skipFrames)) && MappedFile::isEnabled()) {
+        m_sourceDevice = openSourceDevice(0);
+    }
+    if (m_sourceDevice) {
+        m_decoder->setSourceDevice(m_sourceDevice);
+    } else {
+        m_decoder->setSource(QUrl::fromLocalFile(m_filePath));
+    }
+    delete previousDevice;
+    m_decoder->start();
+}
+
+bool PcmDecodeWorker::ensureSeekIndex()
+{
+    if (m_seekIndexPath == m_filePath && m_seekIndex.isValid()) {
+        return true;
+    }
+    m_seekIndexPath = m_filePath;
+    m_seekIndex = Mp3SeekIndex();
+    if (!Mp3SeekIndex::isSupported(m_filePath)) {
+        return false;
+    }
+    if (Mp3SeekIndex::load(Mp3SeekIndex::indexFilePath(m_filePath), m_filePath, m_seekIndex)) {
+        return true;
+    }
+    // First play: build it in the background for later seeks.
+    Mp3SeekIndex::ensureAsync(m_filePath);
+    return false;
+}
+
+QIODevice *PcmDecodeWorker::openSourceDevice(qint64 byteOffset)
+{
+    QIODevice *device = nullptr;
+    if (MappedFile::isEnabled()) {
+        QSharedPointer<MappedFile> mapping = MappedFile::acquire(m_filePath);
+        if (mapping) {
+            device = new MappedFileDevice(mapping, byteOffset, this);
+        }
+    }
+    if (!device) {
+        device = new FileRangeDevice(m_filePath, byteOffset, this);
+    }
+    if (!device->open(QIODevice::ReadOnly)) {
+        delete device;
+        return nullptr;
+    }
+    return device;
+}
+
+bool PcmDecodeWorker::openIndexedSource(qint64 skipFrames)
+{
+    if (!ensureSeekIndex()) {
+        return false;
+    }
+    const int sourceRate = m_seekIndex.sampleRate();
+    const int outputRate = m_format.sampleRate();
+    qint64 byteOffset = 0;
+    qint64 firstSample = 0;
+    if (!m_seekIndex.locate(skipFrames * sourceRate / outputRate, &byteOffset, &firstSample) || firstSample <= 0) {
+        return false;
+    }
+    m_sourceDevice = openSourceDevice(byteOffset);
+    if (!m_sourceDevice) {
+        return false;
+    }
+    // The decoder only sees the tail of the file, so positions and the
+    // duration come from the index.
+    m_decodedFrames = firstSample * outputRate / sourceRate;
+    m_indexedDuration = true;
+    const qint64 totalSamples = m_seekIndex.totalSamples();
+    m_deck->totalFrames.store(totalSamples * outputRate / sourceRate, std::memory_order_relaxed);
+    emit durationChanged(m_requestId, totalSamples * 1000 / sourceRate);
+    return true;
+}
+
+void PcmDecodeWorker::unload()
+{
+    m_active = false;
+    if (m_decoder) {
+        m_decoder->stop();
+        m_pumpTimer->stop();
+    }
+    m_recording = false;
+    m_cacheFrame = m_cacheEnd = 0;
+    m_carry.clear();
+    m_carryOffset = 0;
+    m_deck->totalFrames.store(-1, std::memory_order_relaxed);
+    beginEpoch(0);
+}
+
+void PcmDecodeWorker::beginEpoch(qint64 baseFrame)
+{
+    m_deck->endEpoch.store(0, std::memory_order_relaxed);
+    m_deck->epochBaseFrame.store(baseFrame, std::memory_order_relaxed);
+    m_deck->epochStartIndex.store(m_deck->ring.writeIndex(), std::memory_order_relaxed);
+    m_deck->epoch.fetch_add(1, std::memory_order_release);
+}
+
+void PcmDecodeWorker::pump()
+{
+    if (!m_active) {
+        return;
+    }
+    if (!flushCarry() || !replayCache()) {
+        m_pumpTimer->start();
+        return;
+    }
+    while (m_decoder->bufferAvailable()) {
+        QAudioBuffer buffer = m_decoder->read();
+        if (!buffer.isValid()) {
+            break;
+        }
+        convertBuffer(buffer);
+        if (!flushCarry()) {
+            m_pumpTimer->start();
+            return;
+        }
+    }
+    if (m_finished) {
+        if (m_resampling) {
+            m_resampling = false;
+            m_carry.clear();
+            m_carryOffset = 0;
+            m_resampler.flush(m_carry);
+            commitCarry();
+            if (!flushCarry()) {
+                m_pumpTimer->start();
+                return;
+            }
+        }
+        markEndOfStream();
+    }
+}
+
+bool PcmDecodeWorker::replayCache()
+{
+    while (m_cacheFrame < m_cacheEnd) {
+        qint64 writable = static_cast<qint64>(m_deck->ring.availableWrite() / Channels);
+        if (writable == 0) {
+            return false;
+        }
+        qint64 frames = qMin(m_cacheEnd - m_cacheFrame, qMin(writable, kReplayChunkFrames));
+        m_carry.resize(static_cast<size_t>(frames) * Channels);
+        qint64 got = m_cache->read(m_filePath, m_format.sampleRate(), m_cacheFrame, m_carry.data(), frames);
+        if (got <= 0) {
+            // Evicted while replaying: decode the rest from here.
+            m_cacheEnd = m_cacheFrame;
+            m_recordFrame = 0;
+            m_recording = true;
+            startDecoder(m_cacheFrame);
+            break;
+        }
+        m_deck->ring.write(m_carry.data(), static_cast<size_t>(got) * Channels);
+        m_cacheFrame += got;
+        if (!m_primed) {
+            m_primed = true;
+            emit loaded(m_requestId);
+        }
+    }
+    m_carry.clear();
+    m_carryOffset = 0;
+    return true;
+}
+
+bool PcmDecodeWorker::flushCarry()
+{
+    size_t remaining = m_carry.size() - m_carryOffset;
+    if (remaining == 0) {
+        return true;
+    }
+    size_t writable = m_deck->ring.availableWrite() / Channels * Channels;
+    size_t written = m_deck->ring.write(m_carry.data() + m_carryOffset, std::min(remaining, writable));
+    m_carryOffset += written;
+    if (written > 0 && !m_primed) {
+        m_primed = true;
+        emit loaded(m_requestId);
+    }
+    return m_carryOffset >= m_carry.size();
+}
+
+void PcmDecodeWorker::convertBuffer(const QAudioBuffer &buffer)
+{
+    m_carry.clear();
+    m_carryOffset = 0;
+
+    const QAudioFormat format = buffer.format();
+    const int channels = format.channelCount();
+    const qint64 frames = buffer.frameCount();
+    if (channels <= 0 || frames <= 0) {
+        return;
+    }
+    const int sourceRate = format.sampleRate();
+    const bool resample = sourceRate > 0 && sourceRate != m_format.sampleRate();
+    std::vector<float> &stereo = resample ? m_converted : m_carry;
+    stereo.resize(static_cast<size_t>(frames) * Channels);
+    float *out = stereo.data();
+    const int bytesPerSample = format.bytesPerSample();
+    const char *data = buffer.constData<char>();
+
+    if (format.sampleFormat() == QAudioFormat::Float && channels == Channels) {
+        std::memcpy(out, data, stereo.size() * sizeof(float));
+    } else {
+        for (qint64 frame = 0; frame < frames; ++frame) {
+            float left = format.normalizedSampleValue(data);
+            float right = channels > 1 ? format.normalizedSampleValue(data + bytesPerSample) : left;
+            *out++ = left;
+            *out++ = right;
+            data += format.bytesPerFrame();
+        }
+    }
+
+    if (resample) {
+        if (!m_resampling) {
+            if (m_resampler.inputRate() != sourceRate || m_resampler.outputRate() != m_format.sampleRate()
+                || m_resampler.quality() != m_resamplerQuality) {
+                m_resampler.configure(sourceRate, m_format.sampleRate(), m_resamplerQuality);
+            }
+            m_resampling = true;
+        }
+        m_resampler.process(m_converted.data(), static_cast<int>(frames), m_carry);
+    }
+    commitCarry();
+}
+
+void PcmDecodeWorker::commitCarry()
+{
+    // Positions are counted from the decoder's output (after conversion to
+    // the engine rate) so that cached and freshly decoded frames line up.
+    const qint64 frames = static_cast<qint64>(m_carry.size() / Channels);
+    const qint64 bufferStart = m_decodedFrames;
+    m_decodedFrames += frames;
+    if (m_recording) {
+        recordBuffer(bufferStart, frames);
+    }
+    qint64 skipFrames = qBound<qint64>(0, m_skipUntilFrame - bufferStart, frames);
+    m_carryOffset = static_cast<size_t>(skipFrames) * Channels;
+}
+
+void PcmDecodeWorker::recordBuffer(qint64 bufferStart, qint64 frames)
+{
+    qint64 offset = m_recordFrame - bufferStart;
+    if (offset < 0) {
+        m_recording = false;
+        return;
+    }
+    if (offset >= frames) {
+        return;
+    }
+    if (!m_cache->append(m_filePath, m_format.sampleRate(), m_recordFrame,
+                         m_carry.data() + offset * Channels, frames - offset)) {
+        m_recording = false;
+        return;
+    }
+    m_recordFrame = bufferStart + frames;
+}
+
+void PcmDecodeWorker::markEndOfStream()
+{
+    if (!m_primed) {
+        m_primed = true;
+        emit loaded(m_requestId);
+    }
+    quint64 writeIndex = m_deck->ring.writeIndex();
+    quint64 written = writeIndex - m_deck->epochStartIndex.load(std::memory_order_relaxed);
+    m_deck->totalFrames.store(m_deck->epochBaseFrame.load(std::memory_order_relaxed)
+                              + static_cast<qint64>(written / Channels), std::memory_order_relaxed);
+    m_deck->endIndex.store(writeIndex, std::memory_order_relaxed);
+    m_deck->endEpoch.store(m_deck->epoch.load(std::memory_order_relaxed), std::memory_order_release);
+    if (m_recording && m_recordFrame == m_decodedFrames) {
+        m_cache->markComplete(m_filePath, m_format.sampleRate(), m_recordFrame);
+    }
+    m_recording = false;
+    m_active = false;
+}
+
+void PcmDecodeWorker::onDecoderFinished()
+{
+    if (!m_active) {
+        return;
+    }
+    m_finished = true;
+    pump();
+}
+
+void PcmDecodeWorker::onDecoderError(QAudioDecoder::Error error)
+{
+    Q_UNUSED(error)
+    if (!m_active) {
+        return;
+    }
+    QString message = m_decoder->errorString();
+    m_active = false;
+    m_decoder->stop();
+    emit errorOccurred(m_requestId, message);
+}
+
+void PcmDecodeWorker::onDecoderDurationChanged(qint64 duration)
+{
+    if (!m_active || duration <= 0 || m_indexedDuration) {
+        return;
+    }
+    if (!m_finished) {
+        m_deck->totalFrames.store(duration * m_format.sampleRate() / 1000, std::memory_order_relaxed);
+    }
+    emit durationChanged(m_requestId, duration);
+}
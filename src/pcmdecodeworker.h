@@ -0,0 +1,112 @@
+#ifndef PCMDECODEWORKER_H
+#define PCMDECODEWORKER_H
+
+#include <QObject>
+#include <QAudioDecoder>
+#include <QAudioFormat>
+#include <QString>
+#include <QTimer>
+#include <atomic>
+#include <vector>
+#include "mp3seekindex.h"
+#include "pcmcache.h"
+#include "resampler.h"
+#include "spscringbuffer.h"
+
+// One playback source of the PCM engine. The ring is filled by a
+// PcmDecodeWorker and drained by the audio callback. Every load or seek opens
+// a new epoch: the worker publishes where in the ring the epoch starts and
+// which source frame it corresponds to, the callback discards older data when
+// it notices the change. All cross-thread fields are atomics.
+struct PcmDeck {
+    SpscRingBuffer<float> ring;
+    std::atomic<quint64> epoch{0};
+    std::atomic<quint64> epochStartIndex{0};
+    std::atomic<qint64> epochBaseFrame{0};
+    std::atomic<quint64> endEpoch{0};
+    std::atomic<quint64> endIndex{0};
+    std::atomic<qint64> totalFrames{-1};
+    std::atomic<bool> armed{false};
+    std::atomic<quint64> consumedEpoch{0};
+    std::atomic<qint64> positionFrames{0};
+    std::atomic<float> gain{1.0f};
+    std::atomic<float> rate{1.0f};
+    // Where the deck stops playing before the end of the file; -1 plays on.
+    std::atomic<qint64> endMs{-1};
+};
+
+class PcmDecodeWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int Channels = 2;
+
+    PcmDecodeWorker(PcmDeck *deck, PcmCache *cache, QObject *parent = nullptr);
+    ~PcmDecodeWorker();
+
+    // Applies from the next load or seek.
+    void setResamplerQuality(Resampler::Quality quality) { m_resamplerQuality = quality; }
+
+public slots:
+    void load(const QString &filePath, const QAudioFormat &format, qint64 startMs, quint64 requestId);
+    void unload();
+
+signals:
+    void loaded(quint64 requestId);
+    void durationChanged(quint64 requestId, qint64 durationMs);
+    void errorOccurred(quint64 requestId, const QString &error);
+
+private slots:
+    void pump();
+    void onDecoderFinished();
+    void onDecoderError(QAudioDecoder::Error error);
+    void onDecoderDurationChanged(qint64 duration);
+
+private:
+    void ensureDecoder();
+    void startDecoder(qint64 skipFrames);
+    bool ensureSeekIndex();
+    QIODevice *openSourceDevice(qint64 byteOffset);
+    bool openIndexedSource(qint64 skipFrames);
+    void beginEpoch(qint64 baseFrame);
+    bool replayCache();
+    bool flushCarry();
+    void convertBuffer(const QAudioBuffer &buffer);
+    void commitCarry();
+    void recordBuffer(qint64 bufferStart, qint64 frames);
+    void markEndOfStream();
+
+    PcmDeck *m_deck;
+    PcmCache *m_cache;
+    QAudioDecoder *m_decoder;
+    QTimer *m_pumpTimer;
+    QAudioFormat m_format;
+    QString m_filePath;
+    QIODevice *m_sourceDevice;
+    Mp3SeekIndex m_seekIndex;
+    QString m_seekIndexPath;
+    bool m_indexedDuration;
+    std::vector<float> m_carry;
+    // The decoder runs at the file's own rate; other rates are converted
+    // here rather than by the platform backend.
+    Resampler m_resampler;
+    Resampler::Quality m_resamplerQuality;
+    bool m_resampling;
+    std::vector<float> m_converted;
+    size_t m_carryOffset;
+    qint64 m_skipUntilFrame;
+    qint64 m_decodedFrames;
+    // Frames [m_cacheFrame, m_cacheEnd) are served from the cache before
+    // anything the decoder produces.
+    qint64 m_cacheFrame;
+    qint64 m_cacheEnd;
+    qint64 m_recordFrame;
+    bool m_recording;
+    quint64 m_requestId;
+    bool m_active;
+    bool m_finished;
+    bool m_primed;
+};
+
+#endif
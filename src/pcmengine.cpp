@@ -0,0 +1,959 @@
+#include "pcmengine.h"
+#include "latencytracker.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QMediaDevices>
+#include <QMetaObject>
+#include <QSignalBlocker>
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+PcmOutputDevice::PcmOutputDevice(PcmEngine *engine, const QAudioFormat &format, QObject *parent)
+    : QIODevice(parent)
+    , m_engine(engine)
+    , m_format(format)
+    , m_scratch(1024 * PcmDecodeWorker::Channels)
+{
+}
+
+qint64 PcmOutputDevice::bytesAvailable() const
+{
+    return QIODevice::bytesAvailable() + m_format.bytesForDuration(1000000);
+}
+
+qint64 PcmOutputDevice::readData(char *data, qint64 maxSize)
+{
+    const int bytesPerFrame = m_format.bytesPerFrame();
+    const int scratchFrames = static_cast<int>(m_scratch.size()) / PcmDecodeWorker::Channels;
+    const bool direct = m_format.sampleFormat() == QAudioFormat::Float
+                        && m_format.channelCount() == PcmDecodeWorker::Channels;
+    qint64 frames = maxSize / bytesPerFrame;
+    qint64 done = 0;
+    while (done < frames) {
+        int chunk = static_cast<int>(qMin<qint64>(frames - done, scratchFrames));
+        m_engine->render(m_scratch.data(), chunk);
+        char *out = data + done * bytesPerFrame;
+        if (direct) {
+            std::memcpy(out, m_scratch.data(), static_cast<size_t>(chunk) * bytesPerFrame);
+        } else {
+            convert(out, chunk);
+        }
+        done += chunk;
+    }
+    return frames * bytesPerFrame;
+}
+
+void PcmOutputDevice::convert(char *out, int frames) const
+{
+    const int channels = m_format.channelCount();
+    const int samples = frames * channels;
+    for (int index = 0; index < samples; ++index) {
+        const int frame = index / channels;
+        const int channel = index % channels;
+        const float left = m_scratch[frame * 2];
+        const float right = m_scratch[frame * 2 + 1];
+        // Mono gets the mixdown; channels past the first two stay silent.
+        float value = channels == 1 ? 0.5f * (left + right) : channel == 0 ? left : channel == 1 ? right : 0.0f;
+        value = std::clamp(value, -1.0f, 1.0f);
+        switch (m_format.sampleFormat()) {
+        case QAudioFormat::UInt8:
+            reinterpret_cast<quint8 *>(out)[index] = static_cast<quint8>(128 + std::lround(value * 127.0f));
+            break;
+        case QAudioFormat::Int16:
+            reinterpret_cast<qint16 *>(out)[index] = static_cast<qint16>(value * 32767.0f);
+            break;
+        case QAudioFormat::Int32:
+            reinterpret_cast<qint32 *>(out)[index] = static_cast<qint32>(value * 2147483647.0);
+            break;
+        case QAudioFormat::Float:
+            reinterpret_cast<float *>(out)[index] = value;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+qint64 PcmOutputDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data)
+    Q_UNUSED(maxSize)
+    return -1;
+}
+
+PcmEngine::PcmEngine(QObject *parent)
+    : QObject(parent)
+    , m_requestCounter(0)
+    , m_outputContext(new QObject)
+    , m_sink(nullptr)
+    , m_outputDevice(nullptr)
+    , m_resamplerQuality(Resampler::Standard)
+    , m_nextStartMs(0)
+    , m_bufferMs(2000)
+    , m_periodMs(40)
+    , m_state(QMediaPlayer::StoppedState)
+    , m_status(QMediaPlayer::NoMedia)
+    , m_activeLoaded(false)
+    , m_restartOnPlay(false)
+    , m_outputRunning(false)
+    , m_seenSwitchCount(0)
+    , m_lastPosition(-1)
+    , m_lastDuration(-1)
+    , m_seenUnderruns(0)
+    , m_bufferLow(false)
+    , m_activeDeck(0)
+    , m_switchCount(0)
+    , m_activeEnded(false)
+    , m_volume(1.0f)
+    , m_crossfadeFrames(0)
+    , m_crossfadeCurve(Crossfader::EqualPower)
+    , m_underruns(0)
+    , m_awaitingFirstAudio(false)
+    , m_firstAudioTime(0)
+    , m_lastRenderTime(0)
+    , m_maxRenderGap(0)
+    , m_minBufferedFrames(std::numeric_limits<qint64>::max())
+    , m_appliedGain(1.0f)
+{
+    m_outputAudioDevice = QMediaDevices::defaultAudioOutput();
+    m_format = chooseFormat(m_outputAudioDevice);
+    m_decodeFormat = m_format;
+    m_decodeFormat.setSampleFormat(QAudioFormat::Float);
+    m_decodeFormat.setChannelCount(PcmDecodeWorker::Channels);
+    m_mixBuffer.resize(MaxChunkFrames * PcmDecodeWorker::Channels);
+    allocateBuffers();
+
+    for (int deck = 0; deck < DeckCount; ++deck) {
+        m_requestIds[deck] = 0;
+        m_workers[deck] = new PcmDecodeWorker(&m_decks[deck], &m_cache);
+        m_workers[deck]->moveToThread(&m_decodeThread);
+        connect(&m_decodeThread, &QThread::finished, m_workers[deck], &QObject::deleteLater);
+        connect(m_workers[deck], &PcmDecodeWorker::loaded, this, [this, deck](quint64 requestId) {
+            onWorkerLoaded(deck, requestId);
+        });
+        connect(m_workers[deck], &PcmDecodeWorker::durationChanged, this, [this, deck](quint64 requestId, qint64 duration) {
+            onWorkerDuration(deck, requestId, duration);
+        });
+        connect(m_workers[deck], &PcmDecodeWorker::errorOccurred, this, [this, deck](quint64 requestId, const QString &error) {
+            onWorkerError(deck, requestId, error);
+        });
+    }
+    m_outputContext->moveToThread(&m_outputThread);
+    connect(&m_outputThread, &QThread::finished, m_outputContext, &QObject::deleteLater);
+    m_decodeThread.setObjectName("PcmDecode");
+    m_outputThread.setObjectName("PcmOutput");
+    m_decodeThread.start();
+    m_outputThread.start(QThread::TimeCriticalPriority);
+
+    m_pollTimer.setInterval(20);
+    connect(&m_pollTimer, &QTimer::timeout, this, &PcmEngine::poll);
+}
+
+PcmEngine::~PcmEngine()
+{
+    QMetaObject::invokeMethod(m_outputContext, [this]() {
+        if (m_sink) {
+            m_sink->stop();
+        }
+        delete m_sink;
+        delete m_outputDevice;
+        m_sink = nullptr;
+        m_outputDevice = nullptr;
+    }, Qt::BlockingQueuedConnection);
+    for (int deck = 0; deck < DeckCount; ++deck) {
+        PcmDecodeWorker *worker = m_workers[deck];
+        QMetaObject::invokeMethod(worker, [worker]() { worker->unload(); }, Qt::BlockingQueuedConnection);
+    }
+    m_outputThread.quit();
+    m_decodeThread.quit();
+    m_outputThread.wait();
+    m_decodeThread.wait();
+}
+
+QAudioFormat PcmEngine::chooseFormat(const QAudioDevice &device)
+{
+    const QAudioFormat preferred = device.preferredFormat();
+    QAudioFormat format;
+    format.setSampleRate(preferred.sampleRate() > 0 ? preferred.sampleRate() : 48000);
+    format.setChannelCount(PcmDecodeWorker::Channels);
+    for (QAudioFormat::SampleFormat sampleFormat : {QAudioFormat::Float, QAudioFormat::Int16}) {
+        format.setSampleFormat(sampleFormat);
+        if (device.isFormatSupported(format)) {
+            return format;
+        }
+    }
+    // Neither at the device's rate in stereo: its own format, whatever the
+    // channel count or sample type; PcmOutputDevice converts the mix.
+    return preferred.isValid() ? preferred : format;
+}
+
+int PcmEngine::nativeSampleRate(const QString &filePath)
+{
+    if (Mp3SeekIndex::isSupported(filePath)) {
+        return Mp3SeekIndex::probeSampleRate(filePath);
+    }
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    const QByteArray head = file.read(4096);
+    const uchar *data = reinterpret_cast<const uchar *>(head.constData());
+    if (head.startsWith("fLaC") && head.size() >= 8 + 18) {
+        // STREAMINFO always comes first; the rate is 20 bits at byte 10.
+        return (data[18] << 12) | (data[19] << 4) | (data[20] >> 4);
+    }
+    if (head.startsWith("RIFF") && head.mid(8, 4) == "WAVE") {
+        qint64 offset = 12;
+        while (offset + 8 <= head.size()) {
+            const quint32 chunkSize = qFromLittleEndian<quint32>(data + offset + 4);
+            if (head.mid(offset, 4) == "fmt " && offset + 16 <= head.size()) {
+                return static_cast<int>(qFromLittleEndian<quint32>(data + offset + 12));
+            }
+            offset += 8 + chunkSize + (chunkSize & 1);
+        }
+    }
+    return 0;
+}
+
+void PcmEngine::allocateBuffers()
+{
+    size_t frames = static_cast<size_t>(m_format.sampleRate()) * m_bufferMs / 1000;
+    for (PcmDeck &deck : m_decks) {
+        deck.ring.reset(frames * PcmDecodeWorker::Channels);
+    }
+    for (TimeStretcher &stretcher : m_stretchers) {
+        stretcher.prepare(m_format.sampleRate());
+    }
+}
+
+void PcmEngine::setBufferSizes(int bufferMs, int periodMs)
+{
+    bufferMs = std::clamp(bufferMs, 100, 30000);
+    periodMs = std::clamp(periodMs, 5, 500);
+    if (bufferMs == m_bufferMs && periodMs == m_periodMs) {
+        return;
+    }
+    // The rings are reallocated, so everything is decoded again from the
+    // current position, as for a device at another rate.
+    const QString path = m_path;
+    const QString nextPath = m_nextPath;
+    const qint64 nextStart = m_nextStartMs;
+    const int active = m_activeDeck.load(std::memory_order_acquire);
+    const float gain = m_decks[active].gain.load(std::memory_order_relaxed);
+    const float nextGain = m_decks[1 - active].gain.load(std::memory_order_relaxed);
+    const qint64 endMs = m_decks[active].endMs.load(std::memory_order_relaxed);
+    const qint64 nextEndMs = m_decks[1 - active].endMs.load(std::memory_order_relaxed);
+    const qint64 resumePosition = position();
+    const QMediaPlayer::PlaybackState state = m_state;
+    const QSignalBlocker blocker(this);
+    stopOutput();
+    releaseOutput();
+    m_bufferMs = bufferMs;
+    m_periodMs = periodMs;
+    allocateBuffers();
+    if (path.isEmpty()) {
+        return;
+    }
+    setSource(path, gain);
+    if (!nextPath.isEmpty()) {
+        setNextSource(nextPath, nextGain, nextStart);
+    }
+    setSourceEnds(endMs, nextEndMs);
+    if (state == QMediaPlayer::StoppedState) {
+        return;
+    }
+    setPosition(resumePosition);
+    if (state == QMediaPlayer::PlayingState) {
+        play();
+    } else {
+        m_state = state;
+    }
+}
+
+void PcmEngine::releaseOutput()
+{
+    for (int deck = 0; deck < DeckCount; ++deck) {
+        PcmDecodeWorker *worker = m_workers[deck];
+        QMetaObject::invokeMethod(worker, [worker]() { worker->unload(); }, Qt::BlockingQueuedConnection);
+    }
+    QMetaObject::invokeMethod(m_outputContext, [this]() {
+        delete m_sink;
+        delete m_outputDevice;
+        m_sink = nullptr;
+        m_outputDevice = nullptr;
+    }, Qt::BlockingQueuedConnection);
+}
+
+void PcmEngine::matchOutputRate(const QString &filePath)
+{
+    // Only when a track is opened on its own: a gapless or crossfaded
+    // successor at another rate is resampled instead of reopening the sink.
+    const int sampleRate = nativeSampleRate(filePath);
+    if (sampleRate <= 0 || sampleRate == m_format.sampleRate()) {
+        return;
+    }
+    QAudioFormat format = m_format;
+    format.setSampleRate(sampleRate);
+    if (!m_outputAudioDevice.isFormatSupported(format)) {
+        return;
+    }
+    releaseOutput();
+    applyFormat(format);
+}
+
+void PcmEngine::applyFormat(const QAudioFormat &format)
+{
+    // The output must be released: the rings are reallocated.
+    const int previousRate = m_format.sampleRate();
+    m_format = format;
+    m_decodeFormat.setSampleRate(format.sampleRate());
+    allocateBuffers();
+    m_crossfadeFrames.store(static_cast<int>(qint64(m_crossfadeFrames.load(std::memory_order_relaxed))
+                                             * format.sampleRate() / previousRate),
+                            std::memory_order_relaxed);
+}
+
+void PcmEngine::setOutputDevice(const QAudioDevice &device)
+{
+    if (device.isNull() || device.id() == m_outputAudioDevice.id()) {
+        return;
+    }
+    QAudioFormat format = m_format;
+    if (!device.isFormatSupported(format)) {
+        format = chooseFormat(device);
+    }
+    if (format.sampleRate() == m_format.sampleRate()) {
+        // The rings and decoders are untouched; only what the old sink
+        // still held is lost.
+        const bool running = m_outputRunning;
+        QMetaObject::invokeMethod(m_outputContext, [this]() {
+            delete m_sink;
+            delete m_outputDevice;
+            m_sink = nullptr;
+            m_outputDevice = nullptr;
+        }, Qt::BlockingQueuedConnection);
+        m_outputAudioDevice = device;
+        m_format = format;
+        if (running) {
+            m_outputRunning = false;
+            startOutput();
+        }
+        return;
+    }
+
+    // Another rate: decode again from the current position.
+    const QString path = m_path;
+    const QString nextPath = m_nextPath;
+    const qint64 nextStart = m_nextStartMs;
+    const int active = m_activeDeck.load(std::memory_order_acquire);
+    const float gain = m_decks[active].gain.load(std::memory_order_relaxed);
+    const float nextGain = m_decks[1 - active].gain.load(std::memory_order_relaxed);
+    const qint64 resumePosition = position();
+    const QMediaPlayer::PlaybackState state = m_state;
+    // Listeners must not take the internal reload for a stopped track.
+    const QSignalBlocker blocker(this);
+    stopOutput();
+    releaseOutput();
+    m_outputAudioDevice = device;
+    applyFormat(format);
+    if (path.isEmpty()) {
+        return;
+    }
+    setSource(path, gain);
+    if (!nextPath.isEmpty()) {
+        setNextSource(nextPath, nextGain, nextStart);
+    }
+    if (state == QMediaPlayer::StoppedState) {
+        return;
+    }
+    setPosition(resumePosition);
+    if (state == QMediaPlayer::PlayingState) {
+        play();
+    } else {
+        m_state = state;
+    }
+}
+
+void PcmEngine::setResamplerQuality(Resampler::Quality quality)
+{
+    m_resamplerQuality = quality;
+    for (PcmDecodeWorker *worker : m_workers) {
+        QMetaObject::invokeMethod(worker, [worker, quality]() {
+            worker->setResamplerQuality(quality);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void PcmEngine::addProcessor(AudioProcessor *processor)
+{
+    if (m_sink) {
+        qWarning() << "Обработчик звука можно добавить только до начала воспроизведения";
+        return;
+    }
+    m_processors.push_back(processor);
+}
+
+void PcmEngine::setCacheCapacity(qint64 bytes)
+{
+    m_cache.setCapacity(bytes);
+}
+
+void PcmEngine::setSource(const QString &filePath, float gain, qint64 startMs)
+{
+    stopOutput();
+    m_path = filePath;
+    m_nextPath.clear();
+    m_activeLoaded = false;
+    m_restartOnPlay = false;
+    m_lastPosition = -1;
+    m_lastDuration = -1;
+    int active = m_activeDeck.load(std::memory_order_acquire);
+    m_decks[1 - active].armed.store(false, std::memory_order_release);
+    unloadDeck(1 - active);
+    setState(QMediaPlayer::StoppedState);
+    if (filePath.isEmpty()) {
+        unloadDeck(active);
+        setStatus(QMediaPlayer::NoMedia);
+        return;
+    }
+    setStatus(QMediaPlayer::LoadingMedia);
+    matchOutputRate(filePath);
+    m_decks[active].gain.store(gain, std::memory_order_relaxed);
+    loadDeck(active, filePath, qMax<qint64>(0, startMs));
+}
+
+void PcmEngine::setNextSource(const QString &filePath, float gain, qint64 startMs)
+{
+    startMs = qMax<qint64>(0, startMs);
+    if (filePath == m_nextPath && (filePath.isEmpty() || startMs == m_nextStartMs)) {
+        return;
+    }
+    int active = m_activeDeck.load(std::memory_order_acquire);
+    int next = 1 - active;
+    m_decks[next].armed.exchange(false, std::memory_order_acq_rel);
+    if (m_activeDeck.load(std::memory_order_acquire) != active) {
+        return;
+    }
+    m_decks[next].gain.store(gain, std::memory_order_relaxed);
+    m_nextPath = filePath;
+    m_nextStartMs = startMs;
+    if (filePath.isEmpty()) {
+        unloadDeck(next);
+    } else {
+        loadDeck(next, filePath, startMs);
+    }
+}
+
+void PcmEngine::clearNextSource()
+{
+    setNextSource(QString());
+}
+
+void PcmEngine::setSourceGains(float current, float next)
+{
+    int active = m_activeDeck.load(std::memory_order_acquire);
+    m_decks[active].gain.store(current, std::memory_order_relaxed);
+    m_decks[1 - active].gain.store(next, std::memory_order_relaxed);
+}
+
+void PcmEngine::setSourceRates(float current, float next)
+{
+    int active = m_activeDeck.load(std::memory_order_acquire);
+    m_decks[active].rate.store(std::clamp(current, TimeStretcher::MinRate, TimeStretcher::MaxRate), std::memory_order_relaxed);
+    m_decks[1 - active].rate.store(std::clamp(next, TimeStretcher::MinRate, TimeStretcher::MaxRate), std::memory_order_relaxed);
+}
+
+void PcmEngine::setSourceEnds(qint64 currentMs, qint64 nextMs)
+{
+    int active = m_activeDeck.load(std::memory_order_acquire);
+    m_decks[active].endMs.store(currentMs, std::memory_order_relaxed);
+    m_decks[1 - active].endMs.store(nextMs, std::memory_order_relaxed);
+}
+
+void PcmEngine::loadDeck(int deck, const QString &filePath, qint64 startMs)
+{
+    discardStaleDeck(deck);
+    quint64 requestId = ++m_requestCounter;
+    m_requestIds[deck] = requestId;
+    PcmDecodeWorker *worker = m_workers[deck];
+    QAudioFormat format = m_decodeFormat;
+    QMetaObject::invokeMethod(worker, [worker, filePath, format, startMs, requestId]() {
+        worker->load(filePath, format, startMs, requestId);
+    }, Qt::QueuedConnection);
+}
+
+void PcmEngine::discardStaleDeck(int deck)
+{
+    // Without a running callback nothing drains the ring, which fills up
+    // while stopped or paused; the new epoch would find no room and never
+    // report itself loaded. With the worker idle and the callback halted the
+    // control thread can drop the old data itself.
+    if (m_outputRunning) {
+        return;
+    }
+    PcmDecodeWorker *worker = m_workers[deck];
+    QMetaObject::invokeMethod(worker, [worker]() { worker->unload(); }, Qt::BlockingQueuedConnection);
+    syncEpoch(m_decks[deck]);
+}
+
+void PcmEngine::unloadDeck(int deck)
+{
+    m_requestIds[deck] = ++m_requestCounter;
+    PcmDecodeWorker *worker = m_workers[deck];
+    QMetaObject::invokeMethod(worker, [worker]() { worker->unload(); }, Qt::QueuedConnection);
+}
+
+void PcmEngine::play()
+{
+    if (m_path.isEmpty()) {
+        return;
+    }
+    if (m_restartOnPlay) {
+        m_restartOnPlay = false;
+        m_activeLoaded = false;
+        loadDeck(m_activeDeck.load(std::memory_order_acquire), m_path, 0);
+    }
+    setState(QMediaPlayer::PlayingState);
+    if (m_activeLoaded) {
+        startOutput();
+    }
+    m_pollTimer.start();
+}
+
+void PcmEngine::pause()
+{
+    if (m_state != QMediaPlayer::PlayingState) {
+        return;
+    }
+    suspendOutput();
+    setState(QMediaPlayer::PausedState);
+}
+
+void PcmEngine::stop()
+{
+    stopOutput();
+    m_pollTimer.stop();
+    if (m_state == QMediaPlayer::StoppedState) {
+        return;
+    }
+    m_restartOnPlay = true;
+    m_lastPosition = 0;
+    setState(QMediaPlayer::StoppedState);
+    emit positionChanged(0);
+}
+
+void PcmEngine::setPosition(qint64 position)
+{
+    if (m_path.isEmpty()) {
+        return;
+    }
+    qint64 length = duration();
+    if (length > 0) {
+        position = qMin(position, length);
+    }
+    position = qMax<qint64>(0, position);
+    m_restartOnPlay = false;
+    loadDeck(m_activeDeck.load(std::memory_order_acquire), m_path, position);
+    m_lastPosition = position;
+    emit positionChanged(position);
+}
+
+qint64 PcmEngine::position() const
+{
+    const PcmDeck &deck = m_decks[m_activeDeck.load(std::memory_order_acquire)];
+    if (m_restartOnPlay) {
+        return 0;
+    }
+    if (deck.consumedEpoch.load(std::memory_order_acquire) != deck.epoch.load(std::memory_order_acquire)) {
+        return framesToMs(deck.epochBaseFrame.load(std::memory_order_relaxed));
+    }
+    return framesToMs(deck.positionFrames.load(std::memory_order_relaxed));
+}
+
+qint64 PcmEngine::duration() const
+{
+    const PcmDeck &deck = m_decks[m_activeDeck.load(std::memory_order_acquire)];
+    qint64 frames = deck.totalFrames.load(std::memory_order_relaxed);
+    return frames > 0 ? framesToMs(frames) : 0;
+}
+
+void PcmEngine::setVolume(float volume)
+{
+    m_volume.store(std::clamp(volume, 0.0f, 1.0f), std::memory_order_relaxed);
+}
+
+void PcmEngine::setCrossfade(int milliseconds, Crossfader::Curve curve)
+{
+    qint64 frames = qint64(qMax(0, milliseconds)) * m_format.sampleRate() / 1000;
+    m_crossfadeCurve.store(curve, std::memory_order_relaxed);
+    m_crossfadeFrames.store(static_cast<int>(frames), std::memory_order_relaxed);
+}
+
+qint64 PcmEngine::framesToMs(qint64 frames) const
+{
+    return frames * 1000 / m_format.sampleRate();
+}
+
+void PcmEngine::onWorkerLoaded(int deck, quint64 requestId)
+{
+    if (requestId != m_requestIds[deck]) {
+        return;
+    }
+    if (deck == m_activeDeck.load(std::memory_order_acquire)) {
+        if (!m_activeLoaded) {
+            m_activeLoaded = true;
+            setStatus(QMediaPlayer::LoadedMedia);
+            emit durationChanged(duration());
+        }
+        if (m_state == QMediaPlayer::PlayingState) {
+            startOutput();
+        }
+    } else if (!m_nextPath.isEmpty()) {
+        m_decks[deck].armed.store(true, std::memory_order_release);
+    }
+}
+
+void PcmEngine::onWorkerDuration(int deck, quint64 requestId, qint64 duration)
+{
+    if (requestId != m_requestIds[deck] || deck != m_activeDeck.load(std::memory_order_acquire)) {
+        return;
+    }
+    m_lastDuration = duration;
+    emit durationChanged(duration);
+}
+
+void PcmEngine::onWorkerError(int deck, quint64 requestId, const QString &error)
+{
+    if (requestId != m_requestIds[deck]) {
+        return;
+    }
+    if (deck != m_activeDeck.load(std::memory_order_acquire)) {
+        m_nextPath.clear();
+        return;
+    }
+    stopOutput();
+    m_pollTimer.stop();
+    m_activeLoaded = false;
+    setState(QMediaPlayer::StoppedState);
+    setStatus(QMediaPlayer::InvalidMedia);
+    emit errorOccurred(error.isEmpty() ? QString("Не удалось декодировать %1").arg(QFileInfo(m_path).fileName()) : error);
+}
+
+void PcmEngine::startOutput()
+{
+    if (m_outputRunning) {
+        return;
+    }
+    m_outputRunning = true;
+    m_activeEnded.store(false, std::memory_order_relaxed);
+    m_awaitingFirstAudio.store(true, std::memory_order_relaxed);
+    m_lastRenderTime.store(0, std::memory_order_relaxed);
+    if (!m_sink) {
+        for (AudioProcessor *processor : m_processors) {
+            processor->prepare(m_format.sampleRate(), PcmDecodeWorker::Channels);
+        }
+    }
+    QMetaObject::invokeMethod(m_outputContext, [this]() {
+        if (!m_sink) {
+            m_outputDevice = new PcmOutputDevice(this, m_format);
+            m_outputDevice->open(QIODevice::ReadOnly);
+            m_sink = new QAudioSink(m_outputAudioDevice, m_format);
+            m_sink->setBufferSize(m_format.bytesForDuration(qint64(m_periodMs) * 2000));
+        }
+        if (m_sink->state() == QAudio::SuspendedState) {
+            m_sink->resume();
+        } else {
+            m_sink->start(m_outputDevice);
+        }
+    }, Qt::BlockingQueuedConnection);
+}
+
+void PcmEngine::suspendOutput()
+{
+    if (!m_outputRunning) {
+        return;
+    }
+    m_outputRunning = false;
+    QMetaObject::invokeMethod(m_outputContext, [this]() {
+        if (m_sink) {
+            m_sink->suspend();
+        }
+    }, Qt::BlockingQueuedConnection);
+}
+
+void PcmEngine::stopOutput()
+{
+    m_outputRunning = false;
+    QMetaObject::invokeMethod(m_outputContext, [this]() {
+        if (m_sink) {
+            m_sink->stop();
+        }
+    }, Qt::BlockingQueuedConnection);
+}
+
+void PcmEngine::setState(QMediaPlayer::PlaybackState state)
+{
+    if (m_state == state) {
+        return;
+    }
+    m_state = state;
+    emit playbackStateChanged(state);
+}
+
+void PcmEngine::setStatus(QMediaPlayer::MediaStatus status)
+{
+    if (m_status == status) {
+        return;
+    }
+    m_status = status;
+    emit mediaStatusChanged(status);
+}
+
+void PcmEngine::poll()
+{
+    quint32 switches = m_switchCount.load(std::memory_order_acquire);
+    if (switches != m_seenSwitchCount) {
+        m_seenSwitchCount = switches;
+        m_path = m_nextPath;
+        m_nextPath.clear();
+        m_lastDuration = -1;
+        emit sourceAdvanced();
+    }
+    qint64 firstAudioTime = m_firstAudioTime.exchange(0, std::memory_order_acq_rel);
+    if (firstAudioTime) {
+        emit firstAudio(firstAudioTime);
+    }
+    quint64 underruns = m_underruns.load(std::memory_order_relaxed);
+    if (underruns != m_seenUnderruns) {
+        emit underrun(underruns - m_seenUnderruns);
+        m_seenUnderruns = underruns;
+    }
+    qint64 renderGap = m_maxRenderGap.exchange(0, std::memory_order_relaxed);
+    if (renderGap > qint64(m_periodMs) * 2 * 1000000) {
+        emit lateCallback(renderGap / 1e6);
+    }
+    qint64 minBuffered = m_minBufferedFrames.exchange(std::numeric_limits<qint64>::max(), std::memory_order_relaxed);
+    if (minBuffered != std::numeric_limits<qint64>::max()) {
+        qint64 bufferedMs = framesToMs(minBuffered);
+        bool low = bufferedMs < m_bufferMs / 4;
+        if (low && !m_bufferLow) {
+            emit bufferLow(bufferedMs);
+        }
+        m_bufferLow = low;
+    }
+    if (m_activeEnded.exchange(false, std::memory_order_acq_rel)) {
+        stopOutput();
+        m_pollTimer.stop();
+        m_restartOnPlay = true;
+        setState(QMediaPlayer::StoppedState);
+        setStatus(QMediaPlayer::EndOfMedia);
+        return;
+    }
+    qint64 currentDuration = duration();
+    if (currentDuration != m_lastDuration && currentDuration > 0) {
+        m_lastDuration = currentDuration;
+        emit durationChanged(currentDuration);
+    }
+    qint64 currentPosition = position();
+    if (currentPosition != m_lastPosition) {
+        m_lastPosition = currentPosition;
+        emit positionChanged(currentPosition);
+    }
+}
+
+void PcmEngine::syncEpoch(PcmDeck &deck)
+{
+    quint64 epoch = deck.epoch.load(std::memory_order_acquire);
+    if (epoch == deck.consumedEpoch.load(std::memory_order_relaxed)) {
+        return;
+    }
+    deck.ring.discardUntil(deck.epochStartIndex.load(std::memory_order_relaxed));
+    deck.positionFrames.store(deck.epochBaseFrame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_stretchers[deckIndex(deck)].reset();
+    deck.consumedEpoch.store(epoch, std::memory_order_release);
+}
+
+qint64 PcmEngine::deckEndFrame(const PcmDeck &deck) const
+{
+    const qint64 total = deck.totalFrames.load(std::memory_order_relaxed);
+    const qint64 endMs = deck.endMs.load(std::memory_order_relaxed);
+    if (endMs < 0) {
+        return total;
+    }
+    const qint64 end = endMs * m_format.sampleRate() / 1000;
+    return total > 0 ? qMin(total, end) : end;
+}
+
+bool PcmEngine::deckEnded(const PcmDeck &deck) const
+{
+    if (deck.endMs.load(std::memory_order_relaxed) >= 0
+        && deck.consumedEpoch.load(std::memory_order_relaxed) == deck.epoch.load(std::memory_order_acquire)
+        && deck.positionFrames.load(std::memory_order_relaxed) >= deckEndFrame(deck)) {
+        return true;
+    }
+    quint64 endEpoch = deck.endEpoch.load(std::memory_order_acquire);
+    return endEpoch != 0
+        && endEpoch == deck.consumedEpoch.load(std::memory_order_relaxed)
+        && deck.ring.readIndex() >= deck.endIndex.load(std::memory_order_relaxed)
+        && (!m_stretchers[deckIndex(deck)].isActive() || m_stretchers[deckIndex(deck)].isDrained());
+}
+
+int PcmEngine::readDeck(PcmDeck &deck, float *destination, int frames)
+{
+    const int channels = PcmDecodeWorker::Channels;
+    TimeStretcher &stretcher = m_stretchers[deckIndex(deck)];
+    const float rate = deck.rate.load(std::memory_order_relaxed);
+    int got = 0;
+    int advanced = 0;
+    int wanted = frames;
+    if (deck.endMs.load(std::memory_order_relaxed) >= 0) {
+        // The cut is in source frames; the stretcher covers `rate` of them
+        // per output frame.
+        const qint64 left = deckEndFrame(deck) - deck.positionFrames.load(std::memory_order_relaxed);
+        const qint64 outputLeft = static_cast<qint64>(std::ceil(qMax<qint64>(0, left) / double(rate)));
+        wanted = static_cast<int>(qMin<qint64>(outputLeft, frames));
+    }
+    if (rate != 1.0f || stretcher.isActive()) {
+        // Once engaged the stretcher holds read-ahead, so it stays in the
+        // path until the next load or seek even if the rate returns to 1.
+        const quint64 endEpoch = deck.endEpoch.load(std::memory_order_acquire);
+        const bool endOfInput = endEpoch != 0 && endEpoch == deck.consumedEpoch.load(std::memory_order_relaxed);
+        got = stretcher.process(deck.ring, destination, wanted, rate, endOfInput, advanced);
+    } else {
+        got = static_cast<int>(deck.ring.read(destination, static_cast<size_t>(wanted) * channels)) / channels;
+        advanced = got;
+    }
+    const float gain = deck.gain.load(std::memory_order_relaxed);
+    if (gain != 1.0f) {
+        for (int sample = 0; sample < got * channels; ++sample) {
+            destination[sample] *= gain;
+        }
+    }
+    if (got < frames) {
+        std::fill(destination + got * channels, destination + frames * channels, 0.0f);
+    }
+    deck.positionFrames.store(deck.positionFrames.load(std::memory_order_relaxed) + advanced,
+                              std::memory_order_relaxed);
+    return got;
+}
+
+void PcmEngine::render(float *output, int frames)
+{
+    const int channels = PcmDecodeWorker::Channels;
+    const Crossfader::Curve curve = static_cast<Crossfader::Curve>(m_crossfadeCurve.load(std::memory_order_relaxed));
+    bool produced = false;
+    int done = 0;
+
+    const qint64 now = LatencyTracker::now();
+    const qint64 lastRender = m_lastRenderTime.exchange(now, std::memory_order_relaxed);
+    if (lastRender) {
+        const qint64 gap = now - lastRender;
+        qint64 seen = m_maxRenderGap.load(std::memory_order_relaxed);
+        while (gap > seen && !m_maxRenderGap.compare_exchange_weak(seen, gap, std::memory_order_relaxed)) {
+        }
+    }
+    {
+        PcmDeck &current = m_decks[m_activeDeck.load(std::memory_order_relaxed)];
+        syncEpoch(current);
+        // Only while the decoder is still filling the ring, and not right
+        // after a load or seek when it starts out empty.
+        const qint64 intoEpoch = current.positionFrames.load(std::memory_order_relaxed)
+            - current.epochBaseFrame.load(std::memory_order_relaxed);
+        if (current.endEpoch.load(std::memory_order_relaxed) != current.consumedEpoch.load(std::memory_order_relaxed)
+            && intoEpoch > m_format.sampleRate()) {
+            const qint64 buffered = static_cast<qint64>(current.ring.availableRead()) / channels;
+            qint64 seen = m_minBufferedFrames.load(std::memory_order_relaxed);
+            while (buffered < seen && !m_minBufferedFrames.compare_exchange_weak(seen, buffered, std::memory_order_relaxed)) {
+            }
+        }
+    }
+    while (done < frames) {
+        int active = m_activeDeck.load(std::memory_order_relaxed);
+        PcmDeck &current = m_decks[active];
+        PcmDeck &next = m_decks[1 - active];
+        syncEpoch(current);
+        syncEpoch(next);
+
+        float *destination = output + done * channels;
+        int chunk = qMin(frames - done, static_cast<int>(MaxChunkFrames));
+        int fadeFrames = m_crossfadeFrames.load(std::memory_order_relaxed);
+        qint64 total = deckEndFrame(current);
+        qint64 position = current.positionFrames.load(std::memory_order_relaxed);
+        qint64 fadeStart = total - fadeFrames;
+        bool fading = fadeFrames > 0 && total > 0 && position + chunk > fadeStart
+            && next.armed.load(std::memory_order_acquire);
+        if (fading && position < fadeStart) {
+            chunk = static_cast<int>(fadeStart - position);
+            fading = false;
+        }
+
+        if (fading) {
+            chunk = qMin(chunk, static_cast<int>(FadeChunkFrames));
+            readDeck(current, destination, chunk);
+            readDeck(next, m_mixBuffer.data(), chunk);
+            float outgoingStart, incomingStart, outgoingEnd, incomingEnd;
+            Crossfader::gains(curve, float(position - fadeStart) / fadeFrames, outgoingStart, incomingStart);
+            Crossfader::gains(curve, float(position + chunk - fadeStart) / fadeFrames, outgoingEnd, incomingEnd);
+            for (int frame = 0; frame < chunk; ++frame) {
+                float t = float(frame) / chunk;
+                float outgoing = outgoingStart + (outgoingEnd - outgoingStart) * t;
+                float incoming = incomingStart + (incomingEnd - incomingStart) * t;
+                for (int channel = 0; channel < channels; ++channel) {
+                    int sample = frame * channels + channel;
+                    destination[sample] = destination[sample] * outgoing + m_mixBuffer[sample] * incoming;
+                }
+            }
+            if (deckEnded(current) && next.armed.exchange(false, std::memory_order_acq_rel)) {
+                m_activeDeck.store(1 - active, std::memory_order_release);
+                m_switchCount.fetch_add(1, std::memory_order_release);
+            }
+            produced = true;
+            done += chunk;
+            continue;
+        }
+
+        int got = readDeck(current, destination, chunk);
+        produced = produced || got > 0;
+        if (got < chunk) {
+            if (deckEnded(current)) {
+                if (next.armed.exchange(false, std::memory_order_acq_rel)) {
+                    m_activeDeck.store(1 - active, std::memory_order_release);
+                    m_switchCount.fetch_add(1, std::memory_order_release);
+                    done += got;
+                    continue;
+                }
+                std::fill(destination, output + frames * channels, 0.0f);
+                m_activeEnded.store(true, std::memory_order_release);
+                break;
+            }
+            if (current.ring.writeIndex() > current.epochStartIndex.load(std::memory_order_relaxed)) {
+                m_underruns.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        done += chunk;
+    }
+
+    if (produced && m_awaitingFirstAudio.load(std::memory_order_relaxed)) {
+        m_awaitingFirstAudio.store(false, std::memory_order_relaxed);
+        m_firstAudioTime.store(LatencyTracker::now(), std::memory_order_release);
+    }
+
+    const float targetGain = m_volume.load(std::memory_order_relaxed);
+    if (targetGain != m_appliedGain || targetGain != 1.0f) {
+        const float step = (targetGain - m_appliedGain) / qMax(1, frames);
+        float gain = m_appliedGain;
+        for (int frame = 0; frame < frames; ++frame) {
+            gain += step;
+            for (int channel = 0; channel < channels; ++channel) {
+                output[frame * channels + channel] *= gain;
+            }
+        }
+        m_appliedGain = targetGain;
+    }
+    for (AudioProcessor *processor : m_processors) {
+        processor->process(output, frames, channels);
+    }
+}
@@ -0,0 +1,203 @@
+#ifndef PCMENGINE_H
+#define PCMENGINE_H
+
+#include <QObject>
+#include <QAudioDevice>
+#include <QAudioFormat>
+#include <QAudioSink>
+#include <QIODevice>
+#include <QMediaPlayer>
+#include <QString>
+#include <QThread>
+#include <QTimer>
+#include <atomic>
+#include <vector>
+#include "audioprocessor.h"
+#include "crossfader.h"
+#include "pcmcache.h"
+#include "pcmdecodeworker.h"
+#include "timestretcher.h"
+
+class PcmEngine;
+
+// Pull-mode device handed to QAudioSink; readData() is the audio callback.
+class PcmOutputDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    PcmOutputDevice(PcmEngine *engine, const QAudioFormat &format, QObject *parent = nullptr);
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    // From the engine's stereo float mix to the sink's channels and type.
+    void convert(char *out, int frames) const;
+
+    PcmEngine *m_engine;
+    QAudioFormat m_format;
+    std::vector<float> m_scratch;
+};
+
+// Alternative playback backend: decodes on a worker thread into lock-free
+// rings and renders them from the audio callback, which makes sample-accurate
+// gapless switching, crossfading and DSP stages possible. The control API
+// mirrors the subset of QMediaPlayer used by AudioPlayer.
+class PcmEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PcmEngine(QObject *parent = nullptr);
+    ~PcmEngine();
+
+    void setBufferSizes(int bufferMs, int periodMs);
+    int bufferMs() const { return m_bufferMs; }
+    int periodMs() const { return m_periodMs; }
+    void addProcessor(AudioProcessor *processor);
+    // RAM cap for decoded PCM kept for restarts and seeks back; 0 disables it.
+    void setCacheCapacity(qint64 bytes);
+    qint64 cacheCapacity() const { return m_cache.capacity(); }
+    // Files at another rate than the output are converted with this quality.
+    void setResamplerQuality(Resampler::Quality quality);
+    Resampler::Quality resamplerQuality() const { return m_resamplerQuality; }
+
+    void setSource(const QString &filePath, float gain = 1.0f, qint64 startMs = 0);
+    QString source() const { return m_path; }
+    void setNextSource(const QString &filePath, float gain = 1.0f, qint64 startMs = 0);
+    void clearNextSource();
+    void setSourceGains(float current, float next);
+    // Playback speed per deck; anything but 1 runs through the time stretcher.
+    void setSourceRates(float current, float next);
+    // Cuts the current and next source short, e.g. before trailing silence;
+    // the switch to the next deck and any crossfade happen there. -1 plays
+    // to the end of the file.
+    void setSourceEnds(qint64 currentMs, qint64 nextMs);
+    void play();
+    void pause();
+    void stop();
+    void setPosition(qint64 position);
+    qint64 position() const;
+    qint64 duration() const;
+    QMediaPlayer::PlaybackState playbackState() const { return m_state; }
+    QMediaPlayer::MediaStatus mediaStatus() const { return m_status; }
+    void setVolume(float volume);
+    float volume() const { return m_volume.load(std::memory_order_relaxed); }
+    void setCrossfade(int milliseconds, Crossfader::Curve curve);
+    QAudioFormat outputFormat() const { return m_format; }
+    // Moves playback to another device. While the device takes the current
+    // rate only the sink is rebuilt and the decoded buffers play on.
+    void setOutputDevice(const QAudioDevice &device);
+    QAudioDevice outputDevice() const { return m_outputAudioDevice; }
+    quint64 underrunCount() const { return m_underruns.load(std::memory_order_relaxed); }
+
+    void render(float *output, int frames);
+
+signals:
+    void positionChanged(qint64 position);
+    void durationChanged(qint64 duration);
+    void playbackStateChanged(QMediaPlayer::PlaybackState state);
+    void mediaStatusChanged(QMediaPlayer::MediaStatus status);
+    void errorOccurred(const QString &error);
+    void sourceAdvanced();
+    // Monotonic timestamp (LatencyTracker::now()) of the first rendered
+    // frame after the output was started.
+    void firstAudio(qint64 timestamp);
+    // Glitch evidence, reported from poll(): new underruns since the last
+    // report, the decoded buffer dipping below a quarter of its size while
+    // the decoder should be keeping up, and the audio callback running late
+    // by more than the sink buffer.
+    void underrun(quint64 count);
+    void bufferLow(qint64 bufferedMs);
+    void lateCallback(double gapMs);
+
+private slots:
+    void poll();
+
+private:
+    static const int DeckCount = 2;
+    static const int MaxChunkFrames = 1024;
+    static const int FadeChunkFrames = 128;
+
+    static QAudioFormat chooseFormat(const QAudioDevice &device);
+    static int nativeSampleRate(const QString &filePath);
+    void allocateBuffers();
+    void releaseOutput();
+    void applyFormat(const QAudioFormat &format);
+    void matchOutputRate(const QString &filePath);
+    void loadDeck(int deck, const QString &filePath, qint64 startMs);
+    void discardStaleDeck(int deck);
+    void unloadDeck(int deck);
+    void onWorkerLoaded(int deck, quint64 requestId);
+    void onWorkerDuration(int deck, quint64 requestId, qint64 duration);
+    void onWorkerError(int deck, quint64 requestId, const QString &error);
+    void startOutput();
+    void suspendOutput();
+    void stopOutput();
+    void setState(QMediaPlayer::PlaybackState state);
+    void setStatus(QMediaPlayer::MediaStatus status);
+    qint64 framesToMs(qint64 frames) const;
+
+    int deckIndex(const PcmDeck &deck) const { return static_cast<int>(&deck - m_decks); }
+    void syncEpoch(PcmDeck &deck);
+    qint64 deckEndFrame(const PcmDeck &deck) const;
+    bool deckEnded(const PcmDeck &deck) const;
+    int readDeck(PcmDeck &deck, float *destination, int frames);
+
+    PcmCache m_cache;
+    PcmDeck m_decks[DeckCount];
+    TimeStretcher m_stretchers[DeckCount];
+    PcmDecodeWorker *m_workers[DeckCount];
+    quint64 m_requestIds[DeckCount];
+    quint64 m_requestCounter;
+    QThread m_decodeThread;
+    QThread m_outputThread;
+    QObject *m_outputContext;
+    QAudioDevice m_outputAudioDevice;
+    QAudioSink *m_sink;
+    PcmOutputDevice *m_outputDevice;
+    QAudioFormat m_format;
+    QAudioFormat m_decodeFormat;
+    QTimer m_pollTimer;
+    std::vector<AudioProcessor *> m_processors;
+    Resampler::Quality m_resamplerQuality;
+
+    QString m_path;
+    QString m_nextPath;
+    qint64 m_nextStartMs;
+    int m_bufferMs;
+    int m_periodMs;
+    QMediaPlayer::PlaybackState m_state;
+    QMediaPlayer::MediaStatus m_status;
+    bool m_activeLoaded;
+    bool m_restartOnPlay;
+    bool m_outputRunning;
+    quint32 m_seenSwitchCount;
+    qint64 m_lastPosition;
+    qint64 m_lastDuration;
+    quint64 m_seenUnderruns;
+    bool m_bufferLow;
+
+    std::atomic<int> m_activeDeck;
+    std::atomic<quint32> m_switchCount;
+    std::atomic<bool> m_activeEnded;
+    std::atomic<float> m_volume;
+    std::atomic<int> m_crossfadeFrames;
+    std::atomic<int> m_crossfadeCurve;
+    std::atomic<quint64> m_underruns;
+    std::atomic<bool> m_awaitingFirstAudio;
+    std::atomic<qint64> m_firstAudioTime;
+    std::atomic<qint64> m_lastRenderTime;
+    std::atomic<qint64> m_maxRenderGap;
+    std::atomic<qint64> m_minBufferedFrames;
+
+    std::vector<float> m_mixBuffer;
+    float m_appliedGain;
+};
+
+#endif
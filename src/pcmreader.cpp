@@ -0,0 +1,112 @@
+#include "pcmreader.h"
+#include "mappedfile.h"
+#include <QAudioBuffer>
+#include <QAudioDecoder>
+#include <QAudioFormat>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QTimer>
+#include <QUrl>
+#include <cstring>
+#include <vector>
+
+bool PcmReader::decode(const QString &filePath, const Sink &sink,
+                       const std::atomic<bool> *cancelled, QString *error)
+{
+    if (!QFileInfo::exists(filePath)) {
+        if (error) {
+            *error = QString("Файл не найден: %1").arg(filePath);
+        }
+        return false;
+    }
+
+    QAudioFormat format;
+    format.setSampleRate(SampleRate);
+    format.setChannelCount(Channels);
+    format.setSampleFormat(QAudioFormat::Float);
+
+    QSharedPointer<MappedFile> mapping = MappedFile::isEnabled() ? MappedFile::acquire(filePath) : QSharedPointer<MappedFile>();
+    MappedFileDevice device(mapping);
+    QAudioDecoder decoder;
+    decoder.setAudioFormat(format);
+    if (mapping && device.open(QIODevice::ReadOnly)) {
+        decoder.setSourceDevice(&device);
+    } else {
+        decoder.setSource(QUrl::fromLocalFile(filePath));
+    }
+
+    QEventLoop loop;
+    QString decodeError;
+    bool aborted = false;
+    bool done = false;
+    std::vector<float> samples;
+
+    QObject::connect(&decoder, &QAudioDecoder::bufferReady, &loop, [&]() {
+        while (decoder.bufferAvailable()) {
+            QAudioBuffer buffer = decoder.read();
+            const QAudioFormat bufferFormat = buffer.format();
+            const int channels = bufferFormat.channelCount();
+            const int frames = static_cast<int>(buffer.frameCount());
+            if (!buffer.isValid() || channels <= 0 || frames <= 0) {
+                continue;
+            }
+            samples.resize(static_cast<size_t>(frames) * Channels);
+            const char *data = buffer.constData<char>();
+            if (bufferFormat.sampleFormat() == QAudioFormat::Float && channels == Channels) {
+                std::memcpy(samples.data(), data, samples.size() * sizeof(float));
+            } else {
+                const int bytesPerSample = bufferFormat.bytesPerSample();
+                for (int frame = 0; frame < frames; ++frame) {
+                    float left = bufferFormat.normalizedSampleValue(data);
+                    float right = channels > 1 ? bufferFormat.normalizedSampleValue(data + bytesPerSample) : left;
+                    samples[frame * Channels] = left;
+                    samples[frame * Channels + 1] = right;
+                    data += bufferFormat.bytesPerFrame();
+                }
+            }
+            sink(samples.data(), frames, bufferFormat.sampleRate());
+        }
+    });
+    QObject::connect(&decoder, &QAudioDecoder::finished, &loop, [&]() {
+        done = true;
+        loop.quit();
+    });
+    QObject::connect(&decoder, QOverload<QAudioDecoder::Error>::of(&QAudioDecoder::error),
+                     &loop, [&](QAudioDecoder::Error) {
+        decodeError = decoder.errorString();
+        done = true;
+        loop.quit();
+    });
+
+    QTimer cancelTimer;
+    if (cancelled) {
+        cancelTimer.setInterval(100);
+        QObject::connect(&cancelTimer, &QTimer::timeout, &loop, [&]() {
+            if (cancelled->load(std::memory_order_relaxed)) {
+                aborted = true;
+                loop.quit();
+            }
+        });
+        cancelTimer.start();
+    }
+
+    decoder.start();
+    if (!done) {
+        loop.exec();
+    }
+    decoder.stop();
+
+    if (aborted) {
+        if (error) {
+            *error = "Отменено";
+        }
+        return false;
+    }
+    if (!decodeError.isEmpty()) {
+        if (error) {
+            *error = decodeError;
+        }
+        return false;
+    }
+    return true;
+}
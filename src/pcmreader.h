@@ -0,0 +1,23 @@
+#ifndef PCMREADER_H
+#define PCMREADER_H
+
+#include <QString>
+#include <atomic>
+#include <functional>
+
+// Synchronous decoder for background analysis. Runs QAudioDecoder in a local
+// event loop on the calling thread and hands interleaved stereo float blocks
+// to the sink, so several analysers can share one decode pass.
+class PcmReader
+{
+public:
+    static const int SampleRate = 48000;
+    static const int Channels = 2;
+
+    using Sink = std::function<void(const float *interleaved, int frames, int sampleRate)>;
+
+    static bool decode(const QString &filePath, const Sink &sink,
+                       const std::atomic<bool> *cancelled = nullptr, QString *error = nullptr);
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include "peakextractor.h"
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PEAKS_USE_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PEAKS_USE_NEON
+#include <arm_neon.h>
+#endif
+
+static const quint32 kPeakFileMagic = 0x41504b31;
+static const quint16 kPeakFileVersion = 1;
+
+const QByteArray &WaveformPeaks::levelFor(int width) const
+{
+    // The coarsest level that still has at least one bucket per pixel.
+    int best = 0;
+    for (int level = 1; level < levels.size(); ++level) {
+        if (levels[level].size() / 2 < width) {
+            break;
+        }
+        best = level;
+    }
+    return levels[best];
+}
+
+PeakExtractor::PeakExtractor()
+    : m_minimum(0.0f)
+    , m_maximum(0.0f)
+    , m_fill(0)
+{
+}
+
+void PeakExtractor::minMax(const float *samples, int count, float &minimum, float &maximum)
+{
+    int index = 0;
+#if defined(PEAKS_USE_SSE)
+    if (count >= 8) {
+        __m128 low = _mm_loadu_ps(samples);
+        __m128 high = low;
+        for (index = 4; index + 4 <= count; index += 4) {
+            __m128 value = _mm_loadu_ps(samples + index);
+            low = _mm_min_ps(low, value);
+            high = _mm_max_ps(high, value);
+        }
+        low = _mm_min_ps(low, _mm_movehl_ps(low, low));
+        low = _mm_min_ss(low, _mm_shuffle_ps(low, low, 1));
+        high = _mm_max_ps(high, _mm_movehl_ps(high, high));
+        high = _mm_max_ss(high, _mm_shuffle_ps(high, high, 1));
+        minimum = std::min(minimum, _mm_cvtss_f32(low));
+        maximum = std::max(maximum, _mm_cvtss_f32(high));
+    }
+#elif defined(PEAKS_USE_NEON)
+    if (count >= 8) {
+        float32x4_t low = vld1q_f32(samples);
+        float32x4_t high = low;
+        for (index = 4; index + 4 <= count; index += 4) {
+            float32x4_t value = vld1q_f32(samples + index);
+            low = vminq_f32(low, value);
+            high = vmaxq_f32(high, value);
+        }
+        float32x2_t low2 = vpmin_f32(vget_low_f32(low), vget_high_f32(low));
+        float32x2_t high2 = vpmax_f32(vget_low_f32(high), vget_high_f32(high));
+        minimum = std::min(minimum, std::min(vget_lane_f32(low2, 0), vget_lane_f32(low2, 1)));
+        maximum = std::max(maximum, std::max(vget_lane_f32(high2, 0), vget_lane_f32(high2, 1)));
+    }
+#endif
+    for (; index < count; ++index) {
+        minimum = std::min(minimum, samples[index]);
+        maximum = std::max(maximum, samples[index]);
+    }
+}
+
+void PeakExtractor::process(const float *interleaved, int frames)
+{
+    while (frames > 0) {
+        int chunk = std::min(frames, ChunkFrames - m_fill);
+        minMax(interleaved, chunk * 2, m_minimum, m_maximum);
+        m_fill += chunk;
+        interleaved += chunk * 2;
+        frames -= chunk;
+        if (m_fill == ChunkFrames) {
+            m_fine.push_back(m_minimum);
+            m_fine.push_back(m_maximum);
+            m_minimum = 0.0f;
+            m_maximum = 0.0f;
+            m_fill = 0;
+        }
+    }
+}
+
+WaveformPeaks PeakExtractor::finish() const
+{
+    std::vector<float> fine = m_fine;
+    if (m_fill > 0) {
+        fine.push_back(m_minimum);
+        fine.push_back(m_maximum);
+    }
+    WaveformPeaks peaks;
+    const int chunks = static_cast<int>(fine.size() / 2);
+    if (chunks == 0) {
+        return peaks;
+    }
+
+    auto quantize = [](float value) {
+        return static_cast<char>(static_cast<qint8>(std::clamp(static_cast<int>(std::lround(value * 127.0f)), -127, 127)));
+    };
+    const int buckets = std::min(chunks, static_cast<int>(BucketCount));
+    QByteArray base(buckets * 2, '\0');
+    for (int bucket = 0; bucket < buckets; ++bucket) {
+        int first = static_cast<int>(qint64(bucket) * chunks / buckets);
+        int last = std::max(first + 1, static_cast<int>(qint64(bucket + 1) * chunks / buckets));
+        float minimum = 0.0f;
+        float maximum = 0.0f;
+        for (int chunk = first; chunk < last; ++chunk) {
+            minimum = std::min(minimum, fine[chunk * 2]);
+            maximum = std::max(maximum, fine[chunk * 2 + 1]);
+        }
+        base[bucket * 2] = quantize(minimum);
+        base[bucket * 2 + 1] = quantize(maximum);
+    }
+    peaks.levels << base;
+
+    for (int level = 1; level < LevelCount; ++level) {
+        const QByteArray &previous = peaks.levels.last();
+        int count = static_cast<int>(previous.size() / 2) / 2;
+        if (count == 0) {
+            break;
+        }
+        QByteArray coarse(count * 2, '\0');
+        for (int bucket = 0; bucket < count; ++bucket) {
+            qint8 minimum = std::min(qint8(previous[bucket * 4]), qint8(previous[bucket * 4 + 2]));
+            qint8 maximum = std::max(qint8(previous[bucket * 4 + 1]), qint8(previous[bucket * 4 + 3]));
+            coarse[bucket * 2] = static_cast<char>(minimum);
+            coarse[bucket * 2 + 1] = static_cast<char>(maximum);
+        }
+        peaks.levels << coarse;
+    }
+    return peaks;
+}
+
+QString PeakExtractor::peakFilePath(int trackId)
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/peaks";
+    return dir + QString("/%1.peaks").arg(trackId);
+}
+
+bool PeakExtractor::save(const WaveformPeaks &peaks, const QString &filePath)
+{
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream << kPeakFileMagic << kPeakFileVersion << static_cast<quint32>(peaks.levels.size());
+    for (const QByteArray &level : peaks.levels) {
+        stream << level;
+    }
+    return file.commit();
+}
+
+bool PeakExtractor::load(const QString &filePath, WaveformPeaks &peaks)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint32 levelCount = 0;
+    stream >> magic >> version >> levelCount;
+    if (magic != kPeakFileMagic || version != kPeakFileVersion || levelCount > LevelCount) {
+        return false;
+    }
+    WaveformPeaks loaded;
+    for (quint32 level = 0; level < levelCount; ++level) {
+        QByteArray data;
+        stream >> data;
+        loaded.levels << data;
+    }
+    if (stream.status() != QDataStream::Ok || loaded.isEmpty()) {
+        return false;
+    }
+    peaks = loaded;
+    return true;
+}
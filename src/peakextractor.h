@@ -0,0 +1,46 @@
+#ifndef PEAKEXTRACTOR_H
+#define PEAKEXTRACTOR_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <vector>
+
+// Waveform overview: level 0 holds up to BucketCount interleaved min/max
+// pairs quantised to signed 8 bit, every further level halves the resolution.
+struct WaveformPeaks {
+    QList<QByteArray> levels;
+
+    bool isEmpty() const { return levels.isEmpty() || levels.first().isEmpty(); }
+    const QByteArray &levelFor(int width) const;
+};
+
+// Collects min/max peaks from interleaved stereo float blocks during an
+// analysis decode pass and stores them as a small per-track file.
+class PeakExtractor
+{
+public:
+    static const int BucketCount = 2048;
+    static const int LevelCount = 4;
+
+    PeakExtractor();
+
+    void process(const float *interleaved, int frames);
+    WaveformPeaks finish() const;
+
+    static QString peakFilePath(int trackId);
+    static bool save(const WaveformPeaks &peaks, const QString &filePath);
+    static bool load(const QString &filePath, WaveformPeaks &peaks);
+
+private:
+    static const int ChunkFrames = 256;
+
+    static void minMax(const float *samples, int count, float &minimum, float &maximum);
+
+    std::vector<float> m_fine;
+    float m_minimum;
+    float m_maximum;
+    int m_fill;
+};
+
+#endif
@@ -62,6 +62,7 @@ void PlaylistModel::setTracks(const QList<TrackInfo> &tracks)
 {
     beginResetModel();
     m_tracks = tracks;
+    rebuildIndex();
     endResetModel();
 }
 
@@ -69,6 +70,9 @@ void PlaylistModel::addTrack(const TrackInfo &track)
 {
     beginInsertRows(QModelIndex(), m_tracks.size(), m_tracks.size());
     m_tracks.append(track);
+    if (!m_rowById.contains(track.id)) {
+        m_rowById.insert(track.id, m_tracks.size() - 1);
+    }
     endInsertRows();
 }
 
@@ -80,6 +84,7 @@ void PlaylistModel::removeTrack(int index)
     
     beginRemoveRows(QModelIndex(), index, index);
     m_tracks.removeAt(index);
+    rebuildIndex();
     endRemoveRows();
 }
 
@@ -87,6 +92,7 @@ void PlaylistModel::clear()
 {
     beginResetModel();
     m_tracks.clear();
+    m_rowById.clear();
     endResetModel();
 }
 
@@ -100,3 +106,24 @@ TrackInfo PlaylistModel::trackAt(int index) const
     return empty;
 }
 
+const TrackInfo &PlaylistModel::trackRef(int index) const
+{
+    static const TrackInfo empty = [] {
+        TrackInfo track;
+        track.id = -1;
+        return track;
+    }();
+    if (index >= 0 && index < m_tracks.size()) {
+        return m_tracks[index];
+    }
+    return empty;
+}
+
+void PlaylistModel::rebuildIndex()
+{
+    m_rowById.clear();
+    m_rowById.reserve(m_tracks.size());
+    for (int row = m_tracks.size() - 1; row >= 0; --row) {
+        m_rowById.insert(m_tracks[row].id, row);
+    }
+}
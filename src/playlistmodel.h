@@ -3,6 +3,7 @@
 
 #include <QAbstractListModel>
 #include <QList>
+#include <QHash>
 #include "databasemanager.h"
 
 class PlaylistModel : public QAbstractListModel
@@ -32,10 +33,17 @@ public:
     void removeTrack(int index);
     void clear();
     TrackInfo trackAt(int index) const;
+    const TrackInfo &trackRef(int index) const;
+    int rowForTrackId(int trackId) const { return m_rowById.value(trackId, -1); }
     int trackCount() const { return m_tracks.size(); }
+    const QList<TrackInfo> &tracks() const { return m_tracks; }
 
 private:
+    void rebuildIndex();
+
     QList<TrackInfo> m_tracks;
+    // First row of each track id.
+    QHash<int, int> m_rowById;
 };
 
 #endif
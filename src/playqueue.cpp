@@ -0,0 +1,259 @@
+#include "playqueue.h"
+#include <QRandomGenerator>
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+static TrackInfo noTrack()
+{
+    TrackInfo track;
+    track.id = -1;
+    return track;
+}
+
+PlayQueue::PlayQueue()
+    : m_generated(0)
+    , m_position(-1)
+    , m_current(-1)
+    , m_shuffle(false)
+{
+    m_back.reserve(HistoryLimit);
+}
+
+void PlayQueue::setTracks(const QList<TrackInfo> &tracks, int startIndex)
+{
+    m_tracks = tracks;
+    m_extra.clear();
+    m_freeExtra.clear();
+    m_back.clear();
+    m_forward.clear();
+    const int count = static_cast<int>(m_tracks.size());
+    m_order.resize(count);
+    m_positionOf.resize(count);
+    std::iota(m_order.begin(), m_order.end(), 0);
+    std::iota(m_positionOf.begin(), m_positionOf.end(), 0);
+    m_current = startIndex >= 0 && startIndex < count ? startIndex : -1;
+    if (m_shuffle) {
+        restartPass(m_current);
+    } else {
+        m_generated = 0;
+        m_position = m_current;
+    }
+}
+
+void PlayQueue::clear()
+{
+    m_upNext.clear();
+    setTracks(QList<TrackInfo>(), -1);
+}
+
+void PlayQueue::setShuffle(bool enabled)
+{
+    m_shuffle = enabled;
+    clearForward();
+    const bool inOrder = m_current >= 0 && m_current < m_tracks.size();
+    if (m_shuffle) {
+        restartPass(inOrder ? m_current : -1);
+    } else {
+        m_position = inOrder ? m_current : -1;
+    }
+}
+
+TrackInfo PlayQueue::current() const
+{
+    return trackAt(m_current);
+}
+
+TrackInfo PlayQueue::next(bool wrap)
+{
+    int entry = -1;
+    if (!m_upNext.empty()) {
+        entry = addExtra(m_upNext.front());
+        m_upNext.pop_front();
+    } else if (!m_forward.empty()) {
+        entry = m_forward.back();
+        m_forward.pop_back();
+    } else {
+        entry = nextInOrder(wrap, true);
+        if (entry < 0) {
+            return noTrack();
+        }
+    }
+    pushBack(m_current);
+    moveTo(entry);
+    return trackAt(entry);
+}
+
+TrackInfo PlayQueue::previous()
+{
+    int entry = -1;
+    if (!m_back.empty()) {
+        entry = m_back.back();
+        m_back.pop_back();
+    } else if (!m_shuffle && !m_tracks.isEmpty()) {
+        entry = m_position > 0 ? m_position - 1 : static_cast<int>(m_tracks.size()) - 1;
+    } else {
+        return noTrack();
+    }
+    if (m_current >= 0) {
+        m_forward.push_back(m_current);
+    }
+    moveTo(entry);
+    return trackAt(entry);
+}
+
+TrackInfo PlayQueue::peekNext(bool wrap)
+{
+    if (!m_upNext.empty()) {
+        return m_upNext.front();
+    }
+    if (!m_forward.empty()) {
+        return trackAt(m_forward.back());
+    }
+    return trackAt(nextInOrder(wrap, false));
+}
+
+void PlayQueue::playNext(const TrackInfo &track)
+{
+    if (track.id >= 0) {
+        m_upNext.push_front(track);
+    }
+}
+
+void PlayQueue::playNow(const TrackInfo &track)
+{
+    if (track.id < 0) {
+        return;
+    }
+    pushBack(m_current);
+    clearForward();
+    moveTo(addExtra(track));
+}
+
+TrackInfo PlayQueue::trackAt(int entry) const
+{
+    if (entry < 0) {
+        return noTrack();
+    }
+    if (entry < m_tracks.size()) {
+        return m_tracks.at(entry);
+    }
+    entry -= static_cast<int>(m_tracks.size());
+    return entry < m_extra.size() ? m_extra.at(entry) : noTrack();
+}
+
+int PlayQueue::addExtra(const TrackInfo &track)
+{
+    if (!m_freeExtra.empty()) {
+        const int slot = m_freeExtra.back();
+        m_freeExtra.pop_back();
+        m_extra[slot] = track;
+        return static_cast<int>(m_tracks.size()) + slot;
+    }
+    m_extra.append(track);
+    return static_cast<int>(m_tracks.size() + m_extra.size() - 1);
+}
+
+void PlayQueue::releaseExtra(int entry)
+{
+    const int slot = entry - static_cast<int>(m_tracks.size());
+    if (slot < 0 || slot >= m_extra.size() || entry == m_current) {
+        return;
+    }
+    // The stacks hold at most a few thousand entries.
+    if (std::find(m_back.begin(), m_back.end(), entry) != m_back.end()
+        || std::find(m_forward.begin(), m_forward.end(), entry) != m_forward.end()) {
+        return;
+    }
+    m_extra[slot] = noTrack();
+    m_freeExtra.push_back(slot);
+}
+
+void PlayQueue::clearForward()
+{
+    std::vector<int> dropped;
+    dropped.swap(m_forward);
+    for (int entry : dropped) {
+        releaseExtra(entry);
+    }
+}
+
+int PlayQueue::nextInOrder(bool wrap, bool consume)
+{
+    const int count = static_cast<int>(m_tracks.size());
+    if (count == 0) {
+        return -1;
+    }
+    int position = m_position + 1;
+    if (position >= count) {
+        if (!wrap) {
+            return -1;
+        }
+        // A finished pass is reshuffled once, whether by a peek or a step.
+        if (m_shuffle && m_generated == count) {
+            m_generated = 0;
+        }
+        position = 0;
+    }
+    if (consume) {
+        m_position = position;
+    }
+    if (!m_shuffle) {
+        return position;
+    }
+    generate(position);
+    return m_order[position];
+}
+
+void PlayQueue::generate(int position)
+{
+    const int count = static_cast<int>(m_order.size());
+    QRandomGenerator *random = QRandomGenerator::global();
+    for (; m_generated <= position && m_generated < count; ++m_generated) {
+        int pick = m_generated + static_cast<int>(random->bounded(count - m_generated));
+        std::swap(m_order[m_generated], m_order[pick]);
+        m_positionOf[m_order[m_generated]] = m_generated;
+        m_positionOf[m_order[pick]] = pick;
+    }
+}
+
+void PlayQueue::restartPass(int firstEntry)
+{
+    m_generated = 0;
+    m_position = -1;
+    if (firstEntry < 0) {
+        return;
+    }
+    int from = m_positionOf[firstEntry];
+    std::swap(m_order[0], m_order[from]);
+    m_positionOf[m_order[0]] = 0;
+    m_positionOf[m_order[from]] = from;
+    m_generated = 1;
+    m_position = 0;
+}
+
+void PlayQueue::moveTo(int entry)
+{
+    const int previous = m_current;
+    m_current = entry;
+    releaseExtra(previous);
+    // In shuffle the pass position only moves forward through new draws.
+    if (!m_shuffle && entry < m_tracks.size()) {
+        m_position = entry;
+    }
+}
+
+void PlayQueue::pushBack(int entry)
+{
+    if (entry < 0) {
+        return;
+    }
+    if (m_back.size() >= static_cast<size_t>(HistoryLimit)) {
+        const std::vector<int> dropped(m_back.begin(), m_back.begin() + HistoryLimit / 2);
+        m_back.erase(m_back.begin(), m_back.begin() + HistoryLimit / 2);
+        for (int old : dropped) {
+            releaseExtra(old);
+        }
+    }
+    m_back.push_back(entry);
+}
@@ -0,0 +1,61 @@
+#ifndef PLAYQUEUE_H
+#define PLAYQUEUE_H
+
+#include <QList>
+#include <deque>
+#include <vector>
+#include "databasemanager.h"
+
+// Play order over a snapshot of a track list, independent of what the view
+// shows afterwards. Shuffle walks a Fisher–Yates permutation that is drawn
+// one position at a time, so every track plays once per pass; previous goes
+// back through what was actually played.
+class PlayQueue
+{
+public:
+    static const int HistoryLimit = 1000;
+
+    PlayQueue();
+
+    void setTracks(const QList<TrackInfo> &tracks, int startIndex);
+    void clear();
+    void setShuffle(bool enabled);
+    bool shuffle() const { return m_shuffle; }
+
+    TrackInfo current() const;
+    TrackInfo next(bool wrap);
+    TrackInfo previous();
+    TrackInfo peekNext(bool wrap);
+    void playNext(const TrackInfo &track);
+    void playNow(const TrackInfo &track);
+    int upNextCount() const { return static_cast<int>(m_upNext.size()); }
+    bool isEmpty() const { return m_current < 0; }
+
+private:
+    TrackInfo trackAt(int entry) const;
+    int addExtra(const TrackInfo &track);
+    void releaseExtra(int entry);
+    void clearForward();
+    int nextInOrder(bool wrap, bool consume);
+    void generate(int position);
+    void restartPass(int firstEntry);
+    void moveTo(int entry);
+    void pushBack(int entry);
+
+    QList<TrackInfo> m_tracks;
+    // Tracks played from outside the list; slots no longer referenced by
+    // the current entry or the back/forward stacks are reused.
+    QList<TrackInfo> m_extra;
+    std::vector<int> m_freeExtra;
+    std::vector<int> m_order;
+    std::vector<int> m_positionOf;
+    int m_generated;
+    int m_position;
+    int m_current;
+    bool m_shuffle;
+    std::vector<int> m_back;
+    std::vector<int> m_forward;
+    std::deque<TrackInfo> m_upNext;
+};
+
+#endif
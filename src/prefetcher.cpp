@@ -0,0 +1,128 @@
+#include "prefetcher.h"
+#include <QFile>
+#include <QThreadPool>
+#include <vector>
+
+#if defined(Q_OS_LINUX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static const qint64 kReadChunk = 256 * 1024;
+
+Prefetcher::Prefetcher(QObject *parent)
+    : QObject(parent)
+    , m_byteCap(DefaultByteCap)
+    , m_bytes(0)
+{
+}
+
+void Prefetcher::prefetch(const QString &filePath)
+{
+    if (filePath.isEmpty() || filePath == m_filePath || m_byteCap == 0) {
+        return;
+    }
+    m_filePath = filePath;
+    m_bytes = m_byteCap;
+    m_done = std::make_shared<std::atomic<bool>>(false);
+    ++m_stats.requested;
+
+    m_mapping = MappedFile::isEnabled() ? MappedFile::acquire(filePath) : QSharedPointer<MappedFile>();
+
+    std::shared_ptr<std::atomic<bool>> done = m_done;
+    QSharedPointer<MappedFile> mapping = m_mapping;
+    const qint64 bytes = m_bytes;
+    QThreadPool::globalInstance()->start([filePath, bytes, done, mapping]() {
+        if (mapping) {
+            mapping->willNeed(0, bytes);
+        } else {
+            readAhead(filePath, bytes);
+        }
+        done->store(true, std::memory_order_release);
+    });
+}
+
+void Prefetcher::trackStarted(const QString &filePath)
+{
+    if (m_filePath.isEmpty()) {
+        return;
+    }
+    if (filePath != m_filePath) {
+        // Playback went elsewhere; the read-ahead is not reported.
+        m_filePath.clear();
+        m_done.reset();
+        return;
+    }
+    const bool inTime = m_done->load(std::memory_order_acquire);
+    const double resident = residentFraction(filePath, m_bytes);
+    ++m_stats.started;
+    if (inTime) {
+        ++m_stats.inTime;
+    } else {
+        ++m_stats.late;
+    }
+    if (resident >= 0.0) {
+        m_stats.residentSum += resident;
+        ++m_stats.residentSamples;
+    }
+    m_filePath.clear();
+    m_done.reset();
+    emit prefetchReported(filePath, inTime, resident);
+}
+
+void Prefetcher::readAhead(const QString &filePath, qint64 bytes)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        return;
+    }
+    bytes = qMin(bytes, file.size());
+#if defined(Q_OS_LINUX)
+    // Let the kernel start the whole range at once; the reads below then
+    // only wait for it, and still work where the hint is ignored.
+    posix_fadvise(file.handle(), 0, bytes, POSIX_FADV_WILLNEED);
+#endif
+    std::vector<char> buffer(static_cast<size_t>(qMin(bytes, kReadChunk)));
+    for (qint64 offset = 0; offset < bytes; ) {
+        qint64 read = file.read(buffer.data(), qMin<qint64>(buffer.size(), bytes - offset));
+        if (read <= 0) {
+            break;
+        }
+        offset += read;
+    }
+}
+
+double Prefetcher::residentFraction(const QString &filePath, qint64 bytes)
+{
+#if defined(Q_OS_LINUX)
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return -1.0;
+    }
+    bytes = qMin(bytes, file.size());
+    if (bytes <= 0) {
+        return -1.0;
+    }
+    void *address = mmap(nullptr, static_cast<size_t>(bytes), PROT_READ, MAP_SHARED, file.handle(), 0);
+    if (address == MAP_FAILED) {
+        return -1.0;
+    }
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    std::vector<unsigned char> pages(static_cast<size_t>((bytes + pageSize - 1) / pageSize));
+    double fraction = -1.0;
+    if (mincore(address, static_cast<size_t>(bytes), pages.data()) == 0) {
+        size_t resident = 0;
+        for (unsigned char page : pages) {
+            resident += page & 1;
+        }
+        fraction = static_cast<double>(resident) / pages.size();
+    }
+    munmap(address, static_cast<size_t>(bytes));
+    return fraction;
+#else
+    Q_UNUSED(filePath)
+    Q_UNUSED(bytes)
+    return -1.0;
+#endif
+}
@@ -0,0 +1,60 @@
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <atomic>
+#include <memory>
+#include "mappedfile.h"
+
+// Warms the page cache with the head of the next track's file shortly before
+// it is opened, so a cold disk or network mount does not stall its start.
+// When the track does start, records whether the read-ahead had finished
+// and how much of the range is resident.
+class Prefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Stats {
+        int requested = 0;
+        int started = 0;
+        int inTime = 0;
+        int late = 0;
+        double residentSum = 0.0;
+        int residentSamples = 0;
+    };
+
+    static const qint64 DefaultByteCap = 16 * 1024 * 1024;
+
+    explicit Prefetcher(QObject *parent = nullptr);
+
+    void setByteCap(qint64 bytes) { m_byteCap = qMax<qint64>(0, bytes); }
+    qint64 byteCap() const { return m_byteCap; }
+
+    void prefetch(const QString &filePath);
+    void trackStarted(const QString &filePath);
+    Stats stats() const { return m_stats; }
+    void resetStats() { m_stats = Stats(); }
+
+    // Share of the first bytes of the file in the page cache, or -1 where the
+    // platform cannot tell.
+    static double residentFraction(const QString &filePath, qint64 bytes);
+
+signals:
+    void prefetchReported(const QString &filePath, bool completedInTime, double residentFraction);
+
+private:
+    static void readAhead(const QString &filePath, qint64 bytes);
+
+    qint64 m_byteCap;
+    QString m_filePath;
+    qint64 m_bytes;
+    std::shared_ptr<std::atomic<bool>> m_done;
+    // Held until the next prefetch so the player opens the same mapping.
+    QSharedPointer<MappedFile> m_mapping;
+    Stats m_stats;
+};
+
+#endif
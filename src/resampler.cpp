@@ -0,0 +1,171 @@
+#include "resampler.h"
+#include "dotproduct.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+static const double kPi = 3.14159265358979323846;
+
+struct QualityParameters {
+    int taps;
+    double beta;        // Kaiser window shape
+    double passband;    // share of the lower Nyquist frequency kept
+};
+
+static const QualityParameters kQualities[Resampler::QualityCount] = {
+    {16, 5.7, 0.80},
+    {32, 8.0, 0.90},
+    {64, 10.0, 0.95},
+};
+
+static double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+Resampler::Resampler()
+    : m_inputRate(0)
+    , m_outputRate(0)
+    , m_quality(Standard)
+    , m_taps(0)
+    , m_upFactor(1)
+    , m_downFactor(1)
+    , m_tablePhases(1)
+    , m_bufferFrames(0)
+    , m_index(0)
+    , m_phase(0)
+{
+}
+
+void Resampler::configure(int inputRate, int outputRate, Quality quality)
+{
+    if (inputRate <= 0 || outputRate <= 0) {
+        m_inputRate = m_outputRate = 0;
+        return;
+    }
+    const QualityParameters &parameters = kQualities[quality];
+    const int divisor = std::gcd(inputRate, outputRate);
+    m_inputRate = inputRate;
+    m_outputRate = outputRate;
+    m_quality = quality;
+    m_taps = parameters.taps;
+    m_upFactor = outputRate / divisor;
+    m_downFactor = inputRate / divisor;
+    m_tablePhases = std::min(m_upFactor, static_cast<int>(MaxPhases));
+
+    // Cutoff in cycles per input sample; below the output Nyquist frequency
+    // when downsampling.
+    const double cutoff = 0.5 * parameters.passband * std::min(1.0, double(outputRate) / inputRate);
+    const double half = m_taps / 2.0;
+    const double window = besselI0(parameters.beta);
+    m_coefficients.assign(static_cast<size_t>(m_tablePhases) * m_taps, 0.0f);
+    std::vector<double> values(m_taps);
+    for (int phase = 0; phase < m_tablePhases; ++phase) {
+        const double fraction = double(phase) / m_tablePhases;
+        float *row = m_coefficients.data() + static_cast<size_t>(phase) * m_taps;
+        double sum = 0.0;
+        for (int tap = 0; tap < m_taps; ++tap) {
+            // Distance of the input sample from the output instant.
+            const double x = tap - (half - 1.0) - fraction;
+            const double argument = 2.0 * cutoff * x;
+            const double sinc = std::abs(argument) < 1e-12 ? 1.0 : std::sin(kPi * argument) / (kPi * argument);
+            const double position = x / half;
+            const double shape = std::abs(position) >= 1.0
+                ? 0.0 : besselI0(parameters.beta * std::sqrt(1.0 - position * position)) / window;
+            values[tap] = sinc * shape;
+            sum += values[tap];
+        }
+        // Unity gain at DC for every phase.
+        for (int tap = 0; tap < m_taps; ++tap) {
+            row[tap] = static_cast<float>(values[tap] / sum);
+        }
+    }
+    reset();
+}
+
+void Resampler::reset()
+{
+    // Half a filter of silence in front puts output frame 0 on input frame 0.
+    const int lead = m_taps / 2 - 1;
+    m_left.assign(std::max(lead, 0), 0.0f);
+    m_right.assign(std::max(lead, 0), 0.0f);
+    m_bufferFrames = std::max(lead, 0);
+    m_index = 0;
+    m_phase = 0;
+}
+
+void Resampler::process(const float *input, int frames, std::vector<float> &output)
+{
+    if (!isConfigured() || frames <= 0) {
+        return;
+    }
+    m_left.resize(static_cast<size_t>(m_bufferFrames) + frames);
+    m_right.resize(static_cast<size_t>(m_bufferFrames) + frames);
+    for (int frame = 0; frame < frames; ++frame) {
+        m_left[m_bufferFrames + frame] = input[frame * Channels];
+        m_right[m_bufferFrames + frame] = input[frame * Channels + 1];
+    }
+    m_bufferFrames += frames;
+    run(output);
+}
+
+void Resampler::flush(std::vector<float> &output)
+{
+    if (!isConfigured()) {
+        return;
+    }
+    const int tail = m_taps / 2 + 1;
+    m_left.resize(static_cast<size_t>(m_bufferFrames) + tail, 0.0f);
+    m_right.resize(static_cast<size_t>(m_bufferFrames) + tail, 0.0f);
+    std::fill(m_left.begin() + m_bufferFrames, m_left.end(), 0.0f);
+    std::fill(m_right.begin() + m_bufferFrames, m_right.end(), 0.0f);
+    m_bufferFrames += tail;
+    run(output);
+    reset();
+}
+
+void Resampler::run(std::vector<float> &output)
+{
+    const int available = m_bufferFrames - m_taps;
+    if (m_index <= available) {
+        // Frames this call will produce, from the phase arithmetic below.
+        const int64_t steps = (int64_t(available - m_index + 1) * m_upFactor - m_phase + m_downFactor - 1) / m_downFactor;
+        output.reserve(output.size() + static_cast<size_t>(std::max<int64_t>(steps, 0)) * Channels);
+    }
+    while (m_index <= available) {
+        // Rounded to the nearest table phase. The last half step stays on
+        // the last phase: the next one would belong to the next input frame.
+        const int row = m_tablePhases == m_upFactor
+            ? m_phase
+            : std::min(static_cast<int>((int64_t(m_phase) * m_tablePhases + m_upFactor / 2) / m_upFactor),
+                       m_tablePhases - 1);
+        const float *taps = m_coefficients.data() + static_cast<size_t>(row) * m_taps;
+        output.push_back(dotProduct(taps, m_left.data() + m_index, m_taps));
+        output.push_back(dotProduct(taps, m_right.data() + m_index, m_taps));
+        m_phase += m_downFactor;
+        while (m_phase >= m_upFactor) {
+            m_phase -= m_upFactor;
+            ++m_index;
+        }
+    }
+    // Keep the history the next call still needs. Strong downsampling can
+    // step past the buffered input; the rest of that step carries over.
+    const int consumed = std::min(m_index, m_bufferFrames);
+    const int keep = m_bufferFrames - consumed;
+    std::memmove(m_left.data(), m_left.data() + consumed, static_cast<size_t>(keep) * sizeof(float));
+    std::memmove(m_right.data(), m_right.data() + consumed, static_cast<size_t>(keep) * sizeof(float));
+    m_left.resize(keep);
+    m_right.resize(keep);
+    m_bufferFrames = keep;
+    m_index -= consumed;
+}
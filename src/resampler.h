@@ -0,0 +1,59 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <cstdint>
+#include <vector>
+
+// Polyphase windowed-sinc sample rate converter for interleaved stereo
+// float. The ratio is reduced to out/in = L/M and one Kaiser-windowed sinc
+// per phase is precomputed; every output sample is a pair of dot products
+// between a phase's taps and the planar input history. Ratios needing more
+// than MaxPhases phases use the nearest of MaxPhases, which limits them to
+// about 88 dB SNR even at High.
+class Resampler
+{
+public:
+    enum Quality {
+        Fast,       // 16 taps, ~60 dB stopband
+        Standard,   // 32 taps, ~85 dB stopband
+        High,       // 64 taps, ~100 dB stopband
+        QualityCount
+    };
+
+    static const int Channels = 2;
+    static const int MaxPhases = 1024;
+
+    Resampler();
+
+    void configure(int inputRate, int outputRate, Quality quality);
+    bool isConfigured() const { return m_inputRate > 0; }
+    int inputRate() const { return m_inputRate; }
+    int outputRate() const { return m_outputRate; }
+    Quality quality() const { return m_quality; }
+    // Forgets buffered input, e.g. after a seek.
+    void reset();
+
+    // Appends the converted frames to `output`.
+    void process(const float *input, int frames, std::vector<float> &output);
+    // Appends what is still held back by the filter delay.
+    void flush(std::vector<float> &output);
+
+private:
+    void run(std::vector<float> &output);
+
+    int m_inputRate;
+    int m_outputRate;
+    Quality m_quality;
+    int m_taps;
+    int m_upFactor;         // L
+    int m_downFactor;       // M
+    int m_tablePhases;
+    std::vector<float> m_coefficients;
+    std::vector<float> m_left;
+    std::vector<float> m_right;
+    int m_bufferFrames;
+    int m_index;
+    int m_phase;
+};
+
+#endif
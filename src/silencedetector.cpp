@@ -0,0 +1,88 @@
+#include "silencedetector.h"
+#include "dotproduct.h"
+#include <algorithm>
+#include <cmath>
+
+SilenceDetector::SilenceDetector()
+    : m_sampleRate(0)
+    , m_windowFrames(0)
+    , m_windowFill(0)
+    , m_windowEnergy(0.0)
+    , m_threshold(0.0f)
+    , m_windows(0)
+    , m_firstAudible(-1)
+    , m_lastAudible(-1)
+    , m_totalFrames(0)
+    , m_startMs(0)
+    , m_endMs(0)
+{
+}
+
+void SilenceDetector::prepare(int sampleRate)
+{
+    m_sampleRate = sampleRate;
+    m_windowFrames = std::max(1, sampleRate * WindowMs / 1000);
+    // Compared against the window's sum of squares over both channels.
+    const double meanSquare = std::pow(10.0, ThresholdDb / 10.0);
+    m_threshold = static_cast<float>(meanSquare * m_windowFrames * Channels);
+    m_windowFill = 0;
+    m_windowEnergy = 0.0;
+    m_windows = 0;
+    m_firstAudible = -1;
+    m_lastAudible = -1;
+    m_totalFrames = 0;
+    m_startMs = 0;
+    m_endMs = 0;
+}
+
+void SilenceDetector::process(const float *interleaved, int frames)
+{
+    if (!isPrepared()) {
+        return;
+    }
+    m_totalFrames += frames;
+    while (frames > 0) {
+        const int count = std::min(frames, m_windowFrames - m_windowFill);
+        m_windowEnergy += dotProduct(interleaved, interleaved, count * Channels);
+        m_windowFill += count;
+        interleaved += count * Channels;
+        frames -= count;
+        if (m_windowFill == m_windowFrames) {
+            endWindow();
+        }
+    }
+}
+
+void SilenceDetector::endWindow()
+{
+    // A partial last window is held to the threshold of a full one.
+    if (m_windowEnergy > m_threshold * (double(m_windowFill) / m_windowFrames)) {
+        if (m_firstAudible < 0) {
+            m_firstAudible = m_windows;
+        }
+        m_lastAudible = m_windows;
+    }
+    ++m_windows;
+    m_windowFill = 0;
+    m_windowEnergy = 0.0;
+}
+
+void SilenceDetector::finish()
+{
+    if (!isPrepared()) {
+        return;
+    }
+    if (m_windowFill > 0) {
+        endWindow();
+    }
+    if (m_firstAudible < 0) {
+        m_startMs = 0;
+        m_endMs = 0;
+        return;
+    }
+    const int64_t totalMs = m_totalFrames * 1000 / m_sampleRate;
+    const int64_t soundStartMs = m_firstAudible * m_windowFrames * 1000 / m_sampleRate;
+    const int64_t soundEndMs = std::min(totalMs, (m_lastAudible + 1) * m_windowFrames * 1000 / m_sampleRate);
+    m_startMs = soundStartMs < MinSilenceMs ? 0 : soundStartMs - PaddingMs;
+    m_endMs = totalMs - soundEndMs < MinSilenceMs ? totalMs : soundEndMs + PaddingMs;
+}
@@ -0,0 +1,47 @@
+#ifndef SILENCEDETECTOR_H
+#define SILENCEDETECTOR_H
+
+#include <cstdint>
+
+// Finds leading and trailing silence in interleaved stereo float input during
+// an analysis decode pass. The signal is measured in short RMS windows (the
+// sum of squares goes through the SSE2/NEON dot product); a window counts as
+// audible above ThresholdDb. Runs shorter than MinSilenceMs are not trimmed,
+// and the audible part keeps PaddingMs on either side.
+class SilenceDetector
+{
+public:
+    static const int Channels = 2;
+    static const int WindowMs = 10;
+    static const int PaddingMs = 50;
+    static const int MinSilenceMs = 250;
+    static constexpr double ThresholdDb = -60.0;
+
+    SilenceDetector();
+
+    void prepare(int sampleRate);
+    bool isPrepared() const { return m_sampleRate > 0; }
+    void process(const float *interleaved, int frames);
+    void finish();
+
+    // Audible range in milliseconds; both are 0 for a silent file.
+    int64_t audioStartMs() const { return m_startMs; }
+    int64_t audioEndMs() const { return m_endMs; }
+
+private:
+    void endWindow();
+
+    int m_sampleRate;
+    int m_windowFrames;
+    int m_windowFill;
+    double m_windowEnergy;
+    float m_threshold;
+    int64_t m_windows;
+    int64_t m_firstAudible;
+    int64_t m_lastAudible;
+    int64_t m_totalFrames;
+    int64_t m_startMs;
+    int64_t m_endMs;
+};
+
+#endif
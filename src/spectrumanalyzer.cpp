@@ -0,0 +1,187 @@
+#include "spectrumanalyzer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const float kPi = 3.14159265358979f;
+static const float kFloorDb = -70.0f;
+static const float kLowestFrequency = 40.0f;
+static const float kHighestFrequency = 16000.0f;
+// Normalised fall per hop, roughly half a second from full scale to silence.
+static const float kFallPerHop = 0.04f;
+
+SpectrumAnalyzer::SpectrumAnalyzer(OutputTap *tap, QObject *parent)
+    : QThread(parent)
+    , m_tap(tap)
+    , m_bandSampleRate(0)
+    , m_window(FftSize)
+    , m_history(FftSize, 0.0f)
+    , m_spectrum(FftSize)
+{
+    std::memset(&m_current, 0, sizeof(m_current));
+    for (int i = 0; i < FftSize; ++i) {
+        m_window[i] = 0.5f - 0.5f * std::cos(2.0f * kPi * i / (FftSize - 1));
+    }
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer()
+{
+    requestInterruption();
+    wait();
+}
+
+bool SpectrumAnalyzer::latest(SpectrumFrame &frame)
+{
+    if (!m_output.update()) {
+        return false;
+    }
+    frame = m_output.readBuffer();
+    return true;
+}
+
+void SpectrumAnalyzer::run()
+{
+    const size_t hopSamples = size_t(HopSize) * OutputTap::Channels;
+    std::vector<float> hop(hopSamples);
+    SpscRingBuffer<float> &ring = m_tap->ring();
+    int idleMs = 0;
+    while (!isInterruptionRequested()) {
+        const int sampleRate = m_tap->sampleRate();
+        // Stay close to what is audible now instead of working off a backlog.
+        if (ring.availableRead() > 4 * hopSamples) {
+            ring.discardUntil(ring.writeIndex() - 2 * hopSamples);
+        }
+        bool analyzed = false;
+        while (sampleRate > 0 && ring.availableRead() >= hopSamples) {
+            ring.read(hop.data(), hopSamples);
+            analyzeHop(hop.data(), sampleRate);
+            analyzed = true;
+        }
+        if (analyzed) {
+            idleMs = 0;
+        } else if ((idleMs += 10) >= 20) {
+            idleMs = 0;
+            decay();
+        }
+        msleep(10);
+    }
+}
+
+void SpectrumAnalyzer::analyzeHop(const float *interleaved, int sampleRate)
+{
+    if (sampleRate != m_bandSampleRate) {
+        computeBandEdges(sampleRate);
+    }
+
+    std::memmove(m_history.data(), m_history.data() + HopSize, (FftSize - HopSize) * sizeof(float));
+    float *incoming = m_history.data() + (FftSize - HopSize);
+    float sumSquares[2] = {0.0f, 0.0f};
+    float peaks[2] = {0.0f, 0.0f};
+    for (int frame = 0; frame < HopSize; ++frame) {
+        float left = interleaved[frame * 2];
+        float right = interleaved[frame * 2 + 1];
+        incoming[frame] = 0.5f * (left + right);
+        sumSquares[0] += left * left;
+        sumSquares[1] += right * right;
+        peaks[0] = std::max(peaks[0], std::fabs(left));
+        peaks[1] = std::max(peaks[1], std::fabs(right));
+    }
+
+    for (int i = 0; i < FftSize; ++i) {
+        m_spectrum[i] = std::complex<float>(m_history[i] * m_window[i], 0.0f);
+    }
+    fft(m_spectrum);
+
+    // A full-scale sine lands at FftSize / 4 after the Hann window.
+    const float reference = FftSize / 4.0f;
+    for (int band = 0; band < SpectrumFrame::BandCount; ++band) {
+        float magnitude = 0.0f;
+        for (int bin = m_bandEdges[band]; bin < m_bandEdges[band + 1]; ++bin) {
+            magnitude = std::max(magnitude, std::abs(m_spectrum[bin]));
+        }
+        float level = normalize(20.0f * std::log10(magnitude / reference + 1e-9f));
+        m_current.bands[band] = std::max(level, m_current.bands[band] - kFallPerHop);
+    }
+    for (int channel = 0; channel < 2; ++channel) {
+        float rms = std::sqrt(sumSquares[channel] / HopSize);
+        float rmsLevel = normalize(20.0f * std::log10(rms + 1e-9f));
+        float peakLevel = normalize(20.0f * std::log10(peaks[channel] + 1e-9f));
+        m_current.rms[channel] = std::max(rmsLevel, m_current.rms[channel] - kFallPerHop);
+        m_current.peak[channel] = std::max(peakLevel, m_current.peak[channel] - kFallPerHop / 2);
+    }
+
+    m_output.writeBuffer() = m_current;
+    m_output.publish();
+}
+
+void SpectrumAnalyzer::decay()
+{
+    bool active = false;
+    for (float &value : m_current.bands) {
+        active = active || value > 0.0f;
+        value = std::max(0.0f, value - kFallPerHop);
+    }
+    for (int channel = 0; channel < 2; ++channel) {
+        active = active || m_current.rms[channel] > 0.0f || m_current.peak[channel] > 0.0f;
+        m_current.rms[channel] = std::max(0.0f, m_current.rms[channel] - kFallPerHop);
+        m_current.peak[channel] = std::max(0.0f, m_current.peak[channel] - kFallPerHop);
+    }
+    if (!active) {
+        return;
+    }
+    m_output.writeBuffer() = m_current;
+    m_output.publish();
+}
+
+void SpectrumAnalyzer::computeBandEdges(int sampleRate)
+{
+    m_bandSampleRate = sampleRate;
+    m_bandEdges.assign(SpectrumFrame::BandCount + 1, 1);
+    const int lastBin = FftSize / 2;
+    const float high = std::min(kHighestFrequency, sampleRate / 2.0f);
+    const float ratio = std::log(high / kLowestFrequency);
+    for (int edge = 0; edge <= SpectrumFrame::BandCount; ++edge) {
+        float frequency = kLowestFrequency * std::exp(ratio * edge / SpectrumFrame::BandCount);
+        int bin = static_cast<int>(std::lround(frequency * FftSize / sampleRate));
+        bin = std::clamp(bin, 1, lastBin);
+        if (edge > 0) {
+            // Low bands are narrower than one bin; give each at least one.
+            bin = std::min(std::max(bin, m_bandEdges[edge - 1] + 1), lastBin + 1);
+        }
+        m_bandEdges[edge] = bin;
+    }
+}
+
+void SpectrumAnalyzer::fft(std::vector<std::complex<float>> &data)
+{
+    const int n = static_cast<int>(data.size());
+    for (int i = 1, j = 0; i < n; ++i) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(data[i], data[j]);
+        }
+    }
+    for (int length = 2; length <= n; length <<= 1) {
+        const float angle = -2.0f * kPi / length;
+        const std::complex<float> step(std::cos(angle), std::sin(angle));
+        for (int start = 0; start < n; start += length) {
+            std::complex<float> twiddle(1.0f, 0.0f);
+            for (int k = 0; k < length / 2; ++k) {
+                std::complex<float> even = data[start + k];
+                std::complex<float> odd = data[start + k + length / 2] * twiddle;
+                data[start + k] = even + odd;
+                data[start + k + length / 2] = even - odd;
+                twiddle *= step;
+            }
+        }
+    }
+}
+
+float SpectrumAnalyzer::normalize(float db)
+{
+    return std::clamp((db - kFloorDb) / -kFloorDb, 0.0f, 1.0f);
+}
@@ -0,0 +1,59 @@
+#ifndef SPECTRUMANALYZER_H
+#define SPECTRUMANALYZER_H
+
+#include <QThread>
+#include <complex>
+#include <vector>
+#include "outputtap.h"
+#include "triplebuffer.h"
+
+struct SpectrumFrame {
+    static const int BandCount = 32;
+
+    // Band levels and channel levels are normalised to 0..1 over the
+    // analyzer's dB range.
+    float bands[BandCount];
+    float rms[2];
+    float peak[2];
+};
+
+// Reads the output tap on its own thread, runs a Hann-windowed FFT every
+// HopSize frames and publishes log-spaced band levels plus a VU reading
+// through a triple buffer.
+class SpectrumAnalyzer : public QThread
+{
+    Q_OBJECT
+
+public:
+    static const int FftSize = 2048;
+    static const int HopSize = 1024;
+
+    explicit SpectrumAnalyzer(OutputTap *tap, QObject *parent = nullptr);
+    ~SpectrumAnalyzer();
+
+    // GUI side: returns true and fills frame when a newer result exists.
+    bool latest(SpectrumFrame &frame);
+
+protected:
+    void run() override;
+
+private:
+    void analyzeHop(const float *interleaved, int sampleRate);
+    void decay();
+    void computeBandEdges(int sampleRate);
+    static void fft(std::vector<std::complex<float>> &data);
+    static float normalize(float db);
+
+    OutputTap *m_tap;
+    TripleBuffer<SpectrumFrame> m_output;
+
+    // Analysis thread state.
+    int m_bandSampleRate;
+    std::vector<float> m_window;
+    std::vector<float> m_history;
+    std::vector<std::complex<float>> m_spectrum;
+    std::vector<int> m_bandEdges;
+    SpectrumFrame m_current;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include "spectrumwidget.h"
+#include <QPainter>
+#include <cstring>
+
+static const int kMeterWidth = 6;
+static const int kSpacing = 1;
+
+SpectrumWidget::SpectrumWidget(OutputTap *tap, QWidget *parent)
+    : QWidget(parent)
+    , m_analyzer(new SpectrumAnalyzer(tap, this))
+    , m_refreshTimer(new QTimer(this))
+{
+    std::memset(&m_frame, 0, sizeof(m_frame));
+    setMinimumHeight(60);
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    m_refreshTimer->setInterval(33);
+    connect(m_refreshTimer, &QTimer::timeout, this, &SpectrumWidget::onRefresh);
+}
+
+QSize SpectrumWidget::sizeHint() const
+{
+    return QSize(200, 80);
+}
+
+void SpectrumWidget::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    m_analyzer->start(QThread::LowPriority);
+    m_refreshTimer->start();
+}
+
+void SpectrumWidget::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    m_refreshTimer->stop();
+    m_analyzer->requestInterruption();
+    m_analyzer->wait();
+}
+
+void SpectrumWidget::onRefresh()
+{
+    if (m_analyzer->latest(m_frame)) {
+        update();
+    }
+}
+
+void SpectrumWidget::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().color(QPalette::Base));
+
+    const QColor barColor = palette().color(QPalette::Highlight);
+    const QColor peakColor = palette().color(QPalette::Text);
+    const int h = height();
+    const int meterArea = 2 * (kMeterWidth + kSpacing) + 4;
+    const int bandArea = width() - meterArea;
+
+    for (int band = 0; band < SpectrumFrame::BandCount; ++band) {
+        int left = band * bandArea / SpectrumFrame::BandCount;
+        int right = (band + 1) * bandArea / SpectrumFrame::BandCount - kSpacing;
+        int barHeight = qRound(m_frame.bands[band] * h);
+        painter.fillRect(left, h - barHeight, qMax(1, right - left), barHeight, barColor);
+    }
+
+    for (int channel = 0; channel < 2; ++channel) {
+        int left = width() - (2 - channel) * (kMeterWidth + kSpacing);
+        int rmsHeight = qRound(m_frame.rms[channel] * h);
+        int peakY = h - qRound(m_frame.peak[channel] * h);
+        painter.fillRect(left, h - rmsHeight, kMeterWidth, rmsHeight, barColor);
+        painter.fillRect(left, qMin(peakY, h - 2), kMeterWidth, 2, peakColor);
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef SPECTRUMWIDGET_H
+#define SPECTRUMWIDGET_H
+
+#include <QWidget>
+#include <QTimer>
+#include "spectrumanalyzer.h"
+
+// Spectrum bars with a stereo level meter. The analyzer thread only runs
+// while the widget is visible; the GUI thread polls its latest frame.
+class SpectrumWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit SpectrumWidget(OutputTap *tap, QWidget *parent = nullptr);
+
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private slots:
+    void onRefresh();
+
+private:
+    SpectrumAnalyzer *m_analyzer;
+    QTimer *m_refreshTimer;
+    SpectrumFrame m_frame;
+};
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef SPSCRINGBUFFER_H
+#define SPSCRINGBUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Lock-free single-producer/single-consumer ring of trivially copyable items.
+// Indices grow monotonically and are masked on access, so "empty" and "full"
+// never alias. Only the consumer may move the read index, only the producer
+// the write index; neither side allocates after construction.
+template <typename T>
+class SpscRingBuffer
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SpscRingBuffer needs trivially copyable items");
+
+public:
+    explicit SpscRingBuffer(size_t minimumCapacity = 0)
+    {
+        reset(minimumCapacity);
+    }
+
+    SpscRingBuffer(const SpscRingBuffer &) = delete;
+    SpscRingBuffer &operator=(const SpscRingBuffer &) = delete;
+
+    // Not thread-safe: only while neither side is running.
+    void reset(size_t minimumCapacity)
+    {
+        size_t capacity = 1;
+        while (capacity < minimumCapacity) {
+            capacity <<= 1;
+        }
+        m_data.assign(minimumCapacity ? capacity : 0, T());
+        m_mask = minimumCapacity ? capacity - 1 : 0;
+        m_writeIndex.store(0, std::memory_order_relaxed);
+        m_readIndex.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return m_data.size(); }
+
+    size_t availableRead() const
+    {
+        return static_cast<size_t>(m_writeIndex.load(std::memory_order_acquire)
+                                   - m_readIndex.load(std::memory_order_relaxed));
+    }
+
+    size_t availableWrite() const
+    {
+        return m_data.size() - static_cast<size_t>(m_writeIndex.load(std::memory_order_relaxed)
+                                                   - m_readIndex.load(std::memory_order_acquire));
+    }
+
+    uint64_t writeIndex() const { return m_writeIndex.load(std::memory_order_acquire); }
+    uint64_t readIndex() const { return m_readIndex.load(std::memory_order_acquire); }
+
+    // Producer side.
+    size_t write(const T *items, size_t count)
+    {
+        const uint64_t write = m_writeIndex.load(std::memory_order_relaxed);
+        const uint64_t read = m_readIndex.load(std::memory_order_acquire);
+        count = std::min(count, m_data.size() - static_cast<size_t>(write - read));
+        if (count == 0) {
+            return 0;
+        }
+        const size_t offset = static_cast<size_t>(write & m_mask);
+        const size_t first = std::min(count, m_data.size() - offset);
+        std::memcpy(m_data.data() + offset, items, first * sizeof(T));
+        std::memcpy(m_data.data(), items + first, (count - first) * sizeof(T));
+        m_writeIndex.store(write + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side.
+    size_t read(T *items, size_t count)
+    {
+        const uint64_t read = m_readIndex.load(std::memory_order_relaxed);
+        const uint64_t write = m_writeIndex.load(std::memory_order_acquire);
+        count = std::min(count, static_cast<size_t>(write - read));
+        if (count == 0) {
+            return 0;
+        }
+        const size_t offset = static_cast<size_t>(read & m_mask);
+        const size_t first = std::min(count, m_data.size() - offset);
+        std::memcpy(items, m_data.data() + offset, first * sizeof(T));
+        std::memcpy(items + first, m_data.data(), (count - first) * sizeof(T));
+        m_readIndex.store(read + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side: drops everything written before the given write index.
+    void discardUntil(uint64_t index)
+    {
+        const uint64_t read = m_readIndex.load(std::memory_order_relaxed);
+        const uint64_t write = m_writeIndex.load(std::memory_order_acquire);
+        index = std::min(index, write);
+        if (index > read) {
+            m_readIndex.store(index, std::memory_order_release);
+        }
+    }
+
+private:
+    std::vector<T> m_data;
+    uint64_t m_mask = 0;
+    alignas(64) std::atomic<uint64_t> m_writeIndex{0};
+    alignas(64) std::atomic<uint64_t> m_readIndex{0};
+};
+
+#endif
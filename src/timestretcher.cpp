@@ -0,0 +1,267 @@
+#include "timestretcher.h"
+#include "dotproduct.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+static const double kPi = 3.14159265358979323846;
+// Window length and how far a window may move to line up with the previous
+// one. Around 30 ms keeps speech intelligible and music free of flanging.
+static const int kWindowMs = 30;
+static const int kToleranceMs = 10;
+// The coarse search runs at roughly this rate.
+static const int kSearchRate = 11025;
+
+static float similarity(float correlation, float energy)
+{
+    return energy > 1e-9f ? correlation / std::sqrt(energy) : 0.0f;
+}
+
+static int64_t roundedFrame(double frame)
+{
+    return static_cast<int64_t>(std::llround(frame));
+}
+
+TimeStretcher::TimeStretcher()
+    : m_windowFrames(0)
+    , m_hopFrames(0)
+    , m_toleranceFrames(0)
+    , m_decimation(1)
+    , m_active(false)
+    , m_inputBase(0)
+    , m_inputFrames(0)
+    , m_inputEnd(std::numeric_limits<int64_t>::max())
+    , m_endReached(false)
+    , m_readyFrames(0)
+    , m_readyOffset(0)
+    , m_analysisFrame(0.0)
+    , m_previousFrame(0)
+    , m_first(true)
+    , m_sourceRemainder(0.0)
+{
+}
+
+void TimeStretcher::prepare(int sampleRate)
+{
+    sampleRate = std::max(sampleRate, 8000);
+    m_hopFrames = sampleRate * kWindowMs / 2000;
+    m_windowFrames = m_hopFrames * 2;
+    m_toleranceFrames = sampleRate * kToleranceMs / 1000;
+    m_decimation = std::max(1, sampleRate / kSearchRate);
+
+    // A periodic Hann window at half overlap sums to exactly one.
+    m_window.resize(m_windowFrames);
+    for (int frame = 0; frame < m_windowFrames; ++frame) {
+        m_window[frame] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * frame / m_windowFrames));
+    }
+    const int inputCapacity = 4 * m_windowFrames + 4 * m_toleranceFrames;
+    m_input.assign(static_cast<size_t>(inputCapacity) * Channels, 0.0f);
+    m_mono.assign(inputCapacity, 0.0f);
+    m_accumulator.assign(static_cast<size_t>(m_windowFrames) * Channels, 0.0f);
+    m_ready.assign(static_cast<size_t>(m_hopFrames) * Channels, 0.0f);
+    m_coarseTemplate.assign(m_hopFrames / m_decimation + 1, 0.0f);
+    m_coarseRegion.assign((2 * m_toleranceFrames + m_hopFrames) / m_decimation + 2, 0.0f);
+    reset();
+}
+
+void TimeStretcher::reset()
+{
+    m_active = false;
+    m_inputBase = 0;
+    m_inputFrames = 0;
+    m_inputEnd = std::numeric_limits<int64_t>::max();
+    m_endReached = false;
+    std::fill(m_accumulator.begin(), m_accumulator.end(), 0.0f);
+    m_readyFrames = 0;
+    m_readyOffset = 0;
+    m_analysisFrame = 0.0;
+    m_previousFrame = 0;
+    m_first = true;
+    m_sourceRemainder = 0.0;
+}
+
+int TimeStretcher::process(SpscRingBuffer<float> &ring, float *output, int frames, float rate,
+                           bool endOfInput, int &sourceFrames)
+{
+    sourceFrames = 0;
+    if (m_windowFrames == 0) {
+        return 0;
+    }
+    m_active = true;
+    rate = std::clamp(rate, MinRate, MaxRate);
+    int produced = 0;
+    while (produced < frames) {
+        if (m_readyFrames > 0) {
+            const int count = std::min(m_readyFrames, frames - produced);
+            std::memcpy(output + static_cast<size_t>(produced) * Channels,
+                        m_ready.data() + static_cast<size_t>(m_readyOffset) * Channels,
+                        static_cast<size_t>(count) * Channels * sizeof(float));
+            produced += count;
+            m_readyOffset += count;
+            m_readyFrames -= count;
+            continue;
+        }
+        const int64_t target = roundedFrame(m_analysisFrame);
+        int64_t needed = target + m_toleranceFrames + m_windowFrames;
+        if (!m_first) {
+            needed = std::max(needed, m_previousFrame + m_hopFrames + m_windowFrames);
+        }
+        if (!fillInput(ring, needed, endOfInput)) {
+            break;
+        }
+        if (m_endReached && target >= m_inputEnd) {
+            break;
+        }
+        step(rate);
+    }
+    const double advanced = produced * static_cast<double>(rate) + m_sourceRemainder;
+    sourceFrames = static_cast<int>(advanced);
+    m_sourceRemainder = advanced - sourceFrames;
+    return produced;
+}
+
+bool TimeStretcher::fillInput(SpscRingBuffer<float> &ring, int64_t untilFrame, bool endOfInput)
+{
+    const int capacity = static_cast<int>(m_mono.size());
+    const int64_t have = m_inputBase + m_inputFrames;
+    if (have >= untilFrame) {
+        return true;
+    }
+    const int wanted = static_cast<int>(untilFrame - have);
+    if (wanted > capacity - m_inputFrames) {
+        return false;
+    }
+    float *destination = m_input.data() + static_cast<size_t>(m_inputFrames) * Channels;
+    const int got = static_cast<int>(ring.read(destination, static_cast<size_t>(wanted) * Channels)) / Channels;
+    for (int frame = 0; frame < got; ++frame) {
+        m_mono[m_inputFrames + frame] = 0.5f * (destination[frame * Channels] + destination[frame * Channels + 1]);
+    }
+    if (got < wanted && !endOfInput) {
+        // Keep what arrived; the rest comes with the next callback.
+        m_inputFrames += got;
+        return false;
+    }
+    if (got < wanted) {
+        // Past the end of the track the windows run into silence.
+        if (!m_endReached) {
+            m_endReached = true;
+            m_inputEnd = have + got;
+        }
+        std::fill(destination + static_cast<size_t>(got) * Channels,
+                  destination + static_cast<size_t>(wanted) * Channels, 0.0f);
+        std::fill(m_mono.begin() + m_inputFrames + got, m_mono.begin() + m_inputFrames + wanted, 0.0f);
+    }
+    m_inputFrames += wanted;
+    return true;
+}
+
+void TimeStretcher::dropInputBefore(int64_t frame)
+{
+    if (frame <= m_inputBase) {
+        return;
+    }
+    const int drop = static_cast<int>(std::min<int64_t>(frame - m_inputBase, m_inputFrames));
+    const int keep = m_inputFrames - drop;
+    std::memmove(m_input.data(), m_input.data() + static_cast<size_t>(drop) * Channels,
+                 static_cast<size_t>(keep) * Channels * sizeof(float));
+    std::memmove(m_mono.data(), m_mono.data() + drop, static_cast<size_t>(keep) * sizeof(float));
+    m_inputFrames = keep;
+    m_inputBase += drop;
+}
+
+int64_t TimeStretcher::bestOffset(int64_t natural, int64_t from, int64_t to)
+{
+    // Compares the overlap of each candidate with the natural continuation
+    // of the previous window, normalised by the candidate's energy.
+    const int overlap = m_windowFrames - m_hopFrames;
+    const float *templ = m_mono.data() + (natural - m_inputBase);
+    const float *region = m_mono.data() + (from - m_inputBase);
+    const int span = static_cast<int>(to - from);
+
+    int64_t coarseBest = from;
+    if (m_decimation > 1) {
+        // Box-filtered decimation doubles as the anti-alias filter.
+        const int factor = m_decimation;
+        const float scale = 1.0f / factor;
+        const int templateLength = overlap / factor;
+        const int regionLength = (span + overlap) / factor;
+        for (int index = 0; index < templateLength; ++index) {
+            float sum = 0.0f;
+            for (int tap = 0; tap < factor; ++tap) {
+                sum += templ[index * factor + tap];
+            }
+            m_coarseTemplate[index] = sum * scale;
+        }
+        for (int index = 0; index < regionLength; ++index) {
+            float sum = 0.0f;
+            for (int tap = 0; tap < factor; ++tap) {
+                sum += region[index * factor + tap];
+            }
+            m_coarseRegion[index] = sum * scale;
+        }
+        const int candidates = span / factor + 1;
+        float energy = dotProduct(m_coarseRegion.data(), m_coarseRegion.data(), templateLength);
+        float bestScore = -std::numeric_limits<float>::max();
+        int best = 0;
+        for (int candidate = 0; candidate < candidates; ++candidate) {
+            if (candidate > 0) {
+                const float leaving = m_coarseRegion[candidate - 1];
+                const float entering = m_coarseRegion[candidate + templateLength - 1];
+                energy = std::max(0.0f, energy - leaving * leaving + entering * entering);
+            }
+            const float score = similarity(dotProduct(m_coarseTemplate.data(), m_coarseRegion.data() + candidate,
+                                                      templateLength), energy);
+            if (score > bestScore) {
+                bestScore = score;
+                best = candidate;
+            }
+        }
+        coarseBest = from + static_cast<int64_t>(best) * factor;
+    }
+
+    const int64_t refineFrom = m_decimation > 1 ? std::max(from, coarseBest - m_decimation + 1) : from;
+    const int64_t refineTo = m_decimation > 1 ? std::min(to, coarseBest + m_decimation - 1) : to;
+    float bestScore = -std::numeric_limits<float>::max();
+    int64_t best = coarseBest;
+    for (int64_t candidate = refineFrom; candidate <= refineTo; ++candidate) {
+        const float *samples = m_mono.data() + (candidate - m_inputBase);
+        const float score = similarity(dotProduct(templ, samples, overlap), dotProduct(samples, samples, overlap));
+        if (score > bestScore) {
+            bestScore = score;
+            best = candidate;
+        }
+    }
+    return best;
+}
+
+void TimeStretcher::step(float rate)
+{
+    const int64_t target = roundedFrame(m_analysisFrame);
+    int64_t chosen = target;
+    if (!m_first) {
+        chosen = bestOffset(m_previousFrame + m_hopFrames,
+                            std::max(target - m_toleranceFrames, m_inputBase),
+                            target + m_toleranceFrames);
+    }
+    m_first = false;
+
+    const float *source = m_input.data() + static_cast<size_t>(chosen - m_inputBase) * Channels;
+    for (int frame = 0; frame < m_windowFrames; ++frame) {
+        const float weight = m_window[frame];
+        m_accumulator[frame * Channels] += source[frame * Channels] * weight;
+        m_accumulator[frame * Channels + 1] += source[frame * Channels + 1] * weight;
+    }
+    const size_t hopSamples = static_cast<size_t>(m_hopFrames) * Channels;
+    std::memcpy(m_ready.data(), m_accumulator.data(), hopSamples * sizeof(float));
+    std::memmove(m_accumulator.data(), m_accumulator.data() + hopSamples,
+                 (m_accumulator.size() - hopSamples) * sizeof(float));
+    std::fill(m_accumulator.end() - hopSamples, m_accumulator.end(), 0.0f);
+    m_readyFrames = m_hopFrames;
+    m_readyOffset = 0;
+
+    m_previousFrame = chosen;
+    m_analysisFrame += m_hopFrames * static_cast<double>(rate);
+    dropInputBefore(std::min(m_previousFrame + m_hopFrames,
+                             roundedFrame(m_analysisFrame) - m_toleranceFrames));
+}
@@ -0,0 +1,73 @@
+#ifndef TIMESTRETCHER_H
+#define TIMESTRETCHER_H
+
+#include <cstdint>
+#include <vector>
+#include "spscringbuffer.h"
+
+// Changes playback speed without changing pitch (WSOLA). Windows of the
+// source are overlap-added at a fixed output hop while the read position
+// advances by hop * rate; each window is shifted within a small tolerance to
+// the offset that best continues the previous one. The offset search runs
+// on a decimated mono copy first and is refined at the full rate.
+//
+// Owned by the audio thread. prepare() allocates and must be called while
+// the output is stopped; process() and reset() never allocate.
+class TimeStretcher
+{
+public:
+    static const int Channels = 2;
+    static constexpr float MinRate = 0.5f;
+    static constexpr float MaxRate = 3.0f;
+
+    TimeStretcher();
+
+    void prepare(int sampleRate);
+    void reset();
+    bool isActive() const { return m_active; }
+
+    // Fills up to `frames` output frames from the ring. Returns the number
+    // produced; fewer than asked means the ring ran dry, or with
+    // `endOfInput` that the stretched stream is finished. `sourceFrames`
+    // receives how far playback moved in the source.
+    int process(SpscRingBuffer<float> &ring, float *output, int frames, float rate,
+                bool endOfInput, int &sourceFrames);
+    // True once everything read from the ring has been played out.
+    bool isDrained() const { return m_endReached && m_readyFrames == 0 && m_analysisFrame >= m_inputEnd; }
+
+private:
+    bool fillInput(SpscRingBuffer<float> &ring, int64_t untilFrame, bool endOfInput);
+    void dropInputBefore(int64_t frame);
+    int64_t bestOffset(int64_t natural, int64_t from, int64_t to);
+    void step(float rate);
+
+    int m_windowFrames;
+    int m_hopFrames;
+    int m_toleranceFrames;
+    int m_decimation;
+    bool m_active;
+
+    std::vector<float> m_window;
+    // Source frames [m_inputBase, m_inputBase + m_inputFrames), interleaved
+    // and as a mono mixdown used for the search.
+    std::vector<float> m_input;
+    std::vector<float> m_mono;
+    int64_t m_inputBase;
+    int m_inputFrames;
+    int64_t m_inputEnd;
+    bool m_endReached;
+
+    std::vector<float> m_accumulator;
+    std::vector<float> m_ready;
+    int m_readyFrames;
+    int m_readyOffset;
+    std::vector<float> m_coarseTemplate;
+    std::vector<float> m_coarseRegion;
+
+    double m_analysisFrame;
+    int64_t m_previousFrame;
+    bool m_first;
+    double m_sourceRemainder;
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include "trackanalyzer.h"
+#include "backgroundscheduler.h"
+#include "loudnessmeter.h"
+#include "mp3seekindex.h"
+#include "pcmreader.h"
+#include "peakextractor.h"
+#include "silencedetector.h"
+#include <QDebug>
+#include <QMetaObject>
+#include <algorithm>
+
+TrackAnalyzer::TrackAnalyzer(DatabaseManager *dbManager, QObject *parent)
+    : QObject(parent)
+    , m_dbManager(dbManager)
+    , m_cancelled(std::make_shared<std::atomic<bool>>(false))
+    , m_inFlight(0)
+    , m_bulkInFlight(0)
+    , m_done(0)
+    , m_total(0)
+{
+    connect(BackgroundScheduler::instance(), &BackgroundScheduler::concurrencyChanged,
+            this, &TrackAnalyzer::startPending);
+}
+
+TrackAnalyzer::~TrackAnalyzer()
+{
+    m_pending.clear();
+    m_cancelled->store(true);
+    // Running jobs post back to this object.
+    BackgroundScheduler::instance()->waitForDone();
+}
+
+void TrackAnalyzer::analyze(const QList<TrackInfo> &tracks)
+{
+    for (const TrackInfo &track : tracks) {
+        const QString key = albumKey(track);
+        if (!key.isEmpty()) {
+            AlbumState &state = m_albums[key];
+            ++state.pending;
+            state.trackIds << track.id;
+        }
+        m_pending << AnalysisJob{track, true};
+    }
+    m_total += tracks.size();
+    if (m_total == 0) {
+        emit finished();
+        return;
+    }
+    emit progress(m_done, m_total);
+    startPending();
+}
+
+void TrackAnalyzer::requestPeaks(const TrackInfo &track)
+{
+    if (track.id < 0 || m_peakRequests.contains(track.id)) {
+        return;
+    }
+    m_peakRequests.insert(track.id);
+    m_pending.prepend(AnalysisJob{track, false});
+    startPending();
+}
+
+void TrackAnalyzer::cancel()
+{
+    if (!isRunning()) {
+        return;
+    }
+    m_cancelled->store(true);
+    m_cancelled = std::make_shared<std::atomic<bool>>(false);
+    m_pending.erase(std::remove_if(m_pending.begin(), m_pending.end(), [](const AnalysisJob &job) {
+        return job.loudness;
+    }), m_pending.end());
+    m_albums.clear();
+    m_done = 0;
+    m_total = 0;
+    emit finished();
+}
+
+void TrackAnalyzer::startPending()
+{
+    BackgroundScheduler *scheduler = BackgroundScheduler::instance();
+    // Peak requests sit at the front and never wait for the scan.
+    while (!m_pending.isEmpty()) {
+        const bool bulk = m_pending.first().loudness;
+        if (bulk && m_bulkInFlight >= scheduler->concurrency(BackgroundScheduler::Bulk)) {
+            break;
+        }
+        AnalysisJob job = m_pending.takeFirst();
+        ++m_inFlight;
+        if (bulk) {
+            ++m_bulkInFlight;
+        }
+        std::shared_ptr<std::atomic<bool>> cancelled = m_cancelled;
+        scheduler->start(bulk ? BackgroundScheduler::Bulk : BackgroundScheduler::Interactive,
+                         [this, job, cancelled, bulk]() {
+            TrackAnalysisResult result = analyzeTrack(job, cancelled.get());
+            QMetaObject::invokeMethod(this, [this, result, cancelled, bulk]() {
+                --m_inFlight;
+                if (bulk) {
+                    --m_bulkInFlight;
+                }
+                onJobFinished(result, cancelled->load());
+                startPending();
+            }, Qt::QueuedConnection);
+        });
+    }
+}
+
+QString TrackAnalyzer::albumKey(const TrackInfo &track)
+{
+    // Titles such as "Greatest Hits" or "Live" are shared by many artists;
+    // each of those albums gets its own gain.
+    if (track.album.isEmpty()) {
+        return QString();
+    }
+    return track.artist + QChar(0x1f) + track.album;
+}
+
+TrackAnalysisResult TrackAnalyzer::analyzeTrack(const AnalysisJob &job, const std::atomic<bool> *cancelled)
+{
+    TrackAnalysisResult result;
+    result.trackId = job.track.id;
+    result.albumKey = albumKey(job.track);
+    result.loudnessRequested = job.loudness;
+
+    LoudnessMeter meter;
+    PeakExtractor peaks;
+    SilenceDetector silence;
+    const bool measure = job.loudness;
+    bool decoded = PcmReader::decode(job.track.filePath,
+                                     [&meter, &peaks, &silence, measure](const float *samples, int frames, int sampleRate) {
+        if (measure) {
+            if (!meter.isPrepared()) {
+                meter.prepare(sampleRate);
+            }
+            meter.process(samples, frames);
+        }
+        if (!silence.isPrepared()) {
+            silence.prepare(sampleRate);
+        }
+        silence.process(samples, frames);
+        peaks.process(samples, frames);
+    }, cancelled, &result.error);
+    if (!decoded) {
+        return result;
+    }
+    if (silence.isPrepared()) {
+        silence.finish();
+        result.rangeFound = true;
+        result.audioStart = silence.audioStartMs();
+        result.audioEnd = silence.audioEndMs();
+    }
+    if (Mp3SeekIndex::isSupported(job.track.filePath)) {
+        Mp3SeekIndex::ensure(job.track.filePath);
+    }
+    WaveformPeaks waveform = peaks.finish();
+    result.peaksSaved = !waveform.isEmpty()
+        && PeakExtractor::save(waveform, PeakExtractor::peakFilePath(job.track.id));
+    if (!measure || !meter.isPrepared()) {
+        return result;
+    }
+    meter.finish();
+    result.ok = true;
+    result.loudness = meter.integratedLoudness();
+    result.truePeak = meter.truePeak();
+    result.blocks = meter.blockEnergies();
+    return result;
+}
+
+void TrackAnalyzer::onJobFinished(const TrackAnalysisResult &result, bool cancelled)
+{
+    if (result.peaksSaved) {
+        emit peaksReady(result.trackId);
+    }
+    if (result.rangeFound && !cancelled
+        && m_dbManager->updateAudioRange(result.trackId, result.audioStart, result.audioEnd)) {
+        emit audioRangeFound(result.trackId);
+    }
+    if (!result.loudnessRequested) {
+        m_peakRequests.remove(result.trackId);
+        return;
+    }
+    if (!cancelled) {
+        onTrackAnalyzed(result);
+    }
+}
+
+void TrackAnalyzer::onTrackAnalyzed(const TrackAnalysisResult &result)
+{
+    ++m_done;
+    if (result.ok) {
+        double gain = LoudnessMeter::replayGain(result.loudness);
+        m_dbManager->updateTrackLoudness(result.trackId, result.loudness, gain, result.truePeak);
+        if (result.albumKey.isEmpty()) {
+            m_dbManager->updateAlbumGain({result.trackId}, gain, result.truePeak);
+        }
+        emit trackAnalyzed(result.trackId);
+    } else {
+        qWarning() << "Не удалось проанализировать громкость трека" << result.trackId << ":" << result.error;
+    }
+
+    if (!result.albumKey.isEmpty()) {
+        auto it = m_albums.find(result.albumKey);
+        if (it != m_albums.end()) {
+            AlbumState &state = it.value();
+            state.blocks.insert(state.blocks.end(), result.blocks.begin(), result.blocks.end());
+            state.peak = std::max(state.peak, result.truePeak);
+            if (--state.pending == 0) {
+                finishAlbum(result.albumKey, state);
+                m_albums.erase(it);
+            }
+        }
+    }
+
+    emit progress(m_done, m_total);
+    if (m_done >= m_total) {
+        m_done = 0;
+        m_total = 0;
+        m_albums.clear();
+        emit finished();
+    }
+}
+
+void TrackAnalyzer::finishAlbum(const QString &albumKey, AlbumState &state)
+{
+    if (state.blocks.empty()) {
+        return;
+    }
+    double gain = LoudnessMeter::replayGain(LoudnessMeter::gatedLoudness(state.blocks));
+    if (!m_dbManager->updateAlbumGain(state.trackIds, gain, state.peak)) {
+        qWarning() << "Не удалось сохранить громкость альбома" << QString(albumKey).replace(QChar(0x1f), " - ");
+        return;
+    }
+    for (int trackId : state.trackIds) {
+        emit trackAnalyzed(trackId);
+    }
+}
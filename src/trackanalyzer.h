@@ -0,0 +1,88 @@
+#ifndef TRACKANALYZER_H
+#define TRACKANALYZER_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "databasemanager.h"
+
+struct TrackAnalysisResult {
+    int trackId = -1;
+    // Artist and album title; empty for tracks without an album.
+    QString albumKey;
+    bool loudnessRequested = false;
+    bool ok = false;
+    bool peaksSaved = false;
+    bool rangeFound = false;
+    qint64 audioStart = 0;
+    qint64 audioEnd = 0;
+    QString error;
+    double loudness = 0.0;
+    double truePeak = 0.0;
+    std::vector<double> blocks;
+};
+
+// Background loudness scanner. Decodes tracks in parallel as Bulk work of the
+// BackgroundScheduler, writes track gain as each file finishes and album gain
+// once every track of the album is in. Results are stored from the GUI
+// thread. The same decode pass also writes the waveform peak file and the
+// silence boundaries; requestPeaks() runs a peak-only job as Interactive work
+// for a track that is about to be shown.
+class TrackAnalyzer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TrackAnalyzer(DatabaseManager *dbManager, QObject *parent = nullptr);
+    ~TrackAnalyzer();
+
+    void analyze(const QList<TrackInfo> &tracks);
+    void requestPeaks(const TrackInfo &track);
+    void cancel();
+    bool isRunning() const { return m_total > 0; }
+    int pendingCount() const { return m_pending.size() + m_inFlight; }
+
+signals:
+    void progress(int done, int total);
+    void trackAnalyzed(int trackId);
+    void audioRangeFound(int trackId);
+    void peaksReady(int trackId);
+    void finished();
+
+private:
+    struct AnalysisJob {
+        TrackInfo track;
+        bool loudness;
+    };
+
+    struct AlbumState {
+        int pending = 0;
+        QList<int> trackIds;
+        std::vector<double> blocks;
+        double peak = 0.0;
+    };
+
+    void startPending();
+    void onJobFinished(const TrackAnalysisResult &result, bool cancelled);
+    void onTrackAnalyzed(const TrackAnalysisResult &result);
+    void finishAlbum(const QString &albumKey, AlbumState &state);
+    static QString albumKey(const TrackInfo &track);
+    static TrackAnalysisResult analyzeTrack(const AnalysisJob &job, const std::atomic<bool> *cancelled);
+
+    DatabaseManager *m_dbManager;
+    QList<AnalysisJob> m_pending;
+    QSet<int> m_peakRequests;
+    QHash<QString, AlbumState> m_albums;
+    std::shared_ptr<std::atomic<bool>> m_cancelled;
+    int m_inFlight;
+    int m_bulkInFlight;
+    int m_done;
+    int m_total;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+// Wait-free hand-off of the latest value from one writer thread to one
+// reader thread. The writer fills writeBuffer() and publishes it; the reader
+// picks up the newest published buffer in update(). Neither side ever waits,
+// intermediate values may be skipped.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    // Writer side.
+    T &writeBuffer() { return m_buffers[m_writeIndex]; }
+
+    void publish()
+    {
+        int previous = m_middle.exchange(m_writeIndex | DirtyBit, std::memory_order_acq_rel);
+        m_writeIndex = previous & IndexMask;
+    }
+
+    // Reader side. Returns true if a newer buffer was picked up.
+    bool update()
+    {
+        if (!(m_middle.load(std::memory_order_relaxed) & DirtyBit)) {
+            return false;
+        }
+        int previous = m_middle.exchange(m_readIndex, std::memory_order_acq_rel);
+        m_readIndex = previous & IndexMask;
+        return true;
+    }
+
+    const T &readBuffer() const { return m_buffers[m_readIndex]; }
+
+private:
+    static const int DirtyBit = 4;
+    static const int IndexMask = 3;
+
+    T m_buffers[3] = {};
+    alignas(64) std::atomic<int> m_middle{1};
+    alignas(64) int m_writeIndex = 0;
+    alignas(64) int m_readIndex = 2;
+};
+
+#endif
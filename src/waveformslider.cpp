@@ -0,0 +1,130 @@
+#include "waveformslider.h"
+#include <QMouseEvent>
+#include <QPainter>
+#include <QStyle>
+#include <algorithm>
+
+WaveformSlider::WaveformSlider(QWidget *parent)
+    : QSlider(Qt::Horizontal, parent)
+{
+    setMinimumHeight(40);
+}
+
+void WaveformSlider::setPeaks(const WaveformPeaks &peaks)
+{
+    m_peaks = peaks;
+    renderWaveform();
+    update();
+}
+
+void WaveformSlider::clearPeaks()
+{
+    m_peaks = WaveformPeaks();
+    m_waveform = QPixmap();
+    m_playedWaveform = QPixmap();
+    update();
+}
+
+void WaveformSlider::resizeEvent(QResizeEvent *event)
+{
+    QSlider::resizeEvent(event);
+    renderWaveform();
+}
+
+void WaveformSlider::renderWaveform()
+{
+    if (m_peaks.isEmpty() || width() <= 0 || height() <= 0) {
+        m_waveform = QPixmap();
+        m_playedWaveform = QPixmap();
+        return;
+    }
+    const qreal ratio = devicePixelRatioF();
+    const int pixelWidth = qRound(width() * ratio);
+    const int pixelHeight = qRound(height() * ratio);
+    const QByteArray &level = m_peaks.levelFor(pixelWidth);
+    const int buckets = static_cast<int>(level.size() / 2);
+    const qreal middle = pixelHeight / 2.0;
+    const qreal scale = (pixelHeight / 2.0 - 1.0) / 127.0;
+
+    QPixmap waveform(pixelWidth, pixelHeight);
+    waveform.fill(Qt::transparent);
+    QPainter painter(&waveform);
+    painter.setPen(palette().color(QPalette::Mid));
+    for (int x = 0; x < pixelWidth; ++x) {
+        int first = static_cast<int>(qint64(x) * buckets / pixelWidth);
+        int last = std::max(first + 1, static_cast<int>(qint64(x + 1) * buckets / pixelWidth));
+        qint8 minimum = 0;
+        qint8 maximum = 0;
+        for (int bucket = first; bucket < last && bucket < buckets; ++bucket) {
+            minimum = std::min(minimum, qint8(level[bucket * 2]));
+            maximum = std::max(maximum, qint8(level[bucket * 2 + 1]));
+        }
+        painter.drawLine(QPointF(x + 0.5, middle - maximum * scale), QPointF(x + 0.5, middle - minimum * scale));
+    }
+    painter.end();
+
+    QPixmap played = waveform;
+    QPainter tint(&played);
+    tint.setCompositionMode(QPainter::CompositionMode_SourceIn);
+    tint.fillRect(played.rect(), palette().color(QPalette::Highlight));
+    tint.end();
+
+    waveform.setDevicePixelRatio(ratio);
+    played.setDevicePixelRatio(ratio);
+    m_waveform = waveform;
+    m_playedWaveform = played;
+}
+
+void WaveformSlider::paintEvent(QPaintEvent *event)
+{
+    if (m_waveform.isNull()) {
+        QSlider::paintEvent(event);
+        return;
+    }
+    QPainter painter(this);
+    int span = maximum() - minimum();
+    int playedX = span > 0 ? static_cast<int>(qint64(value() - minimum()) * width() / span) : 0;
+    painter.setClipRect(0, 0, playedX, height());
+    painter.drawPixmap(0, 0, m_playedWaveform);
+    painter.setClipRect(playedX, 0, width() - playedX, height());
+    painter.drawPixmap(0, 0, m_waveform);
+    painter.setClipping(false);
+    painter.setPen(palette().color(QPalette::Highlight));
+    painter.drawLine(playedX, 0, playedX, height());
+}
+
+int WaveformSlider::valueAt(int x) const
+{
+    return QStyle::sliderValueFromPosition(minimum(), maximum(), std::clamp(x, 0, width()), width());
+}
+
+void WaveformSlider::mousePressEvent(QMouseEvent *event)
+{
+    if (m_waveform.isNull() || event->button() != Qt::LeftButton) {
+        QSlider::mousePressEvent(event);
+        return;
+    }
+    setSliderDown(true);
+    setSliderPosition(valueAt(event->position().toPoint().x()));
+    event->accept();
+}
+
+void WaveformSlider::mouseMoveEvent(QMouseEvent *event)
+{
+    if (m_waveform.isNull() || !isSliderDown()) {
+        QSlider::mouseMoveEvent(event);
+        return;
+    }
+    setSliderPosition(valueAt(event->position().toPoint().x()));
+    event->accept();
+}
+
+void WaveformSlider::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (m_waveform.isNull() || !isSliderDown()) {
+        QSlider::mouseReleaseEvent(event);
+        return;
+    }
+    setSliderDown(false);
+    event->accept();
+}
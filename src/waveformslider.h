@@ -0,0 +1,37 @@
+#ifndef WAVEFORMSLIDER_H
+#define WAVEFORMSLIDER_H
+
+#include <QSlider>
+#include <QPixmap>
+#include "peakextractor.h"
+
+// Seek slider that draws the track's waveform overview from a peak file.
+// Without peaks it falls back to the regular QSlider look.
+class WaveformSlider : public QSlider
+{
+    Q_OBJECT
+
+public:
+    explicit WaveformSlider(QWidget *parent = nullptr);
+
+    void setPeaks(const WaveformPeaks &peaks);
+    void clearPeaks();
+    bool hasPeaks() const { return !m_peaks.isEmpty(); }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+
+private:
+    void renderWaveform();
+    int valueAt(int x) const;
+
+    WaveformPeaks m_peaks;
+    QPixmap m_waveform;
+    QPixmap m_playedWaveform;
+};
+
+#endif